@@ -0,0 +1,101 @@
+#include "arena.h"
+
+#include <atomic>
+#include <vector>
+
+using json = nlohmann::json;
+using namespace std;
+
+namespace {
+
+atomic<uint64_t> retained_bytes{0};
+
+} // namespace
+
+void ArenaStats::add(const ArenaStats &o){
+    allocations += o.allocations;
+    bytes += o.bytes;
+    upstream_allocations += o.upstream_allocations;
+    upstream_bytes += o.upstream_bytes;
+}
+
+json ArenaStats::to_json() const{
+    return {
+        {"allocations", allocations},
+        {"peak_bytes", bytes},
+        {"heap_allocations", upstream_allocations},
+        {"heap_bytes", upstream_bytes}
+    };
+}
+
+void* RequestArena::Upstream::do_allocate(size_t bytes,size_t align){
+    stats_.upstream_allocations++;
+    stats_.upstream_bytes += bytes;
+    return pmr::new_delete_resource()->allocate(bytes,align);
+}
+
+void RequestArena::Upstream::do_deallocate(void *p,size_t bytes,size_t align){
+    pmr::new_delete_resource()->deallocate(p,bytes,align);
+}
+
+RequestArena::RequestArena(size_t initial_bytes)
+    : upstream_(stats_), block_size_(initial_bytes), block_(new char[initial_bytes]),
+      mono_(make_unique<pmr::monotonic_buffer_resource>(block_.get(),block_size_,&upstream_)) {
+    retained_bytes += block_size_;
+}
+
+RequestArena::~RequestArena(){
+    retained_bytes -= block_size_;
+}
+
+void* RequestArena::do_allocate(size_t bytes,size_t align){
+    stats_.allocations++;
+    stats_.bytes += bytes;
+    return mono_->allocate(bytes,align);
+}
+
+void RequestArena::reset(){
+    size_t want = min<size_t>(stats_.bytes+stats_.bytes/4,MAX_RETAINED_BYTES);
+    mono_.reset();   // returns the upstream blocks
+    if(want>block_size_){
+        retained_bytes += want-block_size_;
+        block_size_ = want;
+        block_.reset(new char[block_size_]);
+    }
+    mono_ = make_unique<pmr::monotonic_buffer_resource>(block_.get(),block_size_,&upstream_);
+    stats_ = ArenaStats{};
+}
+
+namespace {
+
+// Idle arenas per thread; deeper nesting than this just allocates fresh ones.
+const size_t POOL_KEEP = 2;
+
+thread_local vector<unique_ptr<RequestArena>> idle_arenas;
+thread_local RequestArena *current_arena = nullptr;
+
+} // namespace
+
+ArenaScope::ArenaScope() : previous_(current_arena) {
+    if(idle_arenas.empty()) arena_ = make_unique<RequestArena>();
+    else{
+        arena_ = move(idle_arenas.back());
+        idle_arenas.pop_back();
+    }
+    current_arena = arena_.get();
+}
+
+ArenaScope::~ArenaScope(){
+    current_arena = previous_;
+    arena_->reset();
+    if(idle_arenas.size()<POOL_KEEP) idle_arenas.push_back(move(arena_));
+}
+
+pmr::memory_resource* request_memory(){
+    if(current_arena) return current_arena;
+    return pmr::get_default_resource();
+}
+
+uint64_t arena_retained_bytes(){
+    return retained_bytes.load(memory_order_relaxed);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+
+#include <nlohmann/json.hpp>
+
+// Per-request scratch memory.
+//
+// A request opens an ArenaScope on the thread serving it, and code below it
+// takes request_memory() for buffers that die with the request (export
+// chunks, sweep series). Allocation is a pointer bump and nothing is freed
+// until the scope closes. The arena is then rewound and returned to a
+// thread-local pool, so a busy thread reuses the same block request after
+// request instead of going back to malloc. Results that the result cache
+// keeps outlive the request and stay on the heap, as do candles, bricks,
+// rows, trades and JSON: the stats cover scratch buffers only.
+//
+// A thread keeps at most two idle arenas of up to MAX_RETAINED_BYTES each,
+// 8 MiB; arena_retained_bytes() is the total held across threads.
+struct ArenaStats {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;                  // handed out; never freed early, so also the peak
+    uint64_t upstream_allocations = 0;   // blocks malloc'ed once the retained one ran out
+    uint64_t upstream_bytes = 0;
+
+    void add(const ArenaStats &o);
+    nlohmann::json to_json() const;
+};
+
+class RequestArena : public std::pmr::memory_resource {
+public:
+    static constexpr size_t INITIAL_BYTES = 256 * 1024;
+    static constexpr size_t MAX_RETAINED_BYTES = 4 * 1024 * 1024;
+
+    explicit RequestArena(size_t initial_bytes = INITIAL_BYTES);
+    ~RequestArena();
+
+    const ArenaStats& stats() const { return stats_; }
+    // Frees everything. The retained block grows to what this use needed
+    // (up to MAX_RETAINED_BYTES) so the next one fits without malloc.
+    void reset();
+
+private:
+    // Counts the blocks the arena takes from the heap.
+    class Upstream : public std::pmr::memory_resource {
+    public:
+        explicit Upstream(ArenaStats &stats) : stats_(stats) {}
+    private:
+        void* do_allocate(size_t bytes, size_t align) override;
+        void do_deallocate(void *p, size_t bytes, size_t align) override;
+        bool do_is_equal(const std::pmr::memory_resource &o) const noexcept override { return this == &o; }
+        ArenaStats &stats_;
+    };
+
+    void* do_allocate(size_t bytes, size_t align) override;
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource &o) const noexcept override { return this == &o; }
+
+    ArenaStats stats_;
+    Upstream upstream_;
+    size_t block_size_;
+    std::unique_ptr<char[]> block_;
+    std::unique_ptr<std::pmr::monotonic_buffer_resource> mono_;
+};
+
+// Leases an arena from this thread's pool and makes it the current one
+// until destroyed. Scopes nest; containers using the arena must be
+// destroyed before the scope.
+class ArenaScope {
+public:
+    ArenaScope();
+    ~ArenaScope();
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+    std::pmr::memory_resource* memory() { return arena_.get(); }
+    const ArenaStats& stats() const { return arena_->stats(); }
+
+private:
+    std::unique_ptr<RequestArena> arena_;
+    RequestArena *previous_;
+};
+
+// The innermost open scope's arena on this thread, or the heap when none is.
+std::pmr::memory_resource* request_memory();
+
+// Bytes in the retained blocks of every live arena, idle or leased.
+uint64_t arena_retained_bytes();
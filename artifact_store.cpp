@@ -0,0 +1,291 @@
+#include "artifact_store.h"
+#include "log.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const size_t HASH_HEX = 32;
+const char TEMP_PREFIX[] = ".tmp-";
+const int64_t PRUNE_INTERVAL = 60;   // seconds between prunes from write()
+
+// -------- CONTENT HASH --------
+// XXH64 (Yann Collet) run under two seeds in one pass over the data.
+const uint64_t P1 = 0x9E3779B185EBCA87ULL, P2 = 0xC2B2AE3D27D4EB4FULL, P3 = 0x165667B19E3779F9ULL;
+const uint64_t P4 = 0x85EBCA77C2B2AE63ULL, P5 = 0x27D4EB2F165667C5ULL;
+const uint64_t SEEDS[2] = {0, 0x6172746966616374ULL};
+
+inline uint64_t rotl(uint64_t x,int r){ return (x<<r)|(x>>(64-r)); }
+inline uint64_t read64(const unsigned char *p){ uint64_t v; memcpy(&v,p,8); return v; }
+inline uint32_t read32(const unsigned char *p){ uint32_t v; memcpy(&v,p,4); return v; }
+inline uint64_t round64(uint64_t acc,uint64_t input){ return rotl(acc+input*P2,31)*P1; }
+inline uint64_t merge64(uint64_t acc,uint64_t v){ return (acc^round64(0,v))*P1+P4; }
+
+class ContentHash {
+public:
+    ContentHash(){
+        for(int s=0;s<2;s++){
+            v_[s][0] = SEEDS[s]+P1+P2;
+            v_[s][1] = SEEDS[s]+P2;
+            v_[s][2] = SEEDS[s];
+            v_[s][3] = SEEDS[s]-P1;
+        }
+    }
+
+    void update(const char *data,size_t size){
+        const unsigned char *p = reinterpret_cast<const unsigned char*>(data), *end = p+size;
+        total_ += size;
+        if(buffered_+size<32){
+            memcpy(buf_+buffered_,p,size);
+            buffered_ += size;
+            return;
+        }
+        if(buffered_>0){
+            size_t take = 32-buffered_;
+            memcpy(buf_+buffered_,p,take);
+            stripe(buf_);
+            p += take;
+            buffered_ = 0;
+        }
+        for(;end-p>=32;p+=32) stripe(p);
+        buffered_ = static_cast<size_t>(end-p);
+        memcpy(buf_,p,buffered_);
+    }
+
+    // 32 lowercase hex digits.
+    string hex() const {
+        char out[HASH_HEX+1];
+        snprintf(out,sizeof(out),"%016llx%016llx",
+                 static_cast<unsigned long long>(digest(0)),static_cast<unsigned long long>(digest(1)));
+        return string(out,HASH_HEX);
+    }
+
+private:
+    void stripe(const unsigned char *p){
+        for(int s=0;s<2;s++)
+            for(int l=0;l<4;l++) v_[s][l] = round64(v_[s][l],read64(p+8*l));
+    }
+
+    uint64_t digest(int s) const {
+        const uint64_t *v = v_[s];
+        uint64_t h;
+        if(total_>=32){
+            h = rotl(v[0],1)+rotl(v[1],7)+rotl(v[2],12)+rotl(v[3],18);
+            for(int l=0;l<4;l++) h = merge64(h,v[l]);
+        } else {
+            h = SEEDS[s]+P5;
+        }
+        h += total_;
+        const unsigned char *p = buf_, *end = buf_+buffered_;
+        for(;end-p>=8;p+=8) h = rotl(h^round64(0,read64(p)),27)*P1+P4;
+        if(end-p>=4){
+            h = rotl(h^(static_cast<uint64_t>(read32(p))*P1),23)*P2+P3;
+            p += 4;
+        }
+        for(;p<end;p++) h = rotl(h^(*p*P5),11)*P1;
+        h ^= h>>33; h *= P2;
+        h ^= h>>29; h *= P3;
+        h ^= h>>32;
+        return h;
+    }
+
+    uint64_t v_[2][4];
+    unsigned char buf_[32];
+    size_t buffered_ = 0;
+    uint64_t total_ = 0;
+};
+
+bool valid_id(const string &id){
+    if(id.size()<HASH_HEX+2 || id[HASH_HEX]!='.') return false;
+    for(size_t i=0;i<HASH_HEX;i++){
+        char c = id[i];
+        if(!((c>='0' && c<='9') || (c>='a' && c<='f'))) return false;
+    }
+    string ext = id.substr(HASH_HEX+1);
+    return ext=="csv" || ext=="ndjson" || ext=="btcol";
+}
+
+// Modification time, or -1 when `path` is not a regular file.
+int64_t modified(const string &path){
+    struct stat st;
+    if(stat(path.c_str(),&st)!=0 || !S_ISREG(st.st_mode)) return -1;
+    return static_cast<int64_t>(st.st_mtime);
+}
+
+void write_all(int fd,const char *data,size_t size){
+    while(size>0){
+        ssize_t n = ::write(fd,data,size);
+        if(n<0){
+            if(errno==EINTR) continue;
+            throw runtime_error(string("artifact write failed: ")+strerror(errno));
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+}
+
+} // namespace
+
+// -------- ArtifactStore --------
+ArtifactStore::ArtifactStore(string dir,chrono::seconds ttl) : dir_(move(dir)), ttl_(ttl) {}
+
+Artifact ArtifactStore::write(const string &extension,const function<void(ChunkWriter&)> &fill){
+    int64_t now = static_cast<int64_t>(time(nullptr));
+    int64_t last = last_prune_.load();
+    if(now-last>=PRUNE_INTERVAL && last_prune_.compare_exchange_strong(last,now)){
+        if(size_t removed = prune()) log_info() << "artifacts: removed " << removed << " expired files";
+    }
+
+    string temp = dir_+"/"+TEMP_PREFIX+to_string(getpid())+"-"+to_string(temp_counter_++);
+    int fd = ::open(temp.c_str(),O_WRONLY|O_CREAT|O_EXCL|O_CLOEXEC,0644);
+    if(fd<0) throw runtime_error("cannot create artifact in "+dir_+": "+strerror(errno));
+    Artifact artifact;
+    try {
+        ContentHash hash;
+        ChunkWriter out([&](const char *data,size_t size){
+            hash.update(data,size);
+            write_all(fd,data,size);
+        });
+        fill(out);
+        out.flush();
+        if(::close(fd)!=0){
+            fd = -1;
+            throw runtime_error(string("artifact write failed: ")+strerror(errno));
+        }
+        fd = -1;
+        artifact.id = hash.hex()+"."+extension;
+        artifact.bytes = out.bytes_written();
+        // Same content, same name: replacing an existing copy is harmless,
+        // and readers holding the old file keep it until they close it.
+        if(rename(temp.c_str(),(dir_+"/"+artifact.id).c_str())!=0)
+            throw runtime_error("cannot store artifact "+artifact.id+": "+strerror(errno));
+    } catch(...){
+        if(fd>=0) ::close(fd);
+        unlink(temp.c_str());
+        throw;
+    }
+    return artifact;
+}
+
+string ArtifactStore::path(const string &id) const {
+    if(!valid_id(id)) return "";
+    string p = dir_+"/"+id;
+    int64_t mtime = modified(p);
+    if(mtime<0 || mtime+ttl_.count()<static_cast<int64_t>(time(nullptr))) return "";
+    return p;
+}
+
+size_t ArtifactStore::prune(){
+    int64_t cutoff = static_cast<int64_t>(time(nullptr))-ttl_.count();
+    size_t removed = 0;
+    error_code ec;
+    for(filesystem::directory_iterator it(dir_,ec),end;!ec && it!=end;it.increment(ec)){
+        string name = it->path().filename().string();
+        if(!valid_id(name) && name.compare(0,sizeof(TEMP_PREFIX)-1,TEMP_PREFIX)!=0) continue;
+        // Temporary files count as abandoned once nothing has written to
+        // them for a whole TTL.
+        int64_t mtime = modified(it->path().string());
+        if(mtime>=0 && mtime<cutoff && unlink(it->path().c_str())==0) removed++;
+    }
+    return removed;
+}
+
+const char* artifact_extension(OutputFormat format){
+    switch(format){
+    case OutputFormat::Csv: return "csv";
+    case OutputFormat::Ndjson: return "ndjson";
+    case OutputFormat::Columnar: return "btcol";
+    case OutputFormat::Json: break;
+    }
+    throw runtime_error("artifacts are written as csv, ndjson or columnar");
+}
+
+OutputFormat artifact_format(const string &id){
+    string ext = id.substr(id.rfind('.')+1);
+    if(ext=="csv") return OutputFormat::Csv;
+    if(ext=="ndjson") return OutputFormat::Ndjson;
+    if(ext=="btcol") return OutputFormat::Columnar;
+    throw runtime_error("not an artifact id: "+id);
+}
+
+static unique_ptr<ArtifactStore> &store_slot(){
+    static unique_ptr<ArtifactStore> store;
+    return store;
+}
+
+void open_artifact_store(const string &dir,chrono::seconds ttl){
+    auto &store = store_slot();
+    store.reset();
+    if(dir.empty() || dir=="off") return;
+    error_code ec;
+    filesystem::create_directories(dir,ec);
+    if(ec){
+        log_warn() << "artifact store disabled: cannot create " << dir << ": " << ec.message();
+        return;
+    }
+    store = make_unique<ArtifactStore>(dir,ttl);
+    if(size_t removed = store->prune()) log_info() << "artifacts: removed " << removed << " expired files";
+}
+
+ArtifactStore* artifact_store(){
+    return store_slot().get();
+}
+
+// -------- Range --------
+// Digits only, without overflow; false otherwise.
+static bool parse_u64(const string &s,uint64_t &out){
+    if(s.empty()) return false;
+    uint64_t v = 0;
+    for(char c:s){
+        if(c<'0' || c>'9') return false;
+        uint64_t d = static_cast<uint64_t>(c-'0');
+        if(v>(UINT64_MAX-d)/10) return false;
+        v = v*10+d;
+    }
+    out = v;
+    return true;
+}
+
+static string trim(const string &s){
+    size_t b = s.find_first_not_of(" \t"), e = s.find_last_not_of(" \t");
+    return b==string::npos ? "" : s.substr(b,e-b+1);
+}
+
+ByteRange parse_byte_range(const string &header,uint64_t size){
+    ByteRange range;
+    string h = trim(header);
+    if(h.compare(0,6,"bytes=")!=0) return range;
+    string spec = trim(h.substr(6));
+    size_t dash = spec.find('-');
+    if(dash==string::npos || spec.find(',')!=string::npos) return range;
+    string a = trim(spec.substr(0,dash)), b = trim(spec.substr(dash+1));
+    uint64_t first, last;
+    if(a.empty()){
+        // Suffix range: the last `last` bytes.
+        if(!parse_u64(b,last)) return range;
+        if(last==0 || size==0){ range.kind = ByteRange::Unsatisfiable; return range; }
+        range.first = last<size ? size-last : 0;
+        range.last = size-1;
+    } else {
+        if(!parse_u64(a,first)) return range;
+        if(b.empty()) last = UINT64_MAX;
+        else if(!parse_u64(b,last) || last<first) return range;
+        if(first>=size){ range.kind = ByteRange::Unsatisfiable; return range; }
+        range.first = first;
+        range.last = last<size ? last : size-1;
+    }
+    range.kind = ByteRange::Partial;
+    return range;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "export_writer.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// Finished exports as content-addressed files.
+//
+// An artifact is written once through a ChunkWriter into a temporary file,
+// hashed on the way, and renamed to "<hash>.<ext>": the same output always
+// gets the same id, and writing it again just replaces the file with an
+// identical one. Files are served from disk (sendfile for whole files), so a
+// download costs no memory however large the export is.
+//
+// The hash is 128 bits of XXH64 under two seeds. It names content, it does
+// not authenticate it.
+//
+// Artifacts older than the TTL are no longer served and are deleted by
+// prune(), which write() runs at most once a minute.
+struct Artifact {
+    std::string id;
+    uint64_t bytes = 0;
+};
+
+class ArtifactStore {
+public:
+    ArtifactStore(std::string dir, std::chrono::seconds ttl);
+
+    // Runs `fill` into a new artifact with this extension (see
+    // artifact_extension). Throws std::runtime_error when the file cannot
+    // be written.
+    Artifact write(const std::string &extension, const std::function<void(ChunkWriter&)> &fill);
+
+    // Path of a live artifact; "" when the id is malformed, unknown or expired.
+    std::string path(const std::string &id) const;
+
+    // Deletes expired artifacts and abandoned temporary files. Returns how many.
+    size_t prune();
+
+    const std::string& dir() const { return dir_; }
+    std::chrono::seconds ttl() const { return ttl_; }
+
+private:
+    std::string dir_;
+    std::chrono::seconds ttl_;
+    std::atomic<int64_t> last_prune_{0};
+    std::atomic<uint64_t> temp_counter_{0};
+};
+
+// "csv", "ndjson" or "btcol"; the format of an id is its extension.
+const char* artifact_extension(OutputFormat format);
+OutputFormat artifact_format(const std::string &id);
+
+// Process-wide store. Opening with "" or "off" disables it, and so does a
+// directory that cannot be created; artifact_store() is then null.
+void open_artifact_store(const std::string &dir, std::chrono::seconds ttl);
+ArtifactStore* artifact_store();
+
+// A single "bytes=" range from a Range header, resolved against `size`.
+// Anything else (absent, several ranges, other units, malformed) is Full:
+// the whole file is sent, which a server may always do. Unsatisfiable is a
+// well-formed range starting past the end.
+struct ByteRange {
+    enum Kind { Full, Partial, Unsatisfiable } kind = Full;
+    uint64_t first = 0, last = 0;   // inclusive, when Partial
+};
+ByteRange parse_byte_range(const std::string &header, uint64_t size);
@@ -0,0 +1,328 @@
+#include "backtest.h"
+#include "log.h"
+#include "market_data.h"
+#include "metrics.h"
+#include "resample.h"
+#include "result_cache.h"
+
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <ctime>
+#include <stdexcept>
+
+using json = nlohmann::json;
+using namespace std;
+
+BacktestParams backtest_params_from_json(const json &data){
+    BacktestParams p;
+    p.symbol = data.value("symbol", "ETHUSDT");
+    p.resolution = data.value("resolution", "5m");
+    p.base_resolution = data.value("base_resolution", "");
+    if (p.base_resolution == p.resolution) p.base_resolution.clear();
+    if (!p.base_resolution.empty() &&
+        !can_resample(resolution_seconds(p.base_resolution), resolution_seconds(p.resolution))) {
+        throw runtime_error("resolution must be a multiple of base_resolution");
+    }
+    p.brick_size = data.value("brick_size", 40.0);
+    p.reversal_size = data.value("reversal_size", 80.0);
+    p.source_type = data.value("source_type", "ohlc4");
+    p.start_date = data.value("start_date", "2023-08-01");
+    p.start_time = data.value("start_time", "00:00:00");
+    p.end_date = data.value("end_date", "2023-08-02");
+    p.end_time = data.value("end_time", "23:59:59");
+    p.tenkan = data.value("tenkan", 5);
+    p.kijun = data.value("kijun", 26);
+    p.span_b = data.value("span_b", 52);
+    p.rules = rule_set_from_json(data);
+
+    p.start_ts = ist_to_unix(p.start_date, p.start_time);
+    p.end_ts = ist_to_unix(p.end_date, p.end_time);
+
+    if (p.start_ts >= p.end_ts) {
+        throw runtime_error("Start time must be before end time");
+    }
+    return p;
+}
+
+OutputFormat output_format_from_json(const json &data){
+    if (data.contains("output")) return output_format_from_string(data.value("output", "json"));
+    return output_format_from_string(data.value("format", "json"));
+}
+
+// -------- CACHED STAGES --------
+static string key_number(double v){
+    char buf[32];
+    auto r = to_chars(buf,buf+sizeof(buf),v);
+    return string(buf,r.ptr);
+}
+
+template <class T>
+static size_t footprint(const vector<T> &v){
+    return sizeof(v)+v.capacity()*sizeof(T);
+}
+
+// Ranges that still reach the open candle change with every fetch, so
+// neither they nor anything derived from them is cached.
+static bool cacheable_range(const string &resolution,int64_t end_ts){
+    return end_ts+resolution_seconds(resolution) <= static_cast<int64_t>(time(nullptr));
+}
+
+// Keys spell a request the way its parser reads it, so "btcusd"/"BTCUSD" or
+// "ohlc4"/"OHLC4" share entries. Ranges must match exactly: a shifted range
+// misses every layer and is served from the candle store instead.
+static string candle_key(const string &symbol,const string &resolution,const string &base_resolution,
+                         int64_t start_ts,int64_t end_ts){
+    string key;
+    key.reserve(symbol.size()+resolution.size()+base_resolution.size()+24);
+    for(char c : symbol) key += static_cast<char>(toupper(static_cast<unsigned char>(c)));
+    return key+"|"+resolution+"<"+base_resolution+"|"+to_string(start_ts)+"|"+to_string(end_ts);
+}
+
+shared_ptr<const vector<Candle>> cached_candles(const string &symbol,const string &resolution,const string &base_resolution,
+                                                int64_t start_ts,int64_t end_ts,RunControl *control){
+    bool cacheable = cacheable_range(resolution,end_ts);
+    string key = candle_key(symbol,resolution,base_resolution,start_ts,end_ts);
+    if(cacheable){
+        if(auto hit = result_cache().get<vector<Candle>>(CacheLayer::Candles,key)) return hit;
+    }
+    StageTimer timer(PipelineStage::Fetch);
+    auto candles = make_shared<const vector<Candle>>(
+        base_resolution.empty() ? fetch_candles(symbol, resolution, start_ts, end_ts, 4000, control)
+                                : fetch_resampled(symbol, resolution, base_resolution, start_ts, end_ts, 4000, control));
+    if(cacheable) result_cache().put(CacheLayer::Candles,key,candles,footprint(*candles));
+    return candles;
+}
+
+// Each layer's key extends the one below it.
+static string renko_cache_key(const BacktestParams &p){
+    return candle_key(p.symbol,p.resolution,p.base_resolution,p.start_ts,p.end_ts)+"|"+key_number(p.brick_size)+"|"+
+           key_number(p.reversal_size)+"|"+source_type_name(parse_source_type(p.source_type));
+}
+
+shared_ptr<const vector<Candle>> backtest_candles(const BacktestParams &p,RunControl *control){
+    if(cacheable_range(p.resolution,p.end_ts) && result_cache().contains(CacheLayer::Renko,renko_cache_key(p)))
+        return nullptr;
+    return cached_candles(p.symbol, p.resolution, p.base_resolution, p.start_ts, p.end_ts, control);
+}
+
+BacktestRun run_backtest(const BacktestParams &p,RunControl *control,shared_ptr<const vector<Candle>> candles){
+    BacktestRun run;
+    ResultCache &cache = result_cache();
+    auto stage = [&](double progress,const char *name){
+        if(!control) return;
+        control->check();
+        control->set_progress(progress,name);
+    };
+
+    bool cacheable = cacheable_range(p.resolution,p.end_ts);
+    string renko_key = renko_cache_key(p);
+    string ichimoku_key = renko_key+"|"+to_string(p.tenkan)+"|"+to_string(p.kijun)+"|"+to_string(p.span_b);
+
+    if(cacheable) run.renko = cache.get<vector<RenkoBrick>>(CacheLayer::Renko,renko_key);
+    if(run.renko){
+        log_info() << "Using cached Renko bricks (" << run.renko->size() << ")";
+    } else {
+        // Downloading dominates, so it gets most of the progress bar.
+        stage(0.0,"fetching");
+        log_info() << "Fetching candles...";
+        auto df = candles ? candles : cached_candles(p.symbol, p.resolution, p.base_resolution, p.start_ts, p.end_ts, control);
+        log_info() << " Fetched " << df->size() << " candles";
+
+        stage(0.7,"renko");
+        log_info() << "Building Renko bricks...";
+        shared_ptr<const vector<RenkoBrick>> renko;
+        {
+            StageTimer timer(PipelineStage::Renko);
+            renko = make_shared<const vector<RenkoBrick>>(build_renko(*df, p.brick_size, p.reversal_size, parse_source_type(p.source_type)));
+        }
+        if(cacheable) cache.put(CacheLayer::Renko,renko_key,renko,footprint(*renko));
+        run.renko = renko;
+        log_info() << "Built " << run.renko->size() << " Renko bricks";
+    }
+
+    if(cacheable) run.ichimoku = cache.get<vector<IchimokuRow>>(CacheLayer::Ichimoku,ichimoku_key);
+    if(!run.ichimoku){
+        stage(0.8,"ichimoku");
+        log_info() << "Calculating Ichimoku...";
+        shared_ptr<const vector<IchimokuRow>> ichimoku;
+        {
+            StageTimer timer(PipelineStage::Ichimoku);
+            ichimoku = make_shared<const vector<IchimokuRow>>(ichimoku_on_renko(*run.renko, p.tenkan, p.kijun, p.span_b));
+        }
+        if(cacheable) cache.put(CacheLayer::Ichimoku,ichimoku_key,ichimoku,footprint(*ichimoku));
+        run.ichimoku = ichimoku;
+        log_info() << "Calculated Ichimoku for " << run.ichimoku->size() << " bricks";
+    }
+
+    // The built-in rules have no parameters of their own.
+    string trades_key = p.rules ? ichimoku_key+"|"+p.rules->key() : ichimoku_key;
+    if(cacheable) run.trades = cache.get<vector<Trade>>(CacheLayer::Trades,trades_key);
+    if(run.trades){
+        log_info() << "Using cached trades (" << run.trades->size() << ")";
+    } else {
+        stage(0.9,"strategy");
+        log_info() << "Running strategy...";
+        shared_ptr<const vector<Trade>> trades;
+        {
+            StageTimer timer(PipelineStage::Strategy);
+            trades = make_shared<const vector<Trade>>(p.rules ? run_rules(*run.ichimoku,*p.rules) : run_strategy(*run.ichimoku));
+        }
+        if(cacheable) cache.put(CacheLayer::Trades,trades_key,trades,footprint(*trades));
+        run.trades = trades;
+        log_info() << "Strategy generated " << run.trades->size() << " trades";
+    }
+
+    stage(0.95,"formatting");
+    return run;
+}
+
+json backtest_response(const BacktestRun &run,int64_t processing_time_ms,bool inline_files){
+    StageTimer timer(PipelineStage::Format);
+    double net_profit = 0.0;
+    for (const auto& t : *run.trades) net_profit += t.profit;
+    net_profit = round(net_profit * 100.0) / 100.0;
+
+    json result = {
+        {"success", true},
+        {"summary", {
+            {"renko_bricks", (int)run.renko->size()},
+            {"trades", (int)run.trades->size()},
+            {"net_profit", net_profit},
+            {"processing_time_ms", processing_time_ms}
+        }}
+    };
+    if (!inline_files) return result;
+
+    // Return all CSV data in JSON response
+    result["csv_files"] = {
+        {"renko_data", {
+            {"filename", "renko_with_ichimoku.csv"},
+            {"content", renko_to_csv_string(*run.renko)}
+        }},
+        {"trades_data", {
+            {"filename", "trades.csv"},
+            {"content", trades_to_csv_string(*run.trades)}
+        }},
+        {"summary_data", {
+            {"filename", "backtest_summary.csv"},
+            {"content", summary_to_csv_string(*run.trades)}
+        }}
+    };
+    return result;
+}
+
+json download_csv_response(const BacktestParams &p,const BacktestRun &run,const string &file_type,bool inline_files){
+    StageTimer timer(PipelineStage::Format);
+    json result = {
+        {"success", true},
+        {"symbol", p.symbol},
+        {"start_date", p.start_date},
+        {"end_date", p.end_date}
+    };
+    if (!inline_files) return result;
+
+    string suffix = "_" + p.symbol + "_" + p.start_date + "_to_" + p.end_date + ".csv";
+
+    if (file_type == "renko" || file_type == "all") {
+        result["renko_data"] = {
+            {"filename", "renko" + suffix},
+            {"content", renko_to_csv_string(*run.renko)}
+        };
+    }
+
+    if (file_type == "trades" || file_type == "all") {
+        result["trades_data"] = {
+            {"filename", "trades" + suffix},
+            {"content", trades_to_csv_string(*run.trades)}
+        };
+    }
+
+    if (file_type == "summary" || file_type == "all") {
+        result["summary_data"] = {
+            {"filename", "summary" + suffix},
+            {"content", summary_to_csv_string(*run.trades)}
+        };
+    }
+    return result;
+}
+
+bool artifacts_from_json(const json &data,OutputFormat &format){
+    if(!data.contains("artifacts")) return false;
+    const json &a = data["artifacts"];
+    if(a.is_boolean()){
+        if(!a.get<bool>()) return false;
+        format = OutputFormat::Csv;
+    } else if(a.is_string()){
+        format = output_format_from_string(a.get<string>());
+        if(format==OutputFormat::Json) throw runtime_error("artifacts must be csv, ndjson or columnar");
+    } else {
+        throw runtime_error("artifacts must be true or csv, ndjson or columnar");
+    }
+    if(!artifact_store()) throw runtime_error("artifacts are disabled on this server");
+    // Every artifact holds one part, which all formats accept; this checks precision.
+    check_stream_selection(format,"renko",data.value("precision", -1));
+    return true;
+}
+
+json write_backtest_artifacts(ArtifactStore &store,const BacktestParams &p,const BacktestRun &run,
+                              OutputFormat format,const string &file_type,int precision){
+    json result = json::object();
+    for(const char *part : {"renko", "trades", "summary"}){
+        if(file_type!="all" && file_type!=part) continue;
+        Artifact artifact = store.write(artifact_extension(format),[&](ChunkWriter &out){
+            write_backtest_stream(out,format,part,run,precision);
+        });
+        result[part] = {
+            {"id", artifact.id},
+            {"filename", stream_filename(p,format,part)},
+            {"bytes", artifact.bytes},
+            {"url", "/backtest/artifacts/"+artifact.id}
+        };
+    }
+    if(result.empty()) throw runtime_error("Unsupported file_type: "+file_type);
+    return result;
+}
+
+void check_stream_selection(OutputFormat format,const string &file_type,int precision){
+    if(precision<-1 || precision>RowFormatter::MAX_PRECISION)
+        throw runtime_error("precision must be between 0 and "+to_string(RowFormatter::MAX_PRECISION));
+    bool single = file_type=="renko" || file_type=="trades" || file_type=="summary";
+    if(format==OutputFormat::Csv && !single)
+        throw runtime_error("CSV output needs file_type renko, trades or summary");
+    if(format==OutputFormat::Ndjson && !single && file_type!="all")
+        throw runtime_error("Unsupported file_type: "+file_type);
+    if(format==OutputFormat::Columnar && !single && file_type!="ichimoku" && file_type!="all")
+        throw runtime_error("Unsupported file_type: "+file_type);
+}
+
+void write_backtest_stream(ChunkWriter &out,OutputFormat format,const string &file_type,
+                           const BacktestRun &run,int precision){
+    StageTimer timer(PipelineStage::Format);
+    bool all = file_type=="all";
+    if(format==OutputFormat::Csv){
+        if(precision<0) precision = 6;
+        if(file_type=="renko") write_renko_csv(out,*run.renko,precision);
+        else if(file_type=="trades") write_trades_csv(out,*run.trades,precision);
+        else write_summary_csv(out,*run.trades,precision);
+    } else if(format==OutputFormat::Columnar){
+        // Binary doubles are exact, so precision does not apply.
+        bool renko = all || file_type=="renko", ichimoku = all || file_type=="ichimoku";
+        bool trades = all || file_type=="trades", summary = all || file_type=="summary";
+        write_columnar_header(out,renko+ichimoku+trades+summary);
+        if(renko) write_renko_columnar(out,*run.renko);
+        if(ichimoku) write_ichimoku_columnar(out,*run.ichimoku);
+        if(trades) write_trades_columnar(out,*run.trades);
+        if(summary) write_summary_columnar(out,*run.trades);
+    } else {
+        if(precision<0) precision = 0;
+        if(all || file_type=="renko") write_renko_ndjson(out,*run.renko,precision);
+        if(all || file_type=="trades") write_trades_ndjson(out,*run.trades,precision);
+        if(all || file_type=="summary") write_summary_ndjson(out,*run.trades,precision);
+    }
+    out.flush();
+}
+
+string stream_filename(const BacktestParams &p,OutputFormat format,const string &file_type){
+    return file_type + "_" + p.symbol + "_" + p.start_date + "_to_" + p.end_date + "." + artifact_extension(format);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "artifact_store.h"
+#include "export_writer.h"
+#include "rules.h"
+#include "run_control.h"
+#include "strategy.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+// Parameters shared by /backtest, /backtest/download-csv and backtest jobs.
+struct BacktestParams {
+    std::string symbol = "ETHUSDT";
+    std::string resolution = "5m";
+    std::string base_resolution;   // when set, candles are resampled from this resolution
+    double brick_size = 40.0;
+    double reversal_size = 80.0;
+    std::string source_type = "ohlc4";
+    std::string start_date = "2023-08-01", start_time = "00:00:00";
+    std::string end_date = "2023-08-02", end_time = "23:59:59";
+    int tenkan = 5, kijun = 26, span_b = 52;
+    int64_t start_ts = 0, end_ts = 0;
+    std::shared_ptr<const RuleSet> rules;   // null: the built-in rules
+};
+
+// Throws std::runtime_error when the range is empty.
+BacktestParams backtest_params_from_json(const nlohmann::json &data);
+
+// The "output" field, or its alias "format"; json when neither is given.
+OutputFormat output_format_from_json(const nlohmann::json &data);
+
+// Stage outputs are shared with the result cache and must not be modified.
+struct BacktestRun {
+    std::shared_ptr<const std::vector<RenkoBrick>> renko;
+    std::shared_ptr<const std::vector<IchimokuRow>> ichimoku;
+    std::shared_ptr<const std::vector<Trade>> trades;
+};
+
+// Fetch -> Renko -> Ichimoku -> strategy, reusing the deepest cached layer
+// for these parameters. When `control` is given it gets progress updates and
+// is checked for cancellation between stages. `candles`, when given, are
+// used instead of fetching.
+BacktestRun run_backtest(const BacktestParams &p, RunControl *control = nullptr,
+                         std::shared_ptr<const std::vector<Candle>> candles = nullptr);
+
+// The candles run_backtest needs for `p`, or null when its Renko series is
+// already cached. Lets a caller download on one thread and compute on another.
+std::shared_ptr<const std::vector<Candle>> backtest_candles(const BacktestParams &p, RunControl *control = nullptr);
+
+// fetch_candles (or fetch_resampled when base_resolution is set) through the
+// candle layer of the result cache.
+std::shared_ptr<const std::vector<Candle>> cached_candles(const std::string &symbol, const std::string &resolution,
+                                                          const std::string &base_resolution,
+                                                          int64_t start_ts, int64_t end_ts,
+                                                          RunControl *control = nullptr);
+
+// Response bodies of /backtest and /backtest/download-csv; without
+// `inline_files` the CSV text is left out (see write_backtest_artifacts).
+nlohmann::json backtest_response(const BacktestRun &run, int64_t processing_time_ms, bool inline_files = true);
+nlohmann::json download_csv_response(const BacktestParams &p, const BacktestRun &run, const std::string &file_type,
+                                     bool inline_files = true);
+
+// The "artifacts" field: true for CSV files, or "csv", "ndjson" or
+// "columnar". False when absent or false. Throws std::runtime_error for
+// other values, a bad "precision", or when the artifact store is disabled.
+bool artifacts_from_json(const nlohmann::json &data, OutputFormat &format);
+
+// Writes the renko, trades and summary outputs selected by file_type ("all"
+// for every one) to the store, one artifact each, and lists them:
+// {"renko": {"id", "filename", "bytes", "url"}, ...}.
+nlohmann::json write_backtest_artifacts(ArtifactStore &store, const BacktestParams &p, const BacktestRun &run,
+                                        OutputFormat format, const std::string &file_type, int precision = -1);
+
+// Streamed output: one CSV file (file_type renko, trades or summary), NDJSON
+// records for the selected parts (file_type may also be "all"), or columnar
+// tables (renko, ichimoku, trades, summary or all of them).
+// `precision` is significant digits, 0 for shortest round-trip, or -1 for the
+// format's default (6 for CSV, shortest for NDJSON).
+// check_stream_selection throws std::runtime_error for other combinations.
+void check_stream_selection(OutputFormat format, const std::string &file_type, int precision = -1);
+void write_backtest_stream(ChunkWriter &out, OutputFormat format, const std::string &file_type,
+                           const BacktestRun &run, int precision = -1);
+std::string stream_filename(const BacktestParams &p, OutputFormat format, const std::string &file_type);
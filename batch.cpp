@@ -0,0 +1,222 @@
+#include "batch.h"
+#include "log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+using json = nlohmann::json;
+using namespace std;
+
+static const int MAX_BATCH_FETCHES = 16;
+
+BatchRequest batch_request_from_json(const json &data){
+    if(!data.contains("symbols") || !data["symbols"].is_array() || data["symbols"].empty())
+        throw runtime_error("symbols must be a non-empty list");
+    if(data["symbols"].size()>MAX_BATCH_SYMBOLS)
+        throw runtime_error("at most "+to_string(MAX_BATCH_SYMBOLS)+" symbols per batch");
+
+    json shared = data;
+    shared.erase("symbols");
+    shared.erase("max_concurrent_fetches");
+
+    BatchRequest req;
+    for(auto &entry:data["symbols"]){
+        json merged = shared;
+        if(entry.is_string()){
+            merged["symbol"] = entry;
+        } else if(entry.is_object()){
+            if(!entry.contains("symbol")) throw runtime_error("every symbols entry needs a symbol");
+            for(auto &field:entry.items()) merged[field.key()] = field.value();
+        } else {
+            throw runtime_error("symbols entries must be names or objects");
+        }
+        BatchItem item;
+        item.params = backtest_params_from_json(merged);
+        parse_source_type(item.params.source_type);   // throws on unsupported sources
+        item.weight = merged.value("weight", 1.0);
+        if(!isfinite(item.weight)) throw runtime_error("weight must be a finite number");
+        req.items.push_back(move(item));
+    }
+    req.max_fetches = min(max(data.value("max_concurrent_fetches", 4), 1), MAX_BATCH_FETCHES);
+    return req;
+}
+
+static int64_t elapsed_ms(chrono::steady_clock::time_point start){
+    return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now()-start).count();
+}
+
+static PortfolioSummary portfolio(const vector<BatchSymbolResult> &results){
+    PortfolioSummary p;
+    vector<pair<int64_t,double>> closes;
+    for(auto &r:results){
+        p.symbols++;
+        if(!r.ok){ p.failed++; continue; }
+        p.succeeded++;
+        for(auto &t:*r.run.trades) closes.emplace_back(t.exit_time,t.profit*r.weight);
+    }
+    p.trades = closes.size();
+    stable_sort(closes.begin(),closes.end(),[](const pair<int64_t,double> &a,const pair<int64_t,double> &b){
+        return a.first<b.first;
+    });
+    double equity = 0, peak = 0;
+    for(size_t i=0;i<closes.size();){
+        int64_t time = closes[i].first;
+        for(;i<closes.size() && closes[i].first==time;i++) equity += closes[i].second;
+        peak = max(peak,equity);
+        p.max_drawdown = max(p.max_drawdown,peak-equity);
+        p.equity.push_back({time,equity,peak-equity});
+    }
+    p.net_profit = equity;
+    return p;
+}
+
+PortfolioSummary run_batch(const BatchRequest &req,WorkStealingPool &fetch,WorkStealingPool &compute,
+                           const function<void(const BatchSymbolResult&)> &on_result){
+    size_t n = req.items.size();
+    // Compute tasks only touch this (and their own copies), so they may
+    // outlive the call if on_result throws.
+    struct Shared {
+        mutex mu;
+        condition_variable ready;
+        deque<BatchSymbolResult> done;
+        size_t fetchers_running = 0;
+    };
+    auto shared = make_shared<Shared>();
+    auto finish = [](Shared &s,BatchSymbolResult &&r){
+        lock_guard<mutex> lk(s.mu);
+        s.done.push_back(move(r));
+        s.ready.notify_all();
+    };
+
+    uint64_t log_id = log_request_id();
+    atomic<size_t> next{0};
+    atomic<bool> abandon{false};
+    auto fetch_loop = [&]{
+        LogRequest log_request(log_id);
+        for(size_t i; !abandon.load() && (i = next.fetch_add(1))<n; ){
+            auto start = chrono::steady_clock::now();
+            const BatchItem &item = req.items[i];
+            shared_ptr<const vector<Candle>> candles;
+            try {
+                candles = backtest_candles(item.params);
+            } catch(const exception &e){
+                BatchSymbolResult r;
+                r.index = i;
+                r.symbol = item.params.symbol;
+                r.weight = item.weight;
+                r.error = e.what();
+                r.processing_time_ms = elapsed_ms(start);
+                finish(*shared,move(r));
+                continue;
+            }
+            compute.submit([shared,finish,params = item.params,weight = item.weight,candles,i,start,log_id]{
+                LogRequest log_request(log_id);
+                BatchSymbolResult r;
+                r.index = i;
+                r.symbol = params.symbol;
+                r.weight = weight;
+                try {
+                    r.run = run_backtest(params,nullptr,candles);
+                    r.summary = summarize_trades(*r.run.trades);
+                    r.ok = true;
+                } catch(const exception &e){
+                    r.error = e.what();
+                }
+                r.processing_time_ms = elapsed_ms(start);
+                finish(*shared,move(r));
+            });
+        }
+    };
+
+    // fetch_loop uses this frame, so every task must have finished before
+    // run_batch returns, including ones still queued behind other batches.
+    size_t fetchers = min<size_t>(static_cast<size_t>(req.max_fetches),n);
+    shared->fetchers_running = fetchers;
+    for(size_t t=0;t<fetchers;t++){
+        fetch.submit([&,shared]{
+            fetch_loop();
+            lock_guard<mutex> lk(shared->mu);
+            shared->fetchers_running--;
+            shared->ready.notify_all();
+        });
+    }
+    auto join_fetchers = [&]{
+        unique_lock<mutex> lk(shared->mu);
+        shared->ready.wait(lk,[&]{ return shared->fetchers_running==0; });
+    };
+
+    vector<BatchSymbolResult> results;
+    results.reserve(n);
+    try {
+        while(results.size()<n){
+            unique_lock<mutex> lk(shared->mu);
+            shared->ready.wait(lk,[&]{ return !shared->done.empty(); });
+            BatchSymbolResult r = move(shared->done.front());
+            shared->done.pop_front();
+            lk.unlock();
+            on_result(r);
+            // The portfolio only needs the trades.
+            r.run.renko.reset();
+            r.run.ichimoku.reset();
+            results.push_back(move(r));
+        }
+    } catch(...){
+        abandon = true;
+        join_fetchers();
+        throw;
+    }
+    join_fetchers();
+    sort(results.begin(),results.end(),[](const BatchSymbolResult &a,const BatchSymbolResult &b){ return a.index<b.index; });
+    return portfolio(results);
+}
+
+static double round2(double v) { return round(v*100.0)/100.0; }
+
+json batch_symbol_to_json(const BatchSymbolResult &r){
+    json j = {
+        {"type", "symbol"},
+        {"index", r.index},
+        {"symbol", r.symbol},
+        {"success", r.ok}
+    };
+    if(!r.ok){
+        j["error"] = r.error;
+    } else {
+        const TradeSummary &s = r.summary;
+        j["weight"] = r.weight;
+        j["renko_bricks"] = r.run.renko->size();
+        j["trades"] = s.total_trades;
+        j["net_profit"] = round2(s.total_profit);
+        j["winning_trades"] = s.winning_trades;
+        j["losing_trades"] = s.losing_trades;
+        j["win_rate"] = s.total_trades ? round(static_cast<double>(s.winning_trades)/s.total_trades*10000.0)/10000.0 : 0.0;
+        j["max_drawdown"] = round2(s.max_drawdown);
+    }
+    j["processing_time_ms"] = r.processing_time_ms;
+    return j;
+}
+
+json portfolio_to_json(const PortfolioSummary &p,int64_t processing_time_ms){
+    json rows = json::array();
+    for(auto &e:p.equity) rows.push_back({epoch_to_ist_iso(e.time), round2(e.equity), round2(e.drawdown)});
+    return {
+        {"type", "portfolio"},
+        {"symbols", p.symbols},
+        {"succeeded", p.succeeded},
+        {"failed", p.failed},
+        {"trades", p.trades},
+        {"net_profit", round2(p.net_profit)},
+        {"max_drawdown", round2(p.max_drawdown)},
+        {"processing_time_ms", processing_time_ms},
+        {"columns", {"time","equity","drawdown"}},
+        {"equity_curve", rows}
+    };
+}
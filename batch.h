@@ -0,0 +1,79 @@
+#pragma once
+
+#include "backtest.h"
+#include "strategy.h"
+#include "thread_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+// /backtest over a list of symbols, run concurrently.
+//
+// Downloads run as at most max_fetches tasks on the shared fetch pool, so a
+// large universe does not open hundreds of exchange connections at once and
+// concurrent batches share one bound. As each symbol's candles arrive, its
+// Renko -> Ichimoku -> strategy stages are queued on the shared compute pool
+// and the fetch task moves on to the next symbol.
+// Results are reported in completion order, so one slow symbol does not
+// hold up the others.
+struct BatchItem {
+    BacktestParams params;
+    double weight = 1.0;   // multiplies the symbol's P&L in the portfolio
+};
+
+// POST /backtest/batch holds an HTTP thread until the last symbol is done,
+// so it takes fewer symbols than a "batch" job.
+const size_t MAX_BATCH_SYMBOLS = 500;
+const size_t MAX_INLINE_BATCH_SYMBOLS = 50;
+
+struct BatchRequest {
+    std::vector<BatchItem> items;
+    int max_fetches = 4;
+};
+
+// "symbols" lists names or objects; every other field is shared and an
+// object's fields override it for that symbol:
+//   {"symbols": ["BTCUSD", {"symbol": "ETHUSD", "brick_size": 20}], "brick_size": 40}
+// Throws std::runtime_error on invalid input.
+BatchRequest batch_request_from_json(const nlohmann::json &data);
+
+struct BatchSymbolResult {
+    size_t index = 0;   // position in BatchRequest::items
+    std::string symbol;
+    double weight = 1.0;
+    bool ok = false;
+    std::string error;
+    BacktestRun run;   // set when ok
+    TradeSummary summary;
+    int64_t processing_time_ms = 0;
+};
+
+// Closed-trade P&L of every symbol, weighted and summed in exit-time order.
+// Trades closing at the same second make one point.
+struct EquityPoint {
+    int64_t time;
+    double equity, drawdown;
+};
+
+struct PortfolioSummary {
+    size_t symbols = 0, succeeded = 0, failed = 0, trades = 0;
+    double net_profit = 0, max_drawdown = 0;
+    std::vector<EquityPoint> equity;
+};
+
+// Calls on_result on the calling thread as each symbol finishes, then
+// returns the portfolio over the symbols that succeeded. A failing symbol
+// is reported, not thrown; an exception from on_result stops the batch and
+// is rethrown.
+PortfolioSummary run_batch(const BatchRequest &req, WorkStealingPool &fetch, WorkStealingPool &compute,
+                           const std::function<void(const BatchSymbolResult&)> &on_result);
+
+// NDJSON records: {"type":"symbol",...} per symbol and a final
+// {"type":"portfolio",...} with the equity curve as compact rows.
+nlohmann::json batch_symbol_to_json(const BatchSymbolResult &r);
+nlohmann::json portfolio_to_json(const PortfolioSummary &p, int64_t processing_time_ms);
@@ -0,0 +1,312 @@
+// Per-stage throughput and latency of the backtest pipeline on seeded
+// synthetic candles, written as JSON for tracking between releases.
+//
+//   backtest_bench [--sizes 1k,100k,1M] [--regimes random_walk,trending,choppy,gaps]
+//                  [--stages build_renko,...] [--brick 20] [--reversal 40] [--source close]
+//                  [--seed 7] [--min-time-ms 200] [--max-reps 1000] [--out results.json]
+//
+// Sizes take k/M suffixes, up to 50M candles. Each stage runs on the
+// previous stage's output and repeats until it has run for --min-time-ms
+// or --max-reps times (at least once); min, median and mean are reported.
+// run_rules is the built-in rule set compiled as rule expressions, for
+// comparison with run_strategy; before timing it is checked to give the same
+// trades, and custom rules are checked on a fixed series. JSON goes to --out
+// or stdout, a readable table to stderr. Exits 1 when a check fails.
+
+#include "export_writer.h"
+#include "rules.h"
+#include "strategy.h"
+#include "synthetic.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <nlohmann/json.hpp>
+
+using namespace std;
+using json = nlohmann::json;
+
+static const size_t MAX_CANDLES = 50000000;
+
+static const vector<string> STAGES = {
+    "build_renko", "donchian_mid", "ichimoku_on_renko", "run_strategy", "run_rules",
+    "renko_to_csv_string", "trades_to_csv_string", "summary_to_csv_string", "write_renko_csv"
+};
+
+struct Options {
+    vector<size_t> sizes = {1000, 100000, 1000000};
+    vector<MarketRegime> regimes = {MarketRegime::RandomWalk, MarketRegime::Trending,
+                                    MarketRegime::Choppy, MarketRegime::Gaps};
+    vector<string> stages = STAGES;
+    double brick = 20, reversal = 40;
+    string source = "close";
+    int tenkan = 5, kijun = 26, span_b = 52;
+    uint64_t seed = 7;
+    double min_time_ms = 200;
+    int max_reps = 1000;
+    string out;
+};
+
+static vector<string> split(const string &s){
+    vector<string> parts;
+    stringstream ss(s);
+    for(string part; getline(ss,part,',');) if(!part.empty()) parts.push_back(part);
+    return parts;
+}
+
+static size_t parse_size(const string &s){
+    char *end = nullptr;
+    double v = strtod(s.c_str(),&end);
+    if(end && (*end=='k' || *end=='K')) v *= 1e3;
+    else if(end && (*end=='m' || *end=='M')) v *= 1e6;
+    else if(end && *end) throw runtime_error("Bad size: "+s);
+    if(!(v>=1) || v>MAX_CANDLES) throw runtime_error("Sizes must be between 1 and 50M: "+s);
+    return static_cast<size_t>(v);
+}
+
+static Options parse_options(int argc,char **argv){
+    Options o;
+    for(int i=1;i<argc;i++){
+        string arg = argv[i];
+        if(i+1>=argc) throw runtime_error("Missing value for "+arg);
+        string value = argv[++i];
+        if(arg=="--sizes"){
+            o.sizes.clear();
+            for(auto &s:split(value)) o.sizes.push_back(parse_size(s));
+        } else if(arg=="--regimes"){
+            o.regimes.clear();
+            for(auto &s:split(value)) o.regimes.push_back(parse_market_regime(s));
+        } else if(arg=="--stages"){
+            o.stages = split(value);
+            for(auto &s:o.stages)
+                if(find(STAGES.begin(),STAGES.end(),s)==STAGES.end()) throw runtime_error("Unknown stage: "+s);
+        } else if(arg=="--brick") o.brick = atof(value.c_str());
+        else if(arg=="--reversal") o.reversal = atof(value.c_str());
+        else if(arg=="--source"){ o.source = value; parse_source_type(value); }
+        else if(arg=="--seed") o.seed = strtoull(value.c_str(),nullptr,10);
+        else if(arg=="--min-time-ms") o.min_time_ms = atof(value.c_str());
+        else if(arg=="--max-reps") o.max_reps = max(1,atoi(value.c_str()));
+        else if(arg=="--out") o.out = value;
+        else throw runtime_error("Unknown option: "+arg);
+    }
+    if(!(o.brick>0) || !(o.reversal>0)) throw runtime_error("--brick and --reversal must be positive");
+    return o;
+}
+
+struct Timing {
+    int reps = 0;
+    double min_ms = 0, median_ms = 0, mean_ms = 0;
+};
+
+static volatile size_t sink;
+
+// Runs f until min_time_ms has passed or max_reps runs, at least once.
+template <class F>
+static Timing measure(const Options &o,F &&f){
+    vector<double> ms;
+    double total = 0;
+    while(ms.empty() || (total<o.min_time_ms && static_cast<int>(ms.size())<o.max_reps)){
+        auto t0 = chrono::steady_clock::now();
+        sink = f();
+        ms.push_back(chrono::duration<double,milli>(chrono::steady_clock::now()-t0).count());
+        total += ms.back();
+    }
+    sort(ms.begin(),ms.end());
+    Timing t;
+    t.reps = static_cast<int>(ms.size());
+    t.min_ms = ms.front();
+    t.median_ms = ms.size()%2 ? ms[ms.size()/2] : (ms[ms.size()/2-1]+ms[ms.size()/2])/2;
+    t.mean_ms = total/ms.size();
+    return t;
+}
+
+static bool wanted(const Options &o,const string &stage){
+    return find(o.stages.begin(),o.stages.end(),stage)!=o.stages.end();
+}
+
+static bool same_trades(const vector<Trade> &a,const vector<Trade> &b){
+    if(a.size()!=b.size()) return false;
+    for(size_t i=0;i<a.size();i++){
+        if(a[i].entry_time!=b[i].entry_time || a[i].exit_time!=b[i].exit_time ||
+           a[i].entry_price!=b[i].entry_price || a[i].exit_price!=b[i].exit_price ||
+           a[i].direction!=b[i].direction || a[i].profit!=b[i].profit) return false;
+    }
+    return true;
+}
+
+// Custom rules on closes 100, 101, 110, 90 (the other columns NaN, so the
+// default exits never fire). One position at a time: entries that fire
+// together are ignored, as is the other side's entry while a position is
+// open, and profit follows the direction of the trade.
+static bool check_rule_positions(){
+    const double closes[] = {100, 101, 110, 90};
+    vector<IchimokuRow> rows;
+    for(size_t i=0;i<4;i++) rows.push_back(IchimokuRow{static_cast<int64_t>(i), closes[i], NAN, NAN, NAN, NAN, NAN});
+    auto rules = [](const char *le,const char *lx,const char *se,const char *sx){
+        return RuleSet(le ? le : default_rule(RuleKind::LongEntry),lx ? lx : default_rule(RuleKind::LongExit),
+                       se ? se : default_rule(RuleKind::ShortEntry),sx ? sx : default_rule(RuleKind::ShortExit));
+    };
+    bool ok = run_rules(rows,rules("close > 100",nullptr,"close > 100",nullptr)).empty();
+    ok = ok && same_trades(run_rules(rows,rules("close > 100","false","close > 105",nullptr)),
+                           {Trade{1, 101, 3, 90, TradeDirection::Long, -11}});
+    ok = ok && same_trades(run_rules(rows,rules("close > 100 and close < 105","close > 105","close > 105","close < 95")),
+                           {Trade{1, 101, 2, 110, TradeDirection::Long, 9}, Trade{2, 110, 3, 90, TradeDirection::Short, 20}});
+    return ok;
+}
+
+static string utc_now(){
+    time_t now = time(nullptr);
+    char buf[32];
+    strftime(buf,sizeof(buf),"%Y-%m-%dT%H:%M:%SZ",gmtime(&now));
+    return buf;
+}
+
+int main(int argc,char **argv){
+    Options o;
+    try {
+        o = parse_options(argc,argv);
+    } catch(const exception &e){
+        cerr << e.what() << endl;
+        return 2;
+    }
+    SourceType source = parse_source_type(o.source);
+    if(wanted(o,"run_rules") && !check_rule_positions()){
+        cerr << "run_rules: wrong trades for custom rules" << endl;
+        return 1;
+    }
+
+    json results = json::array();
+    fprintf(stderr,"%-12s %10s %-22s %10s %5s %10s %10s %12s\n",
+            "regime","candles","stage","items","reps","min ms","median ms","items/s");
+    for(MarketRegime regime:o.regimes){
+        for(size_t n:o.sizes){
+            SyntheticSpec spec;
+            spec.regime = regime;
+            spec.candles = n;
+            spec.seed = o.seed;
+            vector<Candle> candles = synthetic_candles(spec);
+
+            // Inputs for every stage, built once outside the timings.
+            vector<RenkoBrick> renko = build_renko(candles,o.brick,o.reversal,source);
+            vector<double> closes(renko.size());
+            for(size_t i=0;i<renko.size();i++) closes[i] = renko[i].close;
+            vector<IchimokuRow> ichimoku = ichimoku_on_renko(renko,o.tenkan,o.kijun,o.span_b);
+            vector<Trade> trades = run_strategy(ichimoku);
+
+            auto report = [&](const string &stage,size_t items,size_t bytes,const Timing &t){
+                double per_sec = t.min_ms>0 ? items/(t.min_ms/1e3) : 0;
+                fprintf(stderr,"%-12s %10zu %-22s %10zu %5d %10.3f %10.3f %12.4g\n",
+                        market_regime_name(regime),n,stage.c_str(),items,t.reps,t.min_ms,t.median_ms,per_sec);
+                json row = {
+                    {"regime", market_regime_name(regime)},
+                    {"candles", n},
+                    {"stage", stage},
+                    {"items", items},
+                    {"reps", t.reps},
+                    {"min_ms", t.min_ms},
+                    {"median_ms", t.median_ms},
+                    {"mean_ms", t.mean_ms},
+                    {"items_per_sec", per_sec}
+                };
+                if(bytes){
+                    row["bytes"] = bytes;
+                    row["mb_per_sec"] = t.min_ms>0 ? bytes/1e6/(t.min_ms/1e3) : 0;
+                }
+                results.push_back(row);
+            };
+
+            if(wanted(o,"build_renko"))
+                report("build_renko",n,0,measure(o,[&]{ return build_renko(candles,o.brick,o.reversal,source).size(); }));
+            if(wanted(o,"donchian_mid")){
+                vector<double> mid(closes.size());
+                report("donchian_mid",closes.size(),0,measure(o,[&]{
+                    donchian_mid(closes.data(),closes.size(),o.kijun,mid.data());
+                    return mid.size();
+                }));
+            }
+            if(wanted(o,"ichimoku_on_renko"))
+                report("ichimoku_on_renko",renko.size(),0,measure(o,[&]{
+                    return ichimoku_on_renko(renko,o.tenkan,o.kijun,o.span_b).size();
+                }));
+            if(wanted(o,"run_strategy"))
+                report("run_strategy",ichimoku.size(),0,measure(o,[&]{ return run_strategy(ichimoku).size(); }));
+            if(wanted(o,"run_rules")){
+                RuleSet rules(default_rule(RuleKind::LongEntry),default_rule(RuleKind::LongExit),
+                              default_rule(RuleKind::ShortEntry),default_rule(RuleKind::ShortExit));
+                if(!same_trades(run_rules(ichimoku,rules),trades)){
+                    cerr << "run_rules: trades differ from run_strategy on " << market_regime_name(regime)
+                         << " " << n << endl;
+                    return 1;
+                }
+                report("run_rules",ichimoku.size(),0,measure(o,[&]{ return run_rules(ichimoku,rules).size(); }));
+            }
+            if(wanted(o,"renko_to_csv_string")){
+                size_t bytes = renko_to_csv_string(renko).size();
+                report("renko_to_csv_string",renko.size(),bytes,measure(o,[&]{ return renko_to_csv_string(renko).size(); }));
+            }
+            if(wanted(o,"trades_to_csv_string")){
+                size_t bytes = trades_to_csv_string(trades).size();
+                report("trades_to_csv_string",trades.size(),bytes,measure(o,[&]{ return trades_to_csv_string(trades).size(); }));
+            }
+            if(wanted(o,"summary_to_csv_string"))
+                report("summary_to_csv_string",trades.size(),0,measure(o,[&]{ return summary_to_csv_string(trades).size(); }));
+            if(wanted(o,"write_renko_csv")){
+                // Streaming path: formatted into the chunk buffer, nothing kept.
+                size_t bytes = 0;
+                auto write = [&]{
+                    ChunkWriter out([](const char*,size_t){});
+                    write_renko_csv(out,renko);
+                    out.flush();
+                    return bytes = out.bytes_written();
+                };
+                write();
+                report("write_renko_csv",renko.size(),bytes,measure(o,write));
+            }
+        }
+    }
+
+    json doc = {
+        {"benchmark", "backtest_bench"},
+        {"schema", 1},
+        {"timestamp", utc_now()},
+#ifdef NDEBUG
+        {"build", "release"},
+#else
+        {"build", "debug"},
+#endif
+        {"compiler", __VERSION__},
+        {"hardware_threads", thread::hardware_concurrency()},
+        {"config", {
+            {"brick_size", o.brick},
+            {"reversal_size", o.reversal},
+            {"source_type", o.source},
+            {"tenkan", o.tenkan},
+            {"kijun", o.kijun},
+            {"span_b", o.span_b},
+            {"seed", o.seed},
+            {"min_time_ms", o.min_time_ms},
+            {"max_reps", o.max_reps}
+        }},
+        {"results", results}
+    };
+    if(o.out.empty()){
+        cout << doc.dump(2) << endl;
+    } else {
+        ofstream f(o.out);
+        f << doc.dump(2) << endl;
+        if(!f){
+            cerr << "Could not write " << o.out << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,131 @@
+// Compares the export writers against the ostringstream CSV generators
+// they replaced, on synthetic Renko bricks and trades.
+//
+//   csv_bench [rows]
+//
+// Both must produce identical bytes. Rows default to 1,000,000 bricks, one
+// per minute of a seeded random walk, with half as many trades.
+
+#include "export_writer.h"
+#include "strategy.h"
+#include "synthetic.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+// The generators as they were in strategy.cpp, kept as the reference.
+static string legacy_renko_to_csv_string(const vector<RenkoBrick> &rows){
+    ostringstream oss;
+    oss << "brick_time,open,high,low,close,dir,reversal\n";
+    for(auto &r:rows){
+        oss << epoch_to_ist_iso(r.brick_time) << ","
+            << r.open << ","
+            << r.high << ","
+            << r.low << ","
+            << r.close << ","
+            << r.dir << ","
+            << (r.reversal ? "true" : "false") << "\n";
+    }
+    return oss.str();
+}
+
+static string legacy_trades_to_csv_string(const vector<Trade> &trades){
+    ostringstream oss;
+    oss << "entry_time,entry_price,exit_time,exit_price,direction,profit\n";
+    for(auto &t:trades){
+        oss << epoch_to_ist_iso(t.entry_time) << ","
+            << t.entry_price << ","
+            << epoch_to_ist_iso(t.exit_time) << ","
+            << t.exit_price << ","
+            << trade_direction_name(t.direction) << ","
+            << t.profit << "\n";
+    }
+    return oss.str();
+}
+
+static string legacy_summary_to_csv_string(const vector<Trade> &trades){
+    ostringstream oss;
+    oss << "total_trades,total_profit,winning_trades,losing_trades,max_drawdown\n";
+    if(trades.empty()){
+        oss << "0,0,0,0,0\n";
+        return oss.str();
+    }
+    TradeSummary s = summarize_trades(trades);
+    oss << s.total_trades << "," << s.total_profit << "," << s.winning_trades << "," << s.losing_trades << "," << s.max_drawdown << "\n";
+    return oss.str();
+}
+
+// One brick per random-walk candle from bench/synthetic.h, spanning the
+// previous close to this one, and a trade over every second brick.
+static void synthetic(size_t rows,vector<RenkoBrick> &bricks,vector<Trade> &trades){
+    SyntheticSpec spec;
+    spec.candles = rows;
+    spec.volatility = 40.0;
+    vector<Candle> candles = synthetic_candles(spec);
+    bricks.reserve(rows);
+    trades.reserve(rows/2);
+    double price = spec.start_price;
+    for(size_t i=0;i<candles.size();i++){
+        double next = candles[i].close;
+        int64_t t = candles[i].time;
+        RenkoBrick b{};
+        b.brick_time = t;
+        b.brick_start_time = t-spec.interval;
+        b.open = price;
+        b.close = next;
+        b.high = max(price,next);
+        b.low = min(price,next);
+        b.dir = next>=price ? 1 : -1;
+        b.reversal = i%7==0;
+        bricks.push_back(b);
+        if(i%2==1){
+            const RenkoBrick &e = bricks[i-1];
+            trades.push_back({e.brick_time,e.close,t,next,i%4==1 ? TradeDirection::Long : TradeDirection::Short,next-e.close});
+        }
+        price = next;
+    }
+}
+
+template <class F>
+static double time_ms(F &&f,int iters){
+    auto t0 = chrono::steady_clock::now();
+    for(int i=0;i<iters;i++) f();
+    return chrono::duration<double,milli>(chrono::steady_clock::now()-t0).count()/iters;
+}
+
+template <class Legacy,class Fast>
+static bool run(const char *name,Legacy legacy,Fast fast,int iters){
+    string want = legacy(), got = fast();
+    if(want!=got){
+        size_t i = 0;
+        while(i<want.size() && i<got.size() && want[i]==got[i]) i++;
+        cerr << name << ": output differs at byte " << i << " (" << want.size() << " vs " << got.size() << " bytes)" << endl;
+        return false;
+    }
+    double legacy_ms = time_ms(legacy,iters);
+    double fast_ms = time_ms(fast,iters);
+    double mb = want.size()/1e6;
+    printf("%-8s %9.2f MB | ostringstream %8.2f ms %7.1f MB/s | writer %8.2f ms %7.1f MB/s | %5.2fx\n",
+           name,mb,legacy_ms,mb/(legacy_ms/1e3),fast_ms,mb/(fast_ms/1e3),legacy_ms/fast_ms);
+    return true;
+}
+
+int main(int argc,char **argv){
+    size_t rows = argc>1 ? strtoull(argv[1],nullptr,10) : 1000000;
+    vector<RenkoBrick> bricks;
+    vector<Trade> trades;
+    synthetic(rows,bricks,trades);
+    int iters = max(1,static_cast<int>(3000000/max<size_t>(rows,1)));
+
+    bool ok = true;
+    ok &= run("renko",[&]{ return legacy_renko_to_csv_string(bricks); },[&]{ return renko_to_csv_string(bricks); },iters);
+    ok &= run("trades",[&]{ return legacy_trades_to_csv_string(trades); },[&]{ return trades_to_csv_string(trades); },iters);
+    ok &= run("summary",[&]{ return legacy_summary_to_csv_string(trades); },[&]{ return summary_to_csv_string(trades); },iters);
+    ok &= run("empty",[&]{ return legacy_summary_to_csv_string({}); },[&]{ return summary_to_csv_string({}); },iters);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+// Compares decode_candles against the nlohmann::json DOM path that
+// fetch_candles used before, on recorded /v2/history/candles payloads.
+//
+//   decode_bench [payload.json ...]
+//
+// Without arguments it synthesizes 4000-row array-row and object-row
+// payloads. Both decoders must produce identical candles.
+
+#include "candle_decoder.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+using namespace std;
+
+// The DOM decoder as it was in fetch_candles, kept as the reference.
+static void legacy_parse_candles_json(const string &body, vector<Candle> &out){
+    json j = json::parse(body);
+    if(!j.contains("result")) return;
+    json arr = j["result"];
+    if(arr.is_null()||arr.empty()) return;
+    for(auto &item:arr){
+        if(item.is_array() && item.size() >= 5) {
+            // Helper lambda to safely get double (0.0 if null or missing)
+            auto safe_get_double = [](const json& j, double fallback = 0.0) -> double {
+                if (j.is_number()) return j.get<double>();
+                if (j.is_null()) return fallback;
+                try { return j.get<double>(); }
+                catch(...) { return fallback; }
+                return fallback;
+            };
+
+            int64_t time = item[0].get<int64_t>();
+            double open = safe_get_double(item[1]);
+            double high = safe_get_double(item[2]);
+            double low = safe_get_double(item[3]);
+            double close = safe_get_double(item[4]);
+            double volume = (item.size() > 5) ? safe_get_double(item[5]) : 0.0;
+
+            // Skip invalid candles (e.g., all zeros)
+            if (open == 0 && high == 0 && low == 0 && close == 0) {
+                continue;
+            }
+
+            out.push_back({time, open, high, low, close, volume});
+        }
+        else if(item.is_object()){
+            // Same safe handling for object format
+            auto get_or_zero = [](const json& j, const char* key) {
+                return j.contains(key) && !j[key].is_null() ? j[key].get<double>() : 0.0;
+            };
+            out.push_back({
+                item.value("time", 0),
+                get_or_zero(item, "open"),
+                get_or_zero(item, "high"),
+                get_or_zero(item, "low"),
+                get_or_zero(item, "close"),
+                get_or_zero(item, "volume")
+            });
+        }
+    }
+}
+
+static string synthetic_payload(size_t rows,bool object_rows){
+    mt19937_64 rng(42);
+    normal_distribution<double> step(0.0,2.0);
+    ostringstream oss;
+    oss.precision(10);
+    oss << "{\"success\":true,\"result\":[";
+    double price = 1850.0;
+    int64_t t = 1690848000;
+    for(size_t i=0;i<rows;i++){
+        double o = price, c = price+step(rng);
+        double h = max(o,c)+fabs(step(rng)), l = min(o,c)-fabs(step(rng));
+        double v = 1000+fabs(step(rng))*100;
+        if(i) oss << ",";
+        if(object_rows)
+            oss << "{\"time\":" << t << ",\"open\":" << o << ",\"high\":" << h << ",\"low\":" << l
+                << ",\"close\":" << c << ",\"volume\":" << v << "}";
+        else
+            oss << "[" << t << "," << o << "," << h << "," << l << "," << c << "," << v << "]";
+        price = c; t += 60;
+    }
+    oss << "]}";
+    return oss.str();
+}
+
+static bool same(const vector<Candle> &a,const vector<Candle> &b){
+    if(a.size()!=b.size()) return false;
+    for(size_t i=0;i<a.size();i++){
+        if(a[i].time!=b[i].time || a[i].open!=b[i].open || a[i].high!=b[i].high ||
+           a[i].low!=b[i].low || a[i].close!=b[i].close || a[i].volume!=b[i].volume) return false;
+    }
+    return true;
+}
+
+template <class F>
+static double time_ns_per_iter(F &&f,int iters){
+    auto t0 = chrono::steady_clock::now();
+    for(int i=0;i<iters;i++) f();
+    return chrono::duration<double,nano>(chrono::steady_clock::now()-t0).count()/iters;
+}
+
+static bool run(const string &name,const string &body){
+    vector<Candle> dom, sax;
+    try {
+        legacy_parse_candles_json(body,dom);
+        sax.reserve(dom.size());
+        decode_candles(body,sax);
+    } catch(const exception &e){
+        cerr << name << ": " << e.what() << endl;
+        return false;
+    }
+    if(!same(dom,sax)){
+        cerr << name << ": decoders disagree (" << dom.size() << " vs " << sax.size() << " candles)" << endl;
+        return false;
+    }
+    int iters = max(10,static_cast<int>(200000000/max<size_t>(body.size(),1)/10));
+    double dom_ns = time_ns_per_iter([&]{ dom.clear(); legacy_parse_candles_json(body,dom); },iters);
+    double sax_ns = time_ns_per_iter([&]{ sax.clear(); decode_candles(body,sax); },iters);
+    double mb = body.size()/1e6;
+    printf("%-24s %7zu rows %8.2f MB | dom %9.1f us %7.1f MB/s | decoder %9.1f us %7.1f MB/s | %5.2fx\n",
+           name.c_str(),sax.size(),mb,dom_ns/1e3,mb/(dom_ns/1e9),sax_ns/1e3,mb/(sax_ns/1e9),dom_ns/sax_ns);
+    return true;
+}
+
+int main(int argc,char **argv){
+    bool ok = true;
+    if(argc>1){
+        for(int i=1;i<argc;i++){
+            ifstream in(argv[i],ios::binary);
+            if(!in){ cerr << "cannot read " << argv[i] << endl; return 1; }
+            ostringstream ss; ss << in.rdbuf();
+            ok &= run(argv[i],ss.str());
+        }
+    }else{
+        ok &= run("synthetic array rows",synthetic_payload(4000,false));
+        ok &= run("synthetic object rows",synthetic_payload(4000,true));
+    }
+    return ok ? 0 : 1;
+}
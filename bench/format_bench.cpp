@@ -0,0 +1,315 @@
+// Compares the JSON-with-CSV response of /backtest against columnar output,
+// each uncompressed, gzip and (when built in) zstd, on a synthetic run.
+//
+//   format_bench [candles] [brick_size]
+//
+// Server time is formatting, serialization and compression as the handlers
+// do it; client time is decompression plus loading every table into typed
+// columns (JSON parse and CSV number parsing, or reading the columns in
+// place). End-to-end adds the transfer at 100 Mbit/s and 1 Gbit/s. The
+// columnar payload is decoded back and checked against the run.
+// Candles default to 2,000,000 one-minute rows with a brick size of 2.
+
+#include "backtest.h"
+#include "compression.h"
+#include "export_writer.h"
+#include "strategy.h"
+#include "synthetic.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <zlib.h>
+#ifdef BACKTEST_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+using namespace std;
+using json = nlohmann::json;
+
+template <class F>
+static double time_ms(F &&f,int iters){
+    auto t0 = chrono::steady_clock::now();
+    for(int i=0;i<iters;i++) f();
+    return chrono::duration<double,milli>(chrono::steady_clock::now()-t0).count()/iters;
+}
+
+// -------- DECOMPRESSION --------
+static string decompress(ContentEncoding encoding,const string &in){
+    if(encoding==ContentEncoding::Identity) return in;
+    string out;
+    char buf[64*1024];
+    if(encoding==ContentEncoding::Gzip){
+        z_stream z{};
+        inflateInit2(&z,15+16);
+        z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+        z.avail_in = static_cast<uInt>(in.size());
+        int rc;
+        do {
+            z.next_out = reinterpret_cast<Bytef*>(buf);
+            z.avail_out = sizeof(buf);
+            rc = inflate(&z,Z_NO_FLUSH);
+            if(rc!=Z_OK && rc!=Z_STREAM_END) throw runtime_error("inflate failed");
+            out.append(buf,sizeof(buf)-z.avail_out);
+        } while(rc!=Z_STREAM_END);
+        inflateEnd(&z);
+        return out;
+    }
+#ifdef BACKTEST_HAVE_ZSTD
+    ZSTD_DCtx *d = ZSTD_createDCtx();
+    ZSTD_inBuffer src{in.data(),in.size(),0};
+    while(src.pos<src.size){
+        ZSTD_outBuffer dst{buf,sizeof(buf),0};
+        size_t rc = ZSTD_decompressStream(d,&dst,&src);
+        if(ZSTD_isError(rc)) throw runtime_error(ZSTD_getErrorName(rc));
+        out.append(buf,dst.pos);
+    }
+    ZSTD_freeDCtx(d);
+#endif
+    return out;
+}
+
+// -------- CLIENT SIDE: JSON WITH CSV --------
+// What a dataframe loader does with a CSV string: split, parse numbers and
+// timestamps into columns.
+struct CsvColumns {
+    vector<vector<double>> numbers;
+    size_t rows = 0;
+};
+
+static int64_t days_from_civil(int y,unsigned m,unsigned d){
+    y -= m<=2;
+    int era = (y>=0 ? y : y-399)/400;
+    unsigned yoe = static_cast<unsigned>(y-era*400);
+    unsigned doy = (153*(m+(m>2 ? -3 : 9))+2)/5+d-1;
+    unsigned doe = yoe*365+yoe/4-yoe/100+doy;
+    return era*146097+static_cast<int>(doe)-719468;
+}
+
+static double parse_field(const char *p,const char *end){
+    // "YYYY-MM-DDTHH:MM:SS" (IST) to Unix seconds
+    if(end-p==19 && p[4]=='-' && p[10]=='T'){
+        auto num = [](const char *s,int n){ int v = 0; for(int i=0;i<n;i++) v = v*10+(s[i]-'0'); return v; };
+        int64_t days = days_from_civil(num(p,4),num(p+5,2),num(p+8,2));
+        return static_cast<double>(days*86400+num(p+11,2)*3600+num(p+14,2)*60+num(p+17,2)-19800);
+    }
+    if(*p=='t') return 1;
+    if(*p=='f') return 0;
+    if(*p=='l') return 1;
+    if(*p=='s') return -1;
+    return strtod(p,nullptr);
+}
+
+static CsvColumns parse_csv(const string &csv){
+    CsvColumns c;
+    size_t pos = csv.find('\n');
+    if(pos==string::npos) return c;
+    size_t columns = 1;
+    for(size_t i=0;i<pos;i++) columns += csv[i]==',';
+    c.numbers.resize(columns);
+    const char *p = csv.data()+pos+1, *end = csv.data()+csv.size();
+    while(p<end){
+        for(size_t col=0;col<columns;col++){
+            const char *f = p;
+            while(p<end && *p!=',' && *p!='\n') p++;
+            c.numbers[col].push_back(parse_field(f,p));
+            p++;
+        }
+        c.rows++;
+    }
+    return c;
+}
+
+static size_t load_json_response(const string &body){
+    json doc = json::parse(body);
+    size_t rows = 0;
+    for(auto &file:doc["csv_files"]) rows += parse_csv(file["content"].get_ref<const string&>()).rows;
+    return rows;
+}
+
+// -------- CLIENT SIDE: COLUMNAR --------
+struct Column {
+    string name;
+    uint8_t type;
+    const char *data;
+};
+
+struct Table {
+    string name;
+    uint64_t rows;
+    vector<Column> columns;
+};
+
+static size_t align8(size_t v) { return (v+7)&~size_t(7); }
+
+template <class T>
+static T read_le(const string &buf,size_t &pos){
+    if(pos+sizeof(T)>buf.size()) throw runtime_error("columnar: truncated");
+    T v;
+    memcpy(&v,buf.data()+pos,sizeof(T));
+    pos += sizeof(T);
+    return v;
+}
+
+static string read_name(const string &buf,size_t &pos){
+    uint32_t len = read_le<uint32_t>(buf,pos);
+    if(pos+len>buf.size()) throw runtime_error("columnar: truncated");
+    string name = buf.substr(pos,len);
+    pos += len;
+    return name;
+}
+
+static size_t type_width(uint8_t type){
+    switch(type){
+    case 1: case 2: return 8;
+    case 3: case 4: return 1;
+    }
+    throw runtime_error("columnar: unknown type");
+}
+
+// Columns point into `buf`; a loader would wrap them as arrays without copying.
+static vector<Table> read_columnar(const string &buf){
+    if(buf.size()<16 || memcmp(buf.data(),"BTCOL\0\0\0",8)!=0) throw runtime_error("columnar: bad magic");
+    size_t pos = 8;
+    if(read_le<uint32_t>(buf,pos)!=COLUMNAR_VERSION) throw runtime_error("columnar: version");
+    uint32_t count = read_le<uint32_t>(buf,pos);
+    vector<Table> tables(count);
+    for(auto &t:tables){
+        t.name = read_name(buf,pos);
+        pos = align8(pos);
+        t.rows = read_le<uint64_t>(buf,pos);
+        uint32_t columns = read_le<uint32_t>(buf,pos);
+        read_le<uint32_t>(buf,pos);
+        for(uint32_t i=0;i<columns;i++){
+            Column c;
+            c.name = read_name(buf,pos);
+            c.type = read_le<uint8_t>(buf,pos);
+            pos = align8(pos);
+            c.data = buf.data()+pos;
+            pos = align8(pos+t.rows*type_width(c.type));
+            if(pos>buf.size()) throw runtime_error("columnar: truncated");
+            t.columns.push_back(c);
+        }
+    }
+    return tables;
+}
+
+static size_t load_columnar(const string &buf){
+    // Touch every value, as converting to a dataframe would.
+    size_t rows = 0;
+    double sink = 0;
+    for(auto &t:read_columnar(buf)){
+        rows += t.rows;
+        for(auto &c:t.columns){
+            if(c.type!=2) continue;
+            const double *v = reinterpret_cast<const double*>(c.data);
+            for(uint64_t i=0;i<t.rows;i++) sink += v[i];
+        }
+    }
+    volatile double keep = sink;
+    (void)keep;
+    return rows;
+}
+
+template <class T>
+static T value_at(const Column &c,size_t i){
+    T v;
+    memcpy(&v,c.data+i*sizeof(T),sizeof(T));
+    return v;
+}
+
+static bool same(double a,double b) { return a==b || (isnan(a) && isnan(b)); }
+
+static bool check_columnar(const string &buf,const BacktestRun &run){
+    auto tables = read_columnar(buf);
+    if(tables.size()!=4) return false;
+    const Table &renko = tables[0], &ichimoku = tables[1], &trades = tables[2], &summary = tables[3];
+    if(renko.rows!=run.renko->size() || ichimoku.rows!=run.ichimoku->size() || trades.rows!=run.trades->size()) return false;
+    for(size_t i=0;i<renko.rows;i++){
+        const RenkoBrick &b = (*run.renko)[i];
+        if(value_at<int64_t>(renko.columns[0],i)!=b.brick_time || value_at<double>(renko.columns[5],i)!=b.close ||
+           value_at<int8_t>(renko.columns[6],i)!=b.dir || value_at<bool>(renko.columns[7],i)!=b.reversal) return false;
+    }
+    for(size_t i=0;i<ichimoku.rows;i++){
+        const IchimokuRow &r = (*run.ichimoku)[i];
+        if(!same(value_at<double>(ichimoku.columns[4],i),r.span_a) || !same(value_at<double>(ichimoku.columns[6],i),r.chikou))
+            return false;
+    }
+    for(size_t i=0;i<trades.rows;i++){
+        const Trade &t = (*run.trades)[i];
+        int8_t dir = t.direction==TradeDirection::Long ? 1 : -1;
+        if(value_at<int64_t>(trades.columns[2],i)!=t.exit_time || value_at<int8_t>(trades.columns[4],i)!=dir ||
+           value_at<double>(trades.columns[5],i)!=t.profit) return false;
+    }
+    TradeSummary s = summarize_trades(*run.trades);
+    return summary.rows==1 && value_at<double>(summary.columns[1],0)==s.total_profit;
+}
+
+// -------- SERVER SIDE --------
+static string json_body(const BacktestRun &run,ContentEncoding encoding){
+    string body = backtest_response(run,0).dump(2);
+    return encoding==ContentEncoding::Identity ? body : compress_body(encoding,body);
+}
+
+static string columnar_body(const BacktestRun &run,ContentEncoding encoding){
+    string body;
+    Compressor compressor(encoding,[&body](const char *data,size_t size){ body.append(data,size); });
+    ChunkWriter out([&compressor](const char *data,size_t size){ compressor.write(data,size); });
+    write_backtest_stream(out,OutputFormat::Columnar,"all",run);
+    compressor.finish();
+    return body;
+}
+
+int main(int argc,char **argv){
+    size_t n = argc>1 ? strtoull(argv[1],nullptr,10) : 2000000;
+    double brick = argc>2 ? atof(argv[2]) : 2.0;
+
+    SyntheticSpec spec;
+    spec.candles = n;
+    spec.volatility = 1.5;
+    vector<Candle> candles = synthetic_candles(spec);
+    BacktestRun run;
+    run.renko = make_shared<const vector<RenkoBrick>>(build_renko(candles,brick,brick*2,SourceType::OHLC4));
+    run.ichimoku = make_shared<const vector<IchimokuRow>>(ichimoku_on_renko(*run.renko));
+    run.trades = make_shared<const vector<Trade>>(run_strategy(*run.ichimoku));
+    printf("%zu candles -> %zu bricks, %zu trades\n\n",n,run.renko->size(),run.trades->size());
+
+    vector<ContentEncoding> encodings = {ContentEncoding::Identity,ContentEncoding::Gzip};
+#ifdef BACKTEST_HAVE_ZSTD
+    encodings.push_back(ContentEncoding::Zstd);
+#endif
+    int iters = max(1,static_cast<int>(1000000/max<size_t>(run.renko->size(),1)));
+
+    printf("%-9s %-9s %12s %11s %11s %14s %13s\n","format","encoding","bytes","server ms","client ms","e2e@100Mbit","e2e@1Gbit");
+    bool ok = true;
+    for(int columnar=0;columnar<2;columnar++){
+        for(ContentEncoding e:encodings){
+            string body;
+            double server = time_ms([&]{ body = columnar ? columnar_body(run,e) : json_body(run,e); },iters);
+            size_t rows = 0;
+            double client = time_ms([&]{
+                string raw = decompress(e,body);
+                rows = columnar ? load_columnar(raw) : load_json_response(raw);
+            },iters);
+            size_t want = run.renko->size()+run.trades->size()+1+(columnar ? run.ichimoku->size() : 0);
+            if(rows!=want){
+                cerr << (columnar ? "columnar " : "json ") << content_encoding_name(e) << ": loaded " << rows
+                     << " rows, expected " << want << endl;
+                ok = false;
+            }
+            if(columnar && !check_columnar(decompress(e,body),run)){
+                cerr << "columnar " << content_encoding_name(e) << ": decoded tables differ from the run" << endl;
+                ok = false;
+            }
+            double wire100 = body.size()*8/100e6*1e3, wire1g = body.size()*8/1e9*1e3;
+            printf("%-9s %-9s %12zu %11.2f %11.2f %11.1f ms %10.1f ms\n",columnar ? "columnar" : "json+csv",
+                   content_encoding_name(e),body.size(),server,client,server+wire100+client,server+wire1g+client);
+        }
+    }
+    return ok ? 0 : 1;
+}
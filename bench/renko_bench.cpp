@@ -0,0 +1,153 @@
+// Compares the source-specialized Renko builder against the one it replaced
+// (string source looked up per candle, wide bricks with the source OHLC
+// inline) on a synthetic random walk.
+//
+//   renko_bench [candles] [brick_size]
+//
+// Every source must produce identical bricks. Candles default to 10,000,000
+// one-minute rows with a brick size of 20.
+
+#include "strategy.h"
+#include "synthetic.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
+using namespace std;
+
+// The brick and builder as they were in strategy.h/.cpp, kept as the reference.
+struct LegacyBrick {
+    int64_t brick_time, brick_start_time;
+    double src_open, src_high, src_low, src_close;
+    double open, high, low, close;
+    int dir;
+    bool reversal;
+};
+
+static double legacy_source_price(const Candle &c,const string &source){
+    string s = source; for(auto &ch:s) ch = tolower(ch);
+    if(s=="close") return c.close;
+    if(s=="open") return c.open;
+    if(s=="high") return c.high;
+    if(s=="low") return c.low;
+    if(s=="hl2") return (c.high+c.low)/2.0;
+    if(s=="hlc3") return (c.high+c.low+c.close)/3.0;
+    if(s=="ohlc4") return (c.open+c.high+c.low+c.close)/4.0;
+    throw runtime_error("Unsupported source type: "+source);
+}
+
+static vector<LegacyBrick> legacy_build_renko(const vector<Candle> &candles,double brick_size,double reversal_size,const string &source){
+    vector<LegacyBrick> rows;
+    double last_price = NAN;
+    int last_dir = 0;
+    int64_t trend_start_time = 0;
+    for(auto &candle:candles){
+        double price = legacy_source_price(candle,source);
+        int64_t ts = candle.time;
+        double src_o=candle.open,src_h=candle.high,src_l=candle.low,src_c=candle.close;
+        if(isnan(last_price)){ last_price=price; trend_start_time=ts; continue; }
+        bool progressed=true;
+        while(progressed){
+            progressed=false;
+            if(last_dir==0){
+                double diff = price-last_price;
+                if(fabs(diff)>=brick_size){
+                    int dir = diff>0?1:-1;
+                    double new_close = last_price + dir*brick_size;
+                    rows.push_back({ts, trend_start_time, src_o,src_h,src_l,src_c,last_price,max(last_price,new_close),min(last_price,new_close),new_close,dir,false});
+                    last_price=new_close;
+                    last_dir=dir;
+                    progressed=true;
+                }
+            }else if(last_dir==1){
+                if(price>=last_price+brick_size){
+                    double new_close=last_price+brick_size;
+                    rows.push_back({ts, trend_start_time, src_o,src_h,src_l,src_c,last_price,new_close,last_price,new_close,1,false});
+                    last_price=new_close; progressed=true;
+                }else if(price<=last_price-reversal_size){
+                    double new_close=last_price-reversal_size;
+                    rows.push_back({ts, ts, src_o,src_h,src_l,src_c,last_price,last_price,new_close,new_close,-1,true});
+                    last_price=new_close; last_dir=-1; trend_start_time=ts; progressed=true;
+                }
+            }else{
+                if(price<=last_price-brick_size){
+                    double new_close=last_price-brick_size;
+                    rows.push_back({ts, trend_start_time, src_o,src_h,src_l,src_c,last_price,last_price,new_close,new_close,-1,false});
+                    last_price=new_close; progressed=true;
+                }else if(price>=last_price+reversal_size){
+                    double new_close=last_price+reversal_size;
+                    rows.push_back({ts, ts, src_o,src_h,src_l,src_c,last_price,new_close,last_price,new_close,1,true});
+                    last_price=new_close; last_dir=1; trend_start_time=ts; progressed=true;
+                }
+            }
+        }
+    }
+    return rows;
+}
+
+static bool same(const vector<LegacyBrick> &want,const vector<RenkoBrick> &got,const vector<RenkoSource> &src){
+    if(want.size()!=got.size() || got.size()!=src.size()) return false;
+    for(size_t i=0;i<want.size();i++){
+        const LegacyBrick &a = want[i];
+        const RenkoBrick &b = got[i];
+        const RenkoSource &s = src[i];
+        if(a.brick_time!=b.brick_time || a.brick_start_time!=b.brick_start_time ||
+           a.open!=b.open || a.high!=b.high || a.low!=b.low || a.close!=b.close ||
+           a.dir!=b.dir || a.reversal!=b.reversal ||
+           a.src_open!=s.open || a.src_high!=s.high || a.src_low!=s.low || a.src_close!=s.close) return false;
+    }
+    return true;
+}
+
+static volatile size_t sink;
+
+template <class F>
+static double time_ms(F &&f){
+    auto t0 = chrono::steady_clock::now();
+    sink = f();
+    return chrono::duration<double,milli>(chrono::steady_clock::now()-t0).count();
+}
+
+int main(int argc,char **argv){
+    size_t n = argc>1 ? strtoull(argv[1],nullptr,10) : 10000000;
+    double brick = argc>2 ? atof(argv[2]) : 20.0;
+    SyntheticSpec spec;
+    spec.candles = n;
+    vector<Candle> candles = synthetic_candles(spec);
+    CandleColumns columns;
+    columns.resize(n);
+    for(size_t i=0;i<n;i++){
+        columns.time[i] = candles[i].time; columns.open[i] = candles[i].open;
+        columns.high[i] = candles[i].high; columns.low[i] = candles[i].low;
+        columns.close[i] = candles[i].close; columns.volume[i] = candles[i].volume;
+    }
+
+    printf("%zu candles, brick %.2f, reversal %.2f\n",n,brick,2*brick);
+    bool ok = true;
+    for(const char *name : {"close","hl2","hlc3","ohlc4"}){
+        SourceType source = parse_source_type(name);
+        vector<RenkoSource> src_rows, src_cols;
+        auto want = legacy_build_renko(candles,brick,2*brick,name);
+        if(!same(want,build_renko(candles,brick,2*brick,source,&src_rows),src_rows) ||
+           !same(want,build_renko(columns,brick,2*brick,source,&src_cols),src_cols)){
+            cerr << name << ": bricks differ from the reference" << endl;
+            ok = false;
+            continue;
+        }
+
+        double legacy_ms = time_ms([&]{ return legacy_build_renko(candles,brick,2*brick,name).size(); });
+        double rows_ms = time_ms([&]{ return build_renko(candles,brick,2*brick,source).size(); });
+        double cols_ms = time_ms([&]{ return build_renko(columns,brick,2*brick,source).size(); });
+        double mc = n/1e6;
+        printf("%-6s %9zu bricks | legacy %8.1f ms %6.1f Mc/s | rows %7.1f ms %6.1f Mc/s %5.2fx | columns %7.1f ms %6.1f Mc/s %5.2fx\n",
+               name,want.size(),legacy_ms,mc/(legacy_ms/1e3),
+               rows_ms,mc/(rows_ms/1e3),legacy_ms/rows_ms,
+               cols_ms,mc/(cols_ms/1e3),legacy_ms/cols_ms);
+    }
+    printf("brick size: legacy %zu bytes, lean %zu bytes\n",sizeof(LegacyBrick),sizeof(RenkoBrick));
+    return ok ? 0 : 1;
+}
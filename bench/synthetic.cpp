@@ -0,0 +1,93 @@
+#include "synthetic.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+using namespace std;
+
+const char* market_regime_name(MarketRegime regime){
+    switch(regime){
+    case MarketRegime::RandomWalk: return "random_walk";
+    case MarketRegime::Trending: return "trending";
+    case MarketRegime::Choppy: return "choppy";
+    case MarketRegime::Gaps: return "gaps";
+    }
+    return "random_walk";
+}
+
+MarketRegime parse_market_regime(const string &name){
+    for(MarketRegime r : {MarketRegime::RandomWalk,MarketRegime::Trending,MarketRegime::Choppy,MarketRegime::Gaps})
+        if(name==market_regime_name(r)) return r;
+    throw runtime_error("Unknown market regime: "+name);
+}
+
+namespace {
+
+// mt19937_64's output is fixed by the standard but the <random>
+// distributions are not, so uniforms and normals are drawn here: the top
+// 53 bits for [0,1), and Box-Muller for N(0, sigma).
+class Draw {
+public:
+    Draw(uint64_t seed,double sigma) : rng_(seed), sigma_(sigma) {}
+
+    double unit(){ return static_cast<double>(rng_()>>11)*0x1.0p-53; }
+
+    double normal(){
+        if(has_spare_){
+            has_spare_ = false;
+            return spare_;
+        }
+        double u1 = 1.0-unit(), u2 = unit();   // u1 in (0,1]
+        double r = sigma_*sqrt(-2.0*log(u1)), a = 6.283185307179586*u2;
+        spare_ = r*sin(a);
+        has_spare_ = true;
+        return r*cos(a);
+    }
+
+private:
+    mt19937_64 rng_;
+    double sigma_, spare_ = 0;
+    bool has_spare_ = false;
+};
+
+} // namespace
+
+vector<Candle> synthetic_candles(const SyntheticSpec &spec){
+    Draw draw(spec.seed,spec.volatility);
+    const double floor_price = spec.volatility;   // keeps prices positive
+
+    vector<Candle> candles(spec.candles);
+    double price = spec.start_price;
+    double drift = 0.25*spec.volatility;
+    int64_t t = spec.start_time;
+    for(size_t i=0;i<spec.candles;i++){
+        double move = draw.normal();
+        switch(spec.regime){
+        case MarketRegime::RandomWalk:
+            break;
+        case MarketRegime::Trending:
+            if(draw.unit()<1.0/4000) drift = -drift;
+            move += drift;
+            break;
+        case MarketRegime::Choppy:
+            move += 0.05*(spec.start_price-price);
+            break;
+        case MarketRegime::Gaps:
+            if(draw.unit()<0.001) move += (draw.unit()<0.5 ? -1 : 1)*spec.volatility*(10+40*draw.unit());
+            if(draw.unit()<0.0005) t += spec.interval*static_cast<int64_t>(1+draw.unit()*86400/spec.interval);
+            break;
+        }
+        Candle &c = candles[i];
+        c.time = t;
+        c.open = price;
+        price = max(floor_price,price+move);
+        c.close = price;
+        c.high = max(c.open,c.close)+fabs(draw.normal())*0.5;
+        c.low = max(floor_price*0.5,min(c.open,c.close)-fabs(draw.normal())*0.5);
+        c.volume = 100.0*(1.0+draw.unit());
+        t += spec.interval;
+    }
+    return candles;
+}
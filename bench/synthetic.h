@@ -0,0 +1,37 @@
+#pragma once
+
+#include "strategy.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Seeded synthetic candles for benchmarks and offline runs. The same spec
+// always produces the same series with any standard library, since only
+// mt19937_64's raw output is used (up to last-bit differences between libm
+// implementations of log, sin and cos).
+//
+//   random_walk - Gaussian steps around a flat mean
+//   trending    - steps with a drift that flips direction every few
+//                 thousand candles, so long one-sided Renko runs
+//   choppy      - mean-reverting around the start price, many reversals
+//   gaps        - random walk with occasional price jumps and missing
+//                 candles (time skips of up to a day)
+enum class MarketRegime { RandomWalk, Trending, Choppy, Gaps };
+
+const char* market_regime_name(MarketRegime regime);
+// Throws std::runtime_error on unknown names.
+MarketRegime parse_market_regime(const std::string &name);
+
+struct SyntheticSpec {
+    MarketRegime regime = MarketRegime::RandomWalk;
+    size_t candles = 100000;
+    uint64_t seed = 7;
+    int64_t start_time = 1690848000;   // 2023-08-01 00:00 UTC
+    int64_t interval = 60;             // seconds per candle
+    double start_price = 1850.0;
+    double volatility = 6.0;           // standard deviation of one candle's move
+};
+
+std::vector<Candle> synthetic_candles(const SyntheticSpec &spec);
@@ -0,0 +1,267 @@
+#include "candle_decoder.h"
+
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+enum class Kind { Number, Bool, Null, Other };
+
+struct Scalar {
+    Kind kind = Kind::Null;
+    bool is_int = false;
+    int64_t i = 0;
+    double d = 0;
+};
+
+class Decoder {
+public:
+    Decoder(const char *data,size_t len,vector<Candle> &out)
+        : begin_(data), p_(data), end_(data+len), out_(out), mark_(out.size()) {}
+
+    size_t run(){
+        ws();
+        if(p_<end_ && *p_=='{') top_object();
+        else skip_value();
+        ws();
+        if(p_!=end_) fail("trailing characters");
+        return out_.size()-mark_;
+    }
+
+private:
+    [[noreturn]] void fail(const char *what){
+        throw runtime_error(string("Invalid candle response: ")+what+" at offset "+to_string(p_-begin_));
+    }
+
+    void ws(){
+        while(p_<end_ && (*p_==' '||*p_=='\n'||*p_=='\r'||*p_=='\t')) ++p_;
+    }
+
+    void expect(char c){
+        ws();
+        if(p_>=end_ || *p_!=c){
+            char msg[] = "expected ' '";
+            msg[10] = c;
+            fail(msg);
+        }
+        ++p_;
+    }
+
+    // Returns true for ',' and false for `close`.
+    bool next_or_close(char close){
+        ws();
+        if(p_<end_ && *p_==',') { ++p_; return true; }
+        if(p_<end_ && *p_==close) { ++p_; return false; }
+        fail("expected ',' or closing bracket");
+    }
+
+    // Keys we care about never contain escapes; escaped keys are matched
+    // against nothing, which is harmless since they are skipped anyway.
+    bool key(const char *&k,size_t &klen){
+        ws();
+        if(p_>=end_ || *p_!='"') fail("expected object key");
+        const char *start = ++p_;
+        bool plain = true;
+        while(true){
+            if(p_>=end_) fail("unterminated string");
+            char c = *p_;
+            if(c=='"') break;
+            if(c=='\\'){ plain = false; p_ += 2; continue; }
+            if(static_cast<unsigned char>(c)<0x20) fail("control character in string");
+            ++p_;
+        }
+        k = start; klen = static_cast<size_t>(p_-start);
+        ++p_;
+        expect(':');
+        return plain;
+    }
+
+    static bool is(const char *k,size_t klen,const char *lit){
+        size_t n = strlen(lit);
+        return klen==n && memcmp(k,lit,n)==0;
+    }
+
+    void skip_string(){
+        ++p_;   // opening quote
+        while(true){
+            if(p_>=end_) fail("unterminated string");
+            char c = *p_++;
+            if(c=='"') return;
+            if(c=='\\'){
+                if(p_>=end_) fail("unterminated escape");
+                char e = *p_++;
+                if(e=='u'){
+                    for(int i=0;i<4;i++,++p_)
+                        if(p_>=end_ || !isxdigit(static_cast<unsigned char>(*p_))) fail("bad \\u escape");
+                }else if(!strchr("\"\\/bfnrt",e)) fail("bad escape");
+            }else if(static_cast<unsigned char>(c)<0x20) fail("control character in string");
+        }
+    }
+
+    void literal(const char *lit){
+        size_t n = strlen(lit);
+        if(static_cast<size_t>(end_-p_)<n || memcmp(p_,lit,n)!=0) fail("invalid literal");
+        p_ += n;
+    }
+
+    void number(Scalar &s){
+        const char *start = p_;
+        bool is_int = true;
+        if(p_<end_ && *p_=='-') ++p_;
+        if(p_>=end_ || !isdigit(static_cast<unsigned char>(*p_))) fail("invalid number");
+        if(*p_=='0') ++p_;
+        else while(p_<end_ && isdigit(static_cast<unsigned char>(*p_))) ++p_;
+        if(p_<end_ && *p_=='.'){
+            is_int = false; ++p_;
+            if(p_>=end_ || !isdigit(static_cast<unsigned char>(*p_))) fail("invalid number");
+            while(p_<end_ && isdigit(static_cast<unsigned char>(*p_))) ++p_;
+        }
+        if(p_<end_ && (*p_=='e'||*p_=='E')){
+            is_int = false; ++p_;
+            if(p_<end_ && (*p_=='+'||*p_=='-')) ++p_;
+            if(p_>=end_ || !isdigit(static_cast<unsigned char>(*p_))) fail("invalid number");
+            while(p_<end_ && isdigit(static_cast<unsigned char>(*p_))) ++p_;
+        }
+        s.kind = Kind::Number;
+        s.is_int = false;
+        if(is_int && from_chars(start,p_,s.i).ec==errc()){
+            s.is_int = true;
+            s.d = static_cast<double>(s.i);
+            return;
+        }
+        from_chars(start,p_,s.d);
+    }
+
+    void skip_value(){
+        Scalar ignored;
+        value(ignored);
+    }
+
+    void value(Scalar &s){
+        ws();
+        if(p_>=end_) fail("unexpected end of input");
+        switch(*p_){
+        case '{':
+            ++p_; ws();
+            s.kind = Kind::Other;
+            if(p_<end_ && *p_=='}'){ ++p_; return; }
+            do {
+                const char *k; size_t klen;
+                key(k,klen);
+                skip_value();
+            } while(next_or_close('}'));
+            return;
+        case '[':
+            ++p_; ws();
+            s.kind = Kind::Other;
+            if(p_<end_ && *p_==']'){ ++p_; return; }
+            do { skip_value(); } while(next_or_close(']'));
+            return;
+        case '"': skip_string(); s.kind = Kind::Other; return;
+        case 't': literal("true"); s.kind = Kind::Bool; s.d = 1; s.i = 1; s.is_int = true; return;
+        case 'f': literal("false"); s.kind = Kind::Bool; s.d = 0; s.i = 0; s.is_int = true; return;
+        case 'n': literal("null"); s.kind = Kind::Null; s.d = 0; s.i = 0; return;
+        default: number(s); return;
+        }
+    }
+
+    static int64_t as_time(const Scalar &s){
+        return s.is_int ? s.i : static_cast<int64_t>(s.d);
+    }
+
+    void top_object(){
+        ++p_; ws();
+        if(p_<end_ && *p_=='}'){ ++p_; return; }
+        do {
+            const char *k; size_t klen;
+            bool plain = key(k,klen);
+            ws();
+            if(plain && is(k,klen,"result")){
+                // A repeated key replaces the earlier value, as in a DOM.
+                out_.resize(mark_);
+                if(p_<end_ && *p_=='[') result_array();
+                else skip_value();
+            }else skip_value();
+        } while(next_or_close('}'));
+    }
+
+    void result_array(){
+        ++p_; ws();
+        if(p_<end_ && *p_==']'){ ++p_; return; }
+        do {
+            ws();
+            if(p_<end_ && *p_=='[') array_row();
+            else if(p_<end_ && *p_=='{') object_row();
+            else skip_value();
+        } while(next_or_close(']'));
+    }
+
+    void array_row(){
+        ++p_; ws();
+        Scalar f[6];
+        size_t n = 0;
+        if(p_<end_ && *p_==']') ++p_;
+        else {
+            do {
+                if(n<6) value(f[n]);
+                else skip_value();
+                n++;
+            } while(next_or_close(']'));
+        }
+        if(n<5) return;
+        if(f[0].kind!=Kind::Number && f[0].kind!=Kind::Bool) fail("candle time is not a number");
+        // Prices that are null or not numbers read as 0.
+        auto price = [](const Scalar &s){ return s.kind==Kind::Number||s.kind==Kind::Bool ? s.d : 0.0; };
+        double open = price(f[1]), high = price(f[2]), low = price(f[3]), close = price(f[4]);
+        double volume = n>5 ? price(f[5]) : 0.0;
+        // Skip invalid candles (e.g., all zeros)
+        if(open==0 && high==0 && low==0 && close==0) return;
+        out_.push_back({as_time(f[0]),open,high,low,close,volume});
+    }
+
+    void object_row(){
+        ++p_; ws();
+        Candle c{0,0,0,0,0,0};
+        if(p_<end_ && *p_=='}'){ ++p_; out_.push_back(c); return; }
+        do {
+            const char *k; size_t klen;
+            bool plain = key(k,klen);
+            double *field = nullptr;
+            bool is_time = false;
+            if(plain){
+                if(is(k,klen,"time")) is_time = true;
+                else if(is(k,klen,"open")) field = &c.open;
+                else if(is(k,klen,"high")) field = &c.high;
+                else if(is(k,klen,"low")) field = &c.low;
+                else if(is(k,klen,"close")) field = &c.close;
+                else if(is(k,klen,"volume")) field = &c.volume;
+            }
+            if(!is_time && !field){ skip_value(); continue; }
+            Scalar s;
+            value(s);
+            if(is_time){
+                if(s.kind!=Kind::Number && s.kind!=Kind::Bool) fail("candle time is not a number");
+                c.time = as_time(s);
+            }else if(s.kind==Kind::Other) fail("candle price is not a number");
+            else *field = s.d;   // null reads as 0
+        } while(next_or_close('}'));
+        out_.push_back(c);
+    }
+
+    const char *begin_;
+    const char *p_;
+    const char *end_;
+    vector<Candle> &out_;
+    size_t mark_;
+};
+
+} // namespace
+
+size_t decode_candles(const char *data,size_t len,vector<Candle> &out){
+    return Decoder(data,len,out).run();
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "strategy.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Streaming decoder for /v2/history/candles response bodies.
+//
+// Walks the JSON text once and writes rows of the top-level "result" array
+// straight into `out` without building a DOM. Both row shapes are accepted:
+//
+//   [time, open, high, low, close, volume?]      array rows, 5 or more fields
+//   {"time": .., "open": .., ..., "volume": ..}  object rows
+//
+// Null or non-numeric prices read as 0; array rows whose OHLC are all 0 are
+// skipped. Everything outside "result" is validated and skipped. Throws
+// std::runtime_error on malformed JSON. Returns the number of rows appended.
+size_t decode_candles(const char *data, size_t len, std::vector<Candle> &out);
+
+inline size_t decode_candles(const std::string &body, std::vector<Candle> &out){
+    return decode_candles(body.data(), body.size(), out);
+}
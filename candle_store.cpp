@@ -0,0 +1,259 @@
+#include "candle_store.h"
+#include "log.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const char FILE_MAGIC[8] = {'S','W','C','A','N','D','L','1'};
+const uint32_t SEGMENT_MAGIC = 0x4d474553;   // "SEGM"
+const size_t SEGMENT_HEADER = 32;
+const size_t COLUMNS = 6;
+
+struct SegmentHeader {
+    uint32_t magic;
+    uint32_t count;
+    int64_t cover_start;
+    int64_t cover_end;
+    uint64_t reserved;
+};
+static_assert(sizeof(SegmentHeader) == SEGMENT_HEADER, "segment header layout");
+
+size_t segment_bytes(uint32_t count){
+    return SEGMENT_HEADER + COLUMNS*sizeof(double)*count;
+}
+
+string series_key(const string &symbol, const string &resolution){
+    string key;
+    for(char c:symbol) key += (isalnum((unsigned char)c)||c=='-') ? c : '_';
+    key += '_';
+    for(char c:resolution) key += isalnum((unsigned char)c) ? (char)tolower((unsigned char)c) : '_';
+    return key;
+}
+
+} // namespace
+
+// -------- CandleSeriesFile --------
+CandleSeriesFile::CandleSeriesFile(const string &path) : path_(path){
+    fd_ = ::open(path.c_str(), O_RDWR|O_CREAT|O_CLOEXEC, 0644);
+    if(fd_<0) throw runtime_error("cannot open candle store file "+path+": "+strerror(errno));
+    struct stat st{};
+    if(fstat(fd_,&st)!=0){
+        ::close(fd_);
+        throw runtime_error("cannot stat candle store file "+path);
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    if(size==0){
+        if(pwrite(fd_,FILE_MAGIC,sizeof(FILE_MAGIC),0)!=(ssize_t)sizeof(FILE_MAGIC)){
+            ::close(fd_);
+            throw runtime_error("cannot initialise candle store file "+path);
+        }
+        size = sizeof(FILE_MAGIC);
+    }
+    remap(size);
+    if(map_size_<sizeof(FILE_MAGIC) || memcmp(map_,FILE_MAGIC,sizeof(FILE_MAGIC))!=0){
+        munmap(const_cast<char*>(map_),map_size_);
+        ::close(fd_);
+        throw runtime_error("not a candle store file: "+path);
+    }
+    load_index();
+}
+
+CandleSeriesFile::~CandleSeriesFile(){
+    if(map_) munmap(const_cast<char*>(map_),map_size_);
+    if(fd_>=0) ::close(fd_);
+}
+
+void CandleSeriesFile::remap(size_t size){
+    if(map_) munmap(const_cast<char*>(map_),map_size_);
+    void *p = mmap(nullptr,size,PROT_READ,MAP_SHARED,fd_,0);
+    if(p==MAP_FAILED){
+        map_ = nullptr; map_size_ = 0;
+        throw runtime_error("cannot map candle store file "+path_+": "+strerror(errno));
+    }
+    map_ = static_cast<const char*>(p);
+    map_size_ = size;
+}
+
+void CandleSeriesFile::load_index(){
+    segments_.clear();
+    size_t off = sizeof(FILE_MAGIC);
+    while(off+SEGMENT_HEADER<=map_size_){
+        SegmentHeader h;
+        memcpy(&h,map_+off,sizeof(h));
+        if(h.magic!=SEGMENT_MAGIC || off+segment_bytes(h.count)>map_size_) break;
+        segments_.push_back({h.cover_start,h.cover_end,h.count,off+SEGMENT_HEADER});
+        off += segment_bytes(h.count);
+    }
+    if(off!=map_size_){
+        // Torn write from an earlier crash: drop the partial segment.
+        log_warn() << "candle store: truncating " << path_ << " from " << map_size_ << " to " << off << " bytes";
+        if(ftruncate(fd_,static_cast<off_t>(off))!=0)
+            throw runtime_error("cannot truncate candle store file "+path_);
+        remap(off);
+    }
+    sort(segments_.begin(),segments_.end(),[](const Segment &a,const Segment &b){ return a.cover_start<b.cover_start; });
+}
+
+vector<TimeRange> CandleSeriesFile::missing_locked(int64_t start,int64_t end) const{
+    vector<TimeRange> gaps;
+    int64_t cur = start;
+    for(auto &s:segments_){
+        if(cur>end) break;
+        if(s.cover_end<cur) continue;
+        if(s.cover_start>end) break;
+        if(s.cover_start>cur) gaps.emplace_back(cur,s.cover_start-1);
+        cur = max(cur,s.cover_end+1);
+    }
+    if(cur<=end) gaps.emplace_back(cur,end);
+    return gaps;
+}
+
+vector<TimeRange> CandleSeriesFile::missing(int64_t start,int64_t end){
+    lock_guard<mutex> lk(mu_);
+    return missing_locked(start,end);
+}
+
+void CandleSeriesFile::read(int64_t start,int64_t end,vector<Candle> &out){
+    lock_guard<mutex> lk(mu_);
+    for(auto &s:segments_){
+        if(s.cover_end<start || s.cover_start>end || s.count==0) continue;
+        const int64_t *t = reinterpret_cast<const int64_t*>(map_+s.offset);
+        const double *o = reinterpret_cast<const double*>(t+s.count);
+        const double *h = o+s.count;
+        const double *l = h+s.count;
+        const double *c = l+s.count;
+        const double *v = c+s.count;
+        size_t lo = lower_bound(t,t+s.count,start)-t;
+        size_t hi = upper_bound(t,t+s.count,end)-t;
+        for(size_t i=lo;i<hi;i++) out.push_back({t[i],o[i],h[i],l[i],c[i],v[i]});
+    }
+}
+
+void CandleSeriesFile::read_columns(int64_t start,int64_t end,CandleColumns &out){
+    lock_guard<mutex> lk(mu_);
+    for(auto &s:segments_){
+        if(s.cover_end<start || s.cover_start>end || s.count==0) continue;
+        const int64_t *t = reinterpret_cast<const int64_t*>(map_+s.offset);
+        size_t lo = lower_bound(t,t+s.count,start)-t;
+        size_t hi = upper_bound(t,t+s.count,end)-t;
+        const double *col = reinterpret_cast<const double*>(t+s.count);
+        out.time.insert(out.time.end(),t+lo,t+hi);
+        for(vector<double> *dst:{&out.open,&out.high,&out.low,&out.close,&out.volume}){
+            dst->insert(dst->end(),col+lo,col+hi);
+            col += s.count;
+        }
+    }
+}
+
+void CandleSeriesFile::write_segment(int64_t cover_start,int64_t cover_end,const vector<Candle> &candles){
+    uint32_t n = static_cast<uint32_t>(candles.size());
+    vector<char> buf(segment_bytes(n));
+    SegmentHeader h{SEGMENT_MAGIC,n,cover_start,cover_end,0};
+    memcpy(buf.data(),&h,sizeof(h));
+    char *p = buf.data()+SEGMENT_HEADER;
+    auto put_column = [&](auto field){
+        for(auto &c:candles){ auto v = field(c); memcpy(p,&v,sizeof(v)); p += sizeof(v); }
+    };
+    put_column([](const Candle &c){ return c.time; });
+    put_column([](const Candle &c){ return c.open; });
+    put_column([](const Candle &c){ return c.high; });
+    put_column([](const Candle &c){ return c.low; });
+    put_column([](const Candle &c){ return c.close; });
+    put_column([](const Candle &c){ return c.volume; });
+
+    size_t off = map_size_;
+    size_t done = 0;
+    while(done<buf.size()){
+        ssize_t w = pwrite(fd_,buf.data()+done,buf.size()-done,static_cast<off_t>(off+done));
+        if(w<=0){
+            if(w<0 && errno==EINTR) continue;
+            if(ftruncate(fd_,static_cast<off_t>(off))!=0){}
+            throw runtime_error("cannot append to candle store file "+path_);
+        }
+        done += static_cast<size_t>(w);
+    }
+    remap(off+buf.size());
+    Segment seg{cover_start,cover_end,n,off+SEGMENT_HEADER};
+    segments_.insert(upper_bound(segments_.begin(),segments_.end(),seg,
+                                 [](const Segment &a,const Segment &b){ return a.cover_start<b.cover_start; }),seg);
+}
+
+void CandleSeriesFile::append(int64_t cover_start,int64_t cover_end,const vector<Candle> &input){
+    if(cover_start>cover_end) return;
+    auto by_time = [](const Candle &a,const Candle &b){ return a.time<b.time; };
+    vector<Candle> sorted;
+    if(!is_sorted(input.begin(),input.end(),by_time)){
+        sorted = input;
+        sort(sorted.begin(),sorted.end(),by_time);
+    }
+    const vector<Candle> &candles = sorted.empty() ? input : sorted;
+    lock_guard<mutex> lk(mu_);
+    for(auto &gap:missing_locked(cover_start,cover_end)){
+        auto lo = lower_bound(candles.begin(),candles.end(),gap.first,[](const Candle &c,int64_t t){ return c.time<t; });
+        auto hi = upper_bound(candles.begin(),candles.end(),gap.second,[](int64_t t,const Candle &c){ return t<c.time; });
+        vector<Candle> part(lo,hi);
+        part.erase(unique(part.begin(),part.end(),[](const Candle &a,const Candle &b){ return a.time==b.time; }),part.end());
+        write_segment(gap.first,gap.second,part);
+    }
+}
+
+size_t CandleSeriesFile::candle_count(){
+    lock_guard<mutex> lk(mu_);
+    size_t n = 0;
+    for(auto &s:segments_) n += s.count;
+    return n;
+}
+
+// -------- CandleStore --------
+CandleStore::CandleStore(string dir) : dir_(move(dir)) {}
+
+CandleSeriesFile* CandleStore::series(const string &symbol,const string &resolution){
+    string key = series_key(symbol,resolution);
+    lock_guard<mutex> lk(mu_);
+    auto it = series_.find(key);
+    if(it!=series_.end()) return it->second.get();
+    try {
+        filesystem::create_directories(dir_);
+        auto file = make_unique<CandleSeriesFile>(dir_+"/"+key+".candles");
+        auto *raw = file.get();
+        series_.emplace(key,move(file));
+        return raw;
+    } catch(const exception &e){
+        log_warn() << "candle store disabled for " << key << ": " << e.what();
+        return nullptr;
+    }
+}
+
+CandleSeriesFile* CandleStore::existing_series(const string &symbol,const string &resolution){
+    {
+        lock_guard<mutex> lk(mu_);
+        if(series_.find(series_key(symbol,resolution))==series_.end()){
+            error_code ec;
+            if(!filesystem::exists(dir_+"/"+series_key(symbol,resolution)+".candles",ec)) return nullptr;
+        }
+    }
+    return series(symbol,resolution);
+}
+
+CandleStore* candle_store(){
+    static unique_ptr<CandleStore> store = []() -> unique_ptr<CandleStore> {
+        const char *env = getenv("CANDLE_STORE_DIR");
+        string dir = env ? env : "candle_store";
+        if(dir.empty() || dir=="off") return nullptr;
+        return make_unique<CandleStore>(dir);
+    }();
+    return store.get();
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "resample.h"
+#include "strategy.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Persistent, memory-mapped candle store.
+//
+// One append-only file per (symbol, resolution). The file is a sequence of
+// segments; each segment records the time range it covers (so empty exchange
+// ranges are remembered too) followed by its candles laid out column by
+// column: time[], open[], high[], low[], close[], volume[].
+//
+//   file    := "SWCANDL1" segment*
+//   segment := u32 magic 'SEGM' | u32 count | i64 cover_start | i64 cover_end
+//              | u64 reserved | i64 time[count] | f64 open[count] | f64 high[count]
+//              | f64 low[count] | f64 close[count] | f64 volume[count]
+//
+// Segments never overlap: callers ask for missing() ranges, download those
+// and append() them. A segment truncated by a crash is ignored and cut off
+// on the next open.
+
+using TimeRange = std::pair<int64_t, int64_t>;   // inclusive [start, end]
+
+class CandleSeriesFile {
+public:
+    explicit CandleSeriesFile(const std::string &path);
+    ~CandleSeriesFile();
+    CandleSeriesFile(const CandleSeriesFile&) = delete;
+    CandleSeriesFile& operator=(const CandleSeriesFile&) = delete;
+
+    // Sub-ranges of [start, end] that no segment covers yet.
+    std::vector<TimeRange> missing(int64_t start, int64_t end);
+
+    // Appends stored candles with time in [start, end] to `out`, read
+    // straight from the mapping.
+    void read(int64_t start, int64_t end, std::vector<Candle> &out);
+    // The same, column by column, copied straight from the segment columns.
+    void read_columns(int64_t start, int64_t end, CandleColumns &out);
+
+    // Records [cover_start, cover_end] as covered by `candles`. Candles outside
+    // the range, or inside a range some other writer filled in the meantime,
+    // are dropped. Input sorted by time is used as is, without a copy.
+    void append(int64_t cover_start, int64_t cover_end, const std::vector<Candle> &candles);
+
+    size_t candle_count();
+
+private:
+    struct Segment {
+        int64_t cover_start, cover_end;
+        uint32_t count;
+        size_t offset;        // of the time column
+    };
+
+    void remap(size_t size);
+    void load_index();
+    void write_segment(int64_t cover_start, int64_t cover_end, const std::vector<Candle> &candles);
+    std::vector<TimeRange> missing_locked(int64_t start, int64_t end) const;
+
+    std::string path_;
+    int fd_ = -1;
+    const char *map_ = nullptr;
+    size_t map_size_ = 0;
+    std::vector<Segment> segments_;   // sorted by cover_start
+    std::mutex mu_;
+};
+
+class CandleStore {
+public:
+    explicit CandleStore(std::string dir);
+
+    // nullptr when the store is disabled or the file cannot be opened.
+    CandleSeriesFile* series(const std::string &symbol, const std::string &resolution);
+    // Like series(), but nullptr instead of creating a file that does not exist.
+    CandleSeriesFile* existing_series(const std::string &symbol, const std::string &resolution);
+
+    const std::string& dir() const { return dir_; }
+
+private:
+    std::string dir_;
+    std::map<std::string, std::unique_ptr<CandleSeriesFile>> series_;
+    std::mutex mu_;
+};
+
+// Process-wide store rooted at $CANDLE_STORE_DIR (default "candle_store").
+// Setting it to "" or "off" disables persistence.
+CandleStore* candle_store();
@@ -0,0 +1,200 @@
+#include "compression.h"
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdlib>
+#include <stdexcept>
+
+#include <zlib.h>
+#ifdef BACKTEST_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+using namespace std;
+
+static const int GZIP_LEVEL = 1;
+static const int ZSTD_LEVEL = 1;
+
+const char* content_encoding_name(ContentEncoding encoding){
+    switch(encoding){
+    case ContentEncoding::Identity: return "identity";
+    case ContentEncoding::Gzip: return "gzip";
+    case ContentEncoding::Zstd: return "zstd";
+    }
+    return "identity";
+}
+
+static string trim(const string &s){
+    size_t b = s.find_first_not_of(" \t");
+    if(b==string::npos) return "";
+    size_t e = s.find_last_not_of(" \t");
+    return s.substr(b,e-b+1);
+}
+
+ContentEncoding negotiate_encoding(const string &accept_encoding){
+    // q-value per coding; -1 when the header does not mention it.
+    double gzip = -1, zstd = -1, any = -1;
+    size_t pos = 0;
+    while(pos<=accept_encoding.size()){
+        size_t comma = accept_encoding.find(',',pos);
+        if(comma==string::npos) comma = accept_encoding.size();
+        string item = accept_encoding.substr(pos,comma-pos);
+        pos = comma+1;
+
+        size_t semi = item.find(';');
+        string name = trim(item.substr(0,semi));
+        for(auto &c:name) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        if(name.empty()) continue;
+        double q = 1.0;
+        if(semi!=string::npos){
+            string param = trim(item.substr(semi+1));
+            if(param.size()>2 && (param[0]=='q' || param[0]=='Q') && param[1]=='=')
+                q = strtod(param.c_str()+2,nullptr);
+        }
+        if(name=="gzip" || name=="x-gzip") gzip = max(gzip,q);
+        else if(name=="zstd") zstd = max(zstd,q);
+        else if(name=="*") any = max(any,q);
+    }
+    if(gzip<0) gzip = any;
+    if(zstd<0) zstd = any;
+#ifdef BACKTEST_HAVE_ZSTD
+    if(zstd>0 && zstd>=gzip) return ContentEncoding::Zstd;
+#endif
+    if(gzip>0) return ContentEncoding::Gzip;
+    return ContentEncoding::Identity;
+}
+
+// -------- Compressor --------
+struct Compressor::Codec {
+    z_stream gzip{};
+    bool gzip_open = false;
+#ifdef BACKTEST_HAVE_ZSTD
+    ZSTD_CCtx *zstd = nullptr;
+#endif
+
+    ~Codec(){
+        if(gzip_open) deflateEnd(&gzip);
+#ifdef BACKTEST_HAVE_ZSTD
+        ZSTD_freeCCtx(zstd);
+#endif
+    }
+};
+
+Compressor::Compressor(ContentEncoding encoding,Sink sink,size_t capacity,pmr::memory_resource *memory)
+    : encoding_(encoding), sink_(move(sink)), buf_(memory), codec_(make_unique<Codec>()) {
+#ifndef BACKTEST_HAVE_ZSTD
+    if(encoding_==ContentEncoding::Zstd) throw runtime_error("zstd support not built in");
+#endif
+    if(encoding_==ContentEncoding::Identity) return;
+    buf_.resize(max<size_t>(capacity,64));
+    if(encoding_==ContentEncoding::Gzip){
+        // windowBits 15 + 16 selects the gzip wrapper.
+        if(deflateInit2(&codec_->gzip,GZIP_LEVEL,Z_DEFLATED,15+16,8,Z_DEFAULT_STRATEGY)!=Z_OK)
+            throw runtime_error("gzip: deflateInit2 failed");
+        codec_->gzip_open = true;
+    }
+#ifdef BACKTEST_HAVE_ZSTD
+    if(encoding_==ContentEncoding::Zstd){
+        codec_->zstd = ZSTD_createCCtx();
+        if(!codec_->zstd) throw runtime_error("zstd: out of memory");
+        ZSTD_CCtx_setParameter(codec_->zstd,ZSTD_c_compressionLevel,ZSTD_LEVEL);
+    }
+#endif
+}
+
+Compressor::~Compressor() = default;
+
+void Compressor::write(const char *data,size_t size){
+    if(finished_) throw runtime_error("Compressor: write after finish");
+    in_ += size;
+    if(encoding_==ContentEncoding::Identity){
+        if(size){
+            sink_(data,size);
+            out_ += size;
+        }
+        return;
+    }
+    pump(data,size,Mode::Continue);
+}
+
+void Compressor::flush(){
+    if(finished_ || encoding_==ContentEncoding::Identity) return;
+    pump(nullptr,0,Mode::Flush);
+    drain();
+}
+
+void Compressor::finish(){
+    if(finished_) return;
+    finished_ = true;
+    if(encoding_==ContentEncoding::Identity) return;
+    pump(nullptr,0,Mode::End);
+    drain();
+}
+
+void Compressor::drain(){
+    if(used_==0) return;
+    sink_(buf_.data(),used_);
+    out_ += used_;
+    used_ = 0;
+}
+
+// Feeds input through the codec, handing the buffer to the sink each time
+// it fills. Flush and End run until the codec has nothing left to emit
+// (End also writes the trailer).
+void Compressor::pump(const char *data,size_t size,Mode mode){
+    size_t cap = buf_.size();
+    if(encoding_==ContentEncoding::Gzip){
+        z_stream &z = codec_->gzip;
+        int flush = mode==Mode::End ? Z_FINISH : mode==Mode::Flush ? Z_SYNC_FLUSH : Z_NO_FLUSH;
+        z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        while(true){
+            // avail_in is a uInt; feed very large inputs in pieces.
+            if(z.avail_in==0 && size>0){
+                uInt piece = static_cast<uInt>(min<size_t>(size,UINT_MAX/2));
+                z.avail_in = piece;
+                size -= piece;
+            }
+            z.next_out = reinterpret_cast<Bytef*>(buf_.data()+used_);
+            z.avail_out = static_cast<uInt>(cap-used_);
+            int rc = deflate(&z,flush);
+            if(rc==Z_STREAM_ERROR) throw runtime_error("gzip: deflate failed");
+            used_ = cap-z.avail_out;
+            bool full = used_==cap;
+            if(full) drain();
+            if(mode==Mode::End){
+                if(rc==Z_STREAM_END) break;
+            } else if(z.avail_in==0 && size==0 && !full){
+                break;
+            }
+        }
+        return;
+    }
+#ifdef BACKTEST_HAVE_ZSTD
+    ZSTD_EndDirective directive = mode==Mode::End ? ZSTD_e_end : mode==Mode::Flush ? ZSTD_e_flush : ZSTD_e_continue;
+    ZSTD_inBuffer in{data,size,0};
+    while(true){
+        ZSTD_outBuffer out{buf_.data()+used_,cap-used_,0};
+        size_t remaining = ZSTD_compressStream2(codec_->zstd,&out,&in,directive);
+        if(ZSTD_isError(remaining)) throw runtime_error(string("zstd: ")+ZSTD_getErrorName(remaining));
+        used_ += out.pos;
+        bool full = used_==cap;
+        if(full) drain();
+        if(mode!=Mode::Continue){
+            if(remaining==0) break;
+        } else if(in.pos==in.size && !full){
+            break;
+        }
+    }
+#endif
+}
+
+string compress_body(ContentEncoding encoding,const string &body){
+    if(encoding==ContentEncoding::Identity) return body;
+    string out;
+    out.reserve(body.size()/4+64);
+    Compressor c(encoding,[&out](const char *data,size_t size){ out.append(data,size); });
+    c.write(body.data(),body.size());
+    c.finish();
+    return out;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "arena.h"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+// HTTP response compression (Content-Encoding).
+//
+// gzip is always available; zstd when built with BACKTEST_HAVE_ZSTD. Both
+// use fast levels: the payloads are numeric tables that compress well even
+// so, and the point is to cut transfer time, not to archive.
+enum class ContentEncoding { Identity, Gzip, Zstd };
+
+// "identity", "gzip" or "zstd".
+const char* content_encoding_name(ContentEncoding encoding);
+
+// The best encoding an Accept-Encoding header allows that this build
+// supports: zstd, then gzip, honouring q-values (q=0 refuses) and "*".
+// Identity when the header is empty or nothing matches.
+ContentEncoding negotiate_encoding(const std::string &accept_encoding);
+
+// Bodies smaller than this go out uncompressed.
+constexpr size_t MIN_COMPRESS_BYTES = 1024;
+
+// Streaming compressor in front of a sink. Output is buffered and handed
+// to the sink in chunks; finish() writes the trailer. With Identity, input
+// goes to the sink unchanged. Throws std::runtime_error on codec errors.
+class Compressor {
+public:
+    using Sink = std::function<void(const char *data, size_t size)>;
+
+    static constexpr size_t DEFAULT_CAPACITY = 64 * 1024;
+
+    Compressor(ContentEncoding encoding, Sink sink, size_t capacity = DEFAULT_CAPACITY,
+               std::pmr::memory_resource *memory = request_memory());
+    ~Compressor();
+    Compressor(const Compressor&) = delete;
+    Compressor& operator=(const Compressor&) = delete;
+
+    void write(const char *data, size_t size);
+    // Sends everything written so far through to the sink, so the client
+    // can decode it now. Costs some ratio; use at record boundaries.
+    void flush();
+    void finish();
+
+    size_t bytes_in() const { return in_; }
+    size_t bytes_out() const { return out_; }
+
+private:
+    struct Codec;
+    enum class Mode { Continue, Flush, End };
+
+    void pump(const char *data, size_t size, Mode mode);
+    void drain();
+
+    ContentEncoding encoding_;
+    Sink sink_;
+    std::pmr::vector<char> buf_;
+    size_t used_ = 0;
+    std::unique_ptr<Codec> codec_;
+    size_t in_ = 0, out_ = 0;
+    bool finished_ = false;
+};
+
+// One-shot form for bodies already in memory.
+std::string compress_body(ContentEncoding encoding, const std::string &body);
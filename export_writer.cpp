@@ -0,0 +1,312 @@
+#include "export_writer.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+
+// -------- ChunkWriter --------
+ChunkWriter::ChunkWriter(Sink sink,size_t capacity,pmr::memory_resource *memory)
+    : sink_(move(sink)), buf_(max<size_t>(capacity,64),memory) {}
+
+void ChunkWriter::write(const char *data,size_t size){
+    if(size>buf_.size()-used_){
+        flush();
+        if(size>=buf_.size()){
+            sink_(data,size);
+            total_ += size;
+            return;
+        }
+    }
+    memcpy(buf_.data()+used_,data,size);
+    used_ += size;
+}
+
+void ChunkWriter::flush(){
+    if(used_==0) return;
+    sink_(buf_.data(),used_);
+    total_ += used_;
+    used_ = 0;
+}
+
+OutputFormat output_format_from_string(const string &name){
+    if(name=="json") return OutputFormat::Json;
+    if(name=="csv") return OutputFormat::Csv;
+    if(name=="ndjson") return OutputFormat::Ndjson;
+    if(name=="columnar") return OutputFormat::Columnar;
+    throw runtime_error("Unsupported output: "+name+" (use json, csv, ndjson or columnar)");
+}
+
+const char* output_content_type(OutputFormat format){
+    switch(format){
+    case OutputFormat::Json: return "application/json";
+    case OutputFormat::Csv: return "text/csv";
+    case OutputFormat::Ndjson: return "application/x-ndjson";
+    case OutputFormat::Columnar: return "application/octet-stream";
+    }
+    return "application/octet-stream";
+}
+
+// -------- RowFormatter --------
+static const int IST_OFFSET = 5*3600+30*60;
+
+RowFormatter::RowFormatter(int precision)
+    : precision_(min(max(precision,0),MAX_PRECISION)), day_(numeric_limits<int64_t>::min()) {}
+
+char* RowFormatter::number(char *p,double v) const{
+    auto r = precision_==0 ? to_chars(p,p+MAX_FIELD,v)
+                           : to_chars(p,p+MAX_FIELD,v,chars_format::general,precision_);
+    return r.ptr;
+}
+
+char* RowFormatter::json_number(char *p,double v) const{
+    if(!isfinite(v)){ memcpy(p,"null",4); return p+4; }
+    return number(p,v);
+}
+
+char* RowFormatter::integer(char *p,long long v){
+    return to_chars(p,p+MAX_FIELD,v).ptr;
+}
+
+static char* two_digits(char *p,int v){
+    p[0] = static_cast<char>('0'+v/10);
+    p[1] = static_cast<char>('0'+v%10);
+    return p+2;
+}
+
+char* RowFormatter::ist_time(char *p,int64_t epoch_sec){
+    int64_t local = epoch_sec+IST_OFFSET;
+    int64_t day = local/86400 - (local%86400<0 ? 1 : 0);
+    int sod = static_cast<int>(local-day*86400);
+    if(day!=day_){
+        // Same calendar code as epoch_to_ist_iso, once per day.
+        time_t t = static_cast<time_t>(day*86400);
+        tm tm{};
+#if defined(_WIN32)
+        gmtime_s(&tm,&t);
+#else
+        gmtime_r(&t,&tm);
+#endif
+        date_len_ = strftime(date_,sizeof(date_),"%Y-%m-%dT",&tm);
+        day_ = day;
+    }
+    memcpy(p,date_,date_len_);
+    p += date_len_;
+    p = two_digits(p,sod/3600); *p++ = ':';
+    p = two_digits(p,sod/60%60); *p++ = ':';
+    return two_digits(p,sod%60);
+}
+
+// -------- FIELD OUTPUT --------
+static void put_number(ChunkWriter &out,const RowFormatter &f,double v){
+    out.commit(f.number(out.reserve(RowFormatter::MAX_FIELD),v));
+}
+
+static void put_json_number(ChunkWriter &out,const RowFormatter &f,double v){
+    out.commit(f.json_number(out.reserve(RowFormatter::MAX_FIELD),v));
+}
+
+static void put_integer(ChunkWriter &out,long long v){
+    out.commit(RowFormatter::integer(out.reserve(RowFormatter::MAX_FIELD),v));
+}
+
+static void put_time(ChunkWriter &out,RowFormatter &f,int64_t epoch_sec){
+    out.commit(f.ist_time(out.reserve(RowFormatter::MAX_FIELD),epoch_sec));
+}
+
+template <size_t N>
+static void put_literal(ChunkWriter &out,const char (&s)[N]){
+    out.write(s,N-1);
+}
+
+static void put_direction(ChunkWriter &out,TradeDirection d){
+    if(d==TradeDirection::Long) put_literal(out,"long"); else put_literal(out,"short");
+}
+
+// -------- CSV --------
+void write_renko_csv(ChunkWriter &out,const vector<RenkoBrick> &rows,int precision){
+    RowFormatter f(precision);
+    put_literal(out,"brick_time,open,high,low,close,dir,reversal\n");
+    for(auto &r:rows){
+        put_time(out,f,r.brick_time); out.put(',');
+        put_number(out,f,r.open); out.put(',');
+        put_number(out,f,r.high); out.put(',');
+        put_number(out,f,r.low); out.put(',');
+        put_number(out,f,r.close); out.put(',');
+        put_integer(out,r.dir); out.put(',');
+        if(r.reversal) put_literal(out,"true\n"); else put_literal(out,"false\n");
+    }
+}
+
+void write_trades_csv(ChunkWriter &out,const vector<Trade> &trades,int precision){
+    RowFormatter f(precision);
+    put_literal(out,"entry_time,entry_price,exit_time,exit_price,direction,profit\n");
+    for(auto &t:trades){
+        put_time(out,f,t.entry_time); out.put(',');
+        put_number(out,f,t.entry_price); out.put(',');
+        put_time(out,f,t.exit_time); out.put(',');
+        put_number(out,f,t.exit_price); out.put(',');
+        put_direction(out,t.direction); out.put(',');
+        put_number(out,f,t.profit); out.put('\n');
+    }
+}
+
+void write_summary_csv(ChunkWriter &out,const vector<Trade> &trades,int precision){
+    RowFormatter f(precision);
+    put_literal(out,"total_trades,total_profit,winning_trades,losing_trades,max_drawdown\n");
+    if(trades.empty()){
+        put_literal(out,"0,0,0,0,0\n");
+        return;
+    }
+    TradeSummary s = summarize_trades(trades);
+    put_integer(out,static_cast<long long>(s.total_trades)); out.put(',');
+    put_number(out,f,s.total_profit); out.put(',');
+    put_integer(out,s.winning_trades); out.put(',');
+    put_integer(out,s.losing_trades); out.put(',');
+    put_number(out,f,s.max_drawdown); out.put('\n');
+}
+
+// -------- NDJSON --------
+void write_renko_ndjson(ChunkWriter &out,const vector<RenkoBrick> &rows,int precision){
+    RowFormatter f(precision);
+    for(auto &r:rows){
+        put_literal(out,"{\"type\":\"brick\",\"brick_time\":\"");
+        put_time(out,f,r.brick_time);
+        put_literal(out,"\",\"open\":"); put_json_number(out,f,r.open);
+        put_literal(out,",\"high\":"); put_json_number(out,f,r.high);
+        put_literal(out,",\"low\":"); put_json_number(out,f,r.low);
+        put_literal(out,",\"close\":"); put_json_number(out,f,r.close);
+        put_literal(out,",\"dir\":"); put_integer(out,r.dir);
+        if(r.reversal) put_literal(out,",\"reversal\":true}\n"); else put_literal(out,",\"reversal\":false}\n");
+    }
+}
+
+void write_trades_ndjson(ChunkWriter &out,const vector<Trade> &trades,int precision){
+    RowFormatter f(precision);
+    for(auto &t:trades){
+        put_literal(out,"{\"type\":\"trade\",\"entry_time\":\"");
+        put_time(out,f,t.entry_time);
+        put_literal(out,"\",\"entry_price\":"); put_json_number(out,f,t.entry_price);
+        put_literal(out,",\"exit_time\":\""); put_time(out,f,t.exit_time);
+        put_literal(out,"\",\"exit_price\":"); put_json_number(out,f,t.exit_price);
+        put_literal(out,",\"direction\":\""); put_direction(out,t.direction);
+        put_literal(out,"\",\"profit\":"); put_json_number(out,f,t.profit);
+        put_literal(out,"}\n");
+    }
+}
+
+void write_summary_ndjson(ChunkWriter &out,const vector<Trade> &trades,int precision){
+    RowFormatter f(precision);
+    TradeSummary s = summarize_trades(trades);
+    put_literal(out,"{\"type\":\"summary\",\"total_trades\":"); put_integer(out,static_cast<long long>(s.total_trades));
+    put_literal(out,",\"total_profit\":"); put_json_number(out,f,s.total_profit);
+    put_literal(out,",\"winning_trades\":"); put_integer(out,s.winning_trades);
+    put_literal(out,",\"losing_trades\":"); put_integer(out,s.losing_trades);
+    put_literal(out,",\"max_drawdown\":"); put_json_number(out,f,s.max_drawdown);
+    put_literal(out,"}\n");
+}
+
+// -------- COLUMNAR --------
+template <class T>
+static void put_le(ChunkWriter &out,T v){
+    char *p = out.reserve(sizeof(T));
+    memcpy(p,&v,sizeof(T));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__==__ORDER_BIG_ENDIAN__
+    reverse(p,p+sizeof(T));
+#endif
+    out.commit(p+sizeof(T));
+}
+
+static void put_pad(ChunkWriter &out){
+    static const char zeros[8] = {};
+    size_t r = out.position()%8;
+    if(r) out.write(zeros,8-r);
+}
+
+static void put_name(ChunkWriter &out,const char *name){
+    uint32_t len = static_cast<uint32_t>(strlen(name));
+    put_le(out,len);
+    out.write(name,len);
+}
+
+constexpr uint8_t column_type(int64_t) { return 1; }
+constexpr uint8_t column_type(double) { return 2; }
+constexpr uint8_t column_type(int8_t) { return 3; }
+constexpr uint8_t column_type(bool) { return 4; }
+
+static void begin_table(ChunkWriter &out,const char *name,size_t rows,uint32_t columns){
+    put_name(out,name);
+    put_pad(out);
+    put_le<uint64_t>(out,rows);
+    put_le<uint32_t>(out,columns);
+    put_le<uint32_t>(out,0);
+}
+
+// One column of `get(row)` values, stored as T.
+template <class T,class Rows,class Get>
+static void put_column(ChunkWriter &out,const char *name,const Rows &rows,Get get){
+    put_name(out,name);
+    out.put(static_cast<char>(column_type(T{})));
+    put_pad(out);
+    for(auto &r:rows) put_le<T>(out,static_cast<T>(get(r)));
+    put_pad(out);
+}
+
+static int8_t direction_sign(TradeDirection d){
+    return d==TradeDirection::Long ? 1 : -1;
+}
+
+void write_columnar_header(ChunkWriter &out,uint32_t tables){
+    out.write("BTCOL\0\0\0",8);
+    put_le(out,COLUMNAR_VERSION);
+    put_le(out,tables);
+}
+
+void write_renko_columnar(ChunkWriter &out,const vector<RenkoBrick> &rows){
+    begin_table(out,"renko",rows.size(),8);
+    put_column<int64_t>(out,"brick_time",rows,[](const RenkoBrick &r){ return r.brick_time; });
+    put_column<int64_t>(out,"brick_start_time",rows,[](const RenkoBrick &r){ return r.brick_start_time; });
+    put_column<double>(out,"open",rows,[](const RenkoBrick &r){ return r.open; });
+    put_column<double>(out,"high",rows,[](const RenkoBrick &r){ return r.high; });
+    put_column<double>(out,"low",rows,[](const RenkoBrick &r){ return r.low; });
+    put_column<double>(out,"close",rows,[](const RenkoBrick &r){ return r.close; });
+    put_column<int8_t>(out,"dir",rows,[](const RenkoBrick &r){ return r.dir; });
+    put_column<bool>(out,"reversal",rows,[](const RenkoBrick &r){ return r.reversal; });
+}
+
+void write_ichimoku_columnar(ChunkWriter &out,const vector<IchimokuRow> &rows){
+    begin_table(out,"ichimoku",rows.size(),7);
+    put_column<int64_t>(out,"brick_time",rows,[](const IchimokuRow &r){ return r.brick_time; });
+    put_column<double>(out,"close",rows,[](const IchimokuRow &r){ return r.close; });
+    put_column<double>(out,"tenkan",rows,[](const IchimokuRow &r){ return r.tenkan; });
+    put_column<double>(out,"kijun",rows,[](const IchimokuRow &r){ return r.kijun; });
+    put_column<double>(out,"span_a",rows,[](const IchimokuRow &r){ return r.span_a; });
+    put_column<double>(out,"span_b",rows,[](const IchimokuRow &r){ return r.span_b; });
+    put_column<double>(out,"chikou",rows,[](const IchimokuRow &r){ return r.chikou; });
+}
+
+void write_trades_columnar(ChunkWriter &out,const vector<Trade> &trades){
+    begin_table(out,"trades",trades.size(),6);
+    put_column<int64_t>(out,"entry_time",trades,[](const Trade &t){ return t.entry_time; });
+    put_column<double>(out,"entry_price",trades,[](const Trade &t){ return t.entry_price; });
+    put_column<int64_t>(out,"exit_time",trades,[](const Trade &t){ return t.exit_time; });
+    put_column<double>(out,"exit_price",trades,[](const Trade &t){ return t.exit_price; });
+    put_column<int8_t>(out,"direction",trades,[](const Trade &t){ return direction_sign(t.direction); });
+    put_column<double>(out,"profit",trades,[](const Trade &t){ return t.profit; });
+}
+
+void write_summary_columnar(ChunkWriter &out,const vector<Trade> &trades){
+    array<TradeSummary,1> rows{summarize_trades(trades)};
+    begin_table(out,"summary",1,5);
+    put_column<int64_t>(out,"total_trades",rows,[](const TradeSummary &r){ return static_cast<int64_t>(r.total_trades); });
+    put_column<double>(out,"total_profit",rows,[](const TradeSummary &r){ return r.total_profit; });
+    put_column<int64_t>(out,"winning_trades",rows,[](const TradeSummary &r){ return r.winning_trades; });
+    put_column<int64_t>(out,"losing_trades",rows,[](const TradeSummary &r){ return r.losing_trades; });
+    put_column<double>(out,"max_drawdown",rows,[](const TradeSummary &r){ return r.max_drawdown; });
+}
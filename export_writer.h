@@ -0,0 +1,117 @@
+#pragma once
+
+#include "arena.h"
+#include "strategy.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+// Buffered row output for large exports.
+//
+// Rows are formatted straight into a fixed-size buffer that is handed to the
+// sink whenever it fills, so memory stays flat however many rows are written.
+// The buffer comes from the request arena when one is open.
+class ChunkWriter {
+public:
+    using Sink = std::function<void(const char *data, size_t size)>;
+
+    static constexpr size_t DEFAULT_CAPACITY = 64 * 1024;
+
+    explicit ChunkWriter(Sink sink, size_t capacity = DEFAULT_CAPACITY,
+                         std::pmr::memory_resource *memory = request_memory());
+
+    void write(const char *data, size_t size);
+    void write(const std::string &s) { write(s.data(), s.size()); }
+    void put(char c){
+        if(used_ == buf_.size()) flush();
+        buf_[used_++] = c;
+    }
+    // At least `size` free bytes (size <= capacity) to format into in place;
+    // hand the end of what was written to commit().
+    char* reserve(size_t size){
+        if(buf_.size() - used_ < size) flush();
+        return buf_.data() + used_;
+    }
+    void commit(char *end) { used_ = static_cast<size_t>(end - buf_.data()); }
+    // Sends whatever is buffered; the caller must flush once at the end.
+    void flush();
+
+    size_t bytes_written() const { return total_; }
+    // Bytes written so far, including what is still buffered.
+    size_t position() const { return total_ + used_; }
+
+private:
+    Sink sink_;
+    std::pmr::vector<char> buf_;
+    size_t used_ = 0;
+    size_t total_ = 0;
+};
+
+// Field formatting for the writers below, without iostreams or allocation.
+//
+// Numbers go through std::to_chars: `precision` significant digits as with
+// printf("%.*g"), or the shortest round-trip form when it is 0. Timestamps
+// are IST "YYYY-MM-DDTHH:MM:SS" as from epoch_to_ist_iso; the date part is
+// cached and only recomputed when the day changes.
+class RowFormatter {
+public:
+    static constexpr size_t MAX_FIELD = 32;   // bytes any single field may take
+    static constexpr int MAX_PRECISION = 17;
+
+    explicit RowFormatter(int precision = 6);
+
+    char* number(char *p, double v) const;
+    char* json_number(char *p, double v) const;   // null for NaN and infinities
+    char* ist_time(char *p, int64_t epoch_sec);
+    static char* integer(char *p, long long v);
+
+private:
+    int precision_;
+    int64_t day_;
+    char date_[24];
+    size_t date_len_ = 0;
+};
+
+enum class OutputFormat { Json, Csv, Ndjson, Columnar };
+
+// "json", "csv", "ndjson" or "columnar"; throws std::runtime_error otherwise.
+OutputFormat output_format_from_string(const std::string &name);
+
+// Content-Type of a streamed format.
+const char* output_content_type(OutputFormat format);
+
+// CSV as served since the first release; the default precision of 6 is what
+// iostreams printed, so these back the *_to_csv_string functions.
+void write_renko_csv(ChunkWriter &out, const std::vector<RenkoBrick> &rows, int precision = 6);
+void write_trades_csv(ChunkWriter &out, const std::vector<Trade> &trades, int precision = 6);
+void write_summary_csv(ChunkWriter &out, const std::vector<Trade> &trades, int precision = 6);
+
+// One JSON object per line, tagged with "type": brick, trade or summary.
+void write_renko_ndjson(ChunkWriter &out, const std::vector<RenkoBrick> &rows, int precision = 0);
+void write_trades_ndjson(ChunkWriter &out, const std::vector<Trade> &trades, int precision = 0);
+void write_summary_ndjson(ChunkWriter &out, const std::vector<Trade> &trades, int precision = 0);
+
+// Columnar binary tables, for loading straight into dataframes.
+//
+// All integers are little-endian; "pad" is zero bytes up to the next
+// multiple of 8 from the start of the payload, so every column's data is
+// 8-byte aligned and can be mapped as an array in place.
+//
+//   payload: magic "BTCOL\0\0\0" | u32 version (1) | u32 table_count | table...
+//   table:   u32 name_len | name | pad | u64 rows | u32 column_count | u32 0 | column...
+//   column:  u32 name_len | name | u8 type | pad | rows values | pad
+//
+// Column types: 1 int64, 2 float64, 3 int8, 4 bool (one byte, 0 or 1).
+// Times are int64 Unix seconds (UTC); NaN marks Ichimoku warm-up rows;
+// trade direction is int8, 1 long and -1 short.
+const uint32_t COLUMNAR_VERSION = 1;
+
+void write_columnar_header(ChunkWriter &out, uint32_t tables);
+void write_renko_columnar(ChunkWriter &out, const std::vector<RenkoBrick> &rows);
+void write_ichimoku_columnar(ChunkWriter &out, const std::vector<IchimokuRow> &rows);
+void write_trades_columnar(ChunkWriter &out, const std::vector<Trade> &trades);
+void write_summary_columnar(ChunkWriter &out, const std::vector<Trade> &trades);
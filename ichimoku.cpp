@@ -0,0 +1,60 @@
+#include "ichimoku.h"
+
+#include <cmath>
+
+using namespace std;
+
+// -------- RollingMinMax --------
+RollingMinMax::RollingMinMax(int length) : length_(length){
+    if(length_<=0) return;
+    uint64_t cap = 1;
+    while(cap<static_cast<uint64_t>(length_)) cap <<= 1;
+    mask_ = cap-1;
+    max_q_.resize(cap);
+    min_q_.resize(cap);
+}
+
+void RollingMinMax::push(double v){
+    if(length_<=0) return;
+    uint64_t i = count_++;
+    // Entries that fell out of the window leave from the front...
+    if(max_head_!=max_tail_ && max_q_[max_head_&mask_].index+length_<=i) max_head_++;
+    if(min_head_!=min_tail_ && min_q_[min_head_&mask_].index+length_<=i) min_head_++;
+    // ...and entries dominated by the new value leave from the back.
+    while(max_head_!=max_tail_ && max_q_[(max_tail_-1)&mask_].value<=v) max_tail_--;
+    while(min_head_!=min_tail_ && min_q_[(min_tail_-1)&mask_].value>=v) min_tail_--;
+    max_q_[(max_tail_++)&mask_] = {i,v};
+    min_q_[(min_tail_++)&mask_] = {i,v};
+}
+
+// -------- IchimokuEngine --------
+IchimokuEngine::IchimokuEngine(int tenkan_len,int kijun_len,int span_b_len,int displacement)
+    : tenkan_(tenkan_len), kijun_(kijun_len), span_b_(span_b_len), displacement_(displacement){
+    if(displacement_>0) lagged_.resize(displacement_);
+}
+
+IchimokuRow IchimokuEngine::push(int64_t brick_time,double close){
+    tenkan_.push(close);
+    kijun_.push(close);
+    span_b_.push(close);
+
+    IchimokuRow row;
+    row.brick_time = brick_time;
+    row.close = close;
+    row.tenkan = tenkan_.ready() ? tenkan_.mid() : NAN;
+    row.kijun = kijun_.ready() ? kijun_.mid() : NAN;
+    row.span_a = isnan(row.tenkan)||isnan(row.kijun) ? NAN : (row.tenkan+row.kijun)/2.0;
+    row.span_b = span_b_.ready() ? span_b_.mid() : NAN;
+
+    uint64_t i = count_++;
+    if(displacement_==0) row.chikou = close;
+    else if(displacement_<0) row.chikou = NAN;
+    else {
+        // lagged_ is a ring of the last `displacement` closes; the slot about
+        // to be overwritten holds close[i-displacement].
+        double &slot = lagged_[i%displacement_];
+        row.chikou = i>=static_cast<uint64_t>(displacement_) ? slot : NAN;
+        slot = close;
+    }
+    return row;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "strategy.h"
+
+#include <cstdint>
+#include <vector>
+
+// Highest high / lowest low of the last `length` values, maintained with a
+// pair of monotonic deques so each push is amortised O(1).
+class RollingMinMax {
+public:
+    explicit RollingMinMax(int length);
+
+    void push(double v);
+    bool ready() const { return length_>0 && count_>=static_cast<uint64_t>(length_); }
+    double max() const { return max_q_[max_head_&mask_].value; }
+    double min() const { return min_q_[min_head_&mask_].value; }
+    double mid() const { return (max()+min())/2.0; }
+
+private:
+    struct Entry { uint64_t index; double value; };
+
+    int length_;
+    uint64_t count_ = 0;
+    uint64_t mask_ = 0;
+    std::vector<Entry> max_q_, min_q_;   // ring buffers, head..tail
+    uint64_t max_head_ = 0, max_tail_ = 0;
+    uint64_t min_head_ = 0, min_tail_ = 0;
+};
+
+// Fused, incremental Ichimoku: one push per brick updates tenkan, kijun and
+// span B windows together and derives span A and chikou from them.
+class IchimokuEngine {
+public:
+    IchimokuEngine(int tenkan_len, int kijun_len, int span_b_len, int displacement);
+
+    IchimokuRow push(int64_t brick_time, double close);
+
+private:
+    RollingMinMax tenkan_, kijun_, span_b_;
+    int displacement_;
+    uint64_t count_ = 0;
+    std::vector<double> lagged_;   // last `displacement` closes for chikou
+};
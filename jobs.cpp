@@ -0,0 +1,187 @@
+#include "jobs.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+
+using json = nlohmann::json;
+using namespace std;
+
+// Finished jobs are forgotten after this long, or sooner past the cap.
+static const chrono::minutes FINISHED_JOB_TTL(60);
+static const size_t MAX_FINISHED_JOBS = 1000;
+
+const char* job_status_name(JobStatus s){
+    switch(s){
+    case JobStatus::Queued: return "queued";
+    case JobStatus::Running: return "running";
+    case JobStatus::Succeeded: return "succeeded";
+    case JobStatus::Failed: return "failed";
+    case JobStatus::Cancelled: return "cancelled";
+    }
+    return "unknown";
+}
+
+static string iso_utc(chrono::system_clock::time_point t){
+    if(t.time_since_epoch().count()==0) return "";
+    time_t tt = chrono::system_clock::to_time_t(t);
+    tm tm_buf{};
+    gmtime_r(&tt,&tm_buf);
+    char buf[32];
+    strftime(buf,sizeof(buf),"%Y-%m-%dT%H:%M:%SZ",&tm_buf);
+    return buf;
+}
+
+// -------- Job --------
+Job::Job(string id,string type,Work work)
+    : id_(move(id)), type_(move(type)), work_(move(work)), created_(Clock::now()) {}
+
+JobStatus Job::status() const{
+    lock_guard<mutex> lk(mu_);
+    return status_;
+}
+
+bool Job::finished() const{
+    JobStatus s = status();
+    return s==JobStatus::Succeeded || s==JobStatus::Failed || s==JobStatus::Cancelled;
+}
+
+json Job::describe() const{
+    lock_guard<mutex> lk(mu_);
+    double progress = status_==JobStatus::Succeeded ? 1.0 : control_.progress();
+    json j = {
+        {"job_id", id_},
+        {"type", type_},
+        {"status", job_status_name(status_)},
+        {"stage", status_==JobStatus::Running ? control_.stage() : job_status_name(status_)},
+        {"progress", round(progress*1000.0)/1000.0},
+        {"created_at", iso_utc(created_)}
+    };
+    if(started_.time_since_epoch().count()) j["started_at"] = iso_utc(started_);
+    if(finished_.time_since_epoch().count()) j["finished_at"] = iso_utc(finished_);
+    if(!error_.empty()) j["error"] = error_;
+    return j;
+}
+
+json Job::result() const{
+    lock_guard<mutex> lk(mu_);
+    return result_;
+}
+
+// -------- JobManager --------
+static string new_job_id(){
+    static mutex mu;
+    static mt19937_64 rng(random_device{}());
+    lock_guard<mutex> lk(mu);
+    char buf[17];
+    snprintf(buf,sizeof(buf),"%016llx",static_cast<unsigned long long>(rng()));
+    return buf;
+}
+
+JobManager::JobManager(size_t threads,size_t queue_capacity) : capacity_(queue_capacity){
+    threads = max<size_t>(1,threads);
+    for(size_t i=0;i<threads;i++) workers_.emplace_back([this]{ worker_loop(); });
+}
+
+JobManager::~JobManager(){
+    {
+        lock_guard<mutex> lk(mu_);
+        stop_ = true;
+        for(auto &j:jobs_) j.second->control_.cancel();
+    }
+    ready_.notify_all();
+    for(auto &t:workers_) t.join();
+}
+
+shared_ptr<Job> JobManager::submit(const string &type,Job::Work work){
+    lock_guard<mutex> lk(mu_);
+    if(queue_.size()>=capacity_) return nullptr;
+    prune_locked();
+    string id;
+    do { id = new_job_id(); } while(jobs_.count(id));
+    auto job = make_shared<Job>(id,type,move(work));
+    jobs_.emplace(id,job);
+    queue_.push_back(job);
+    ready_.notify_one();
+    return job;
+}
+
+shared_ptr<Job> JobManager::get(const string &id){
+    lock_guard<mutex> lk(mu_);
+    auto it = jobs_.find(id);
+    return it==jobs_.end() ? nullptr : it->second;
+}
+
+bool JobManager::cancel(const string &id){
+    lock_guard<mutex> lk(mu_);
+    auto it = jobs_.find(id);
+    if(it==jobs_.end()) return false;
+    auto job = it->second;
+    job->control_.cancel();
+    auto q = find(queue_.begin(),queue_.end(),job);
+    if(q!=queue_.end()){
+        queue_.erase(q);
+        lock_guard<mutex> jl(job->mu_);
+        job->status_ = JobStatus::Cancelled;
+        job->finished_ = Job::Clock::now();
+    }
+    return true;
+}
+
+size_t JobManager::queued() const{
+    lock_guard<mutex> lk(mu_);
+    return queue_.size();
+}
+
+void JobManager::prune_locked(){
+    auto now = Job::Clock::now();
+    vector<pair<Job::Clock::time_point,string>> finished;
+    for(auto it=jobs_.begin();it!=jobs_.end();){
+        Job &j = *it->second;
+        lock_guard<mutex> jl(j.mu_);
+        bool done = j.status_!=JobStatus::Queued && j.status_!=JobStatus::Running;
+        if(done && now-j.finished_>FINISHED_JOB_TTL){ it = jobs_.erase(it); continue; }
+        if(done) finished.emplace_back(j.finished_,it->first);
+        ++it;
+    }
+    if(finished.size()>MAX_FINISHED_JOBS){
+        sort(finished.begin(),finished.end());
+        for(size_t i=0;i<finished.size()-MAX_FINISHED_JOBS;i++) jobs_.erase(finished[i].second);
+    }
+}
+
+void JobManager::worker_loop(){
+    while(true){
+        shared_ptr<Job> job;
+        {
+            unique_lock<mutex> lk(mu_);
+            ready_.wait(lk,[this]{ return stop_ || !queue_.empty(); });
+            if(stop_) return;
+            job = queue_.front();
+            queue_.pop_front();
+            lock_guard<mutex> jl(job->mu_);
+            job->status_ = JobStatus::Running;
+            job->started_ = Job::Clock::now();
+        }
+
+        JobStatus status = JobStatus::Succeeded;
+        string error;
+        json result;
+        try {
+            job->control_.check();
+            result = job->work_(job->control_);
+        } catch(const BacktestCancelled&){
+            status = JobStatus::Cancelled;
+        } catch(const exception &e){
+            status = JobStatus::Failed;
+            error = e.what();
+        }
+
+        lock_guard<mutex> jl(job->mu_);
+        job->status_ = status;
+        job->error_ = error;
+        job->result_ = move(result);
+        job->finished_ = Job::Clock::now();
+        job->work_ = nullptr;
+    }
+}
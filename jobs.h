@@ -0,0 +1,85 @@
+#pragma once
+
+#include "run_control.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+// Background execution for long backtests.
+//
+// Jobs wait in a bounded FIFO and run on the manager's own threads, so slow
+// requests never tie up the HTTP worker threads. Finished jobs are kept for
+// a while so clients can collect their results.
+enum class JobStatus { Queued, Running, Succeeded, Failed, Cancelled };
+
+const char* job_status_name(JobStatus s);
+
+class Job {
+public:
+    using Work = std::function<nlohmann::json(RunControl&)>;
+
+    Job(std::string id, std::string type, Work work);
+
+    const std::string& id() const { return id_; }
+    const std::string& type() const { return type_; }
+    JobStatus status() const;
+    bool finished() const;
+
+    // Status, stage and progress, without the result.
+    nlohmann::json describe() const;
+    // Only meaningful once status() is Succeeded.
+    nlohmann::json result() const;
+
+private:
+    friend class JobManager;
+    using Clock = std::chrono::system_clock;
+
+    std::string id_, type_;
+    Work work_;
+    RunControl control_;
+
+    mutable std::mutex mu_;
+    JobStatus status_ = JobStatus::Queued;
+    std::string error_;
+    nlohmann::json result_;
+    Clock::time_point created_, started_, finished_;
+};
+
+class JobManager {
+public:
+    JobManager(size_t threads, size_t queue_capacity);
+    ~JobManager();
+
+    // nullptr when the queue is full.
+    std::shared_ptr<Job> submit(const std::string &type, Job::Work work);
+    std::shared_ptr<Job> get(const std::string &id);
+    // Queued jobs are dropped at once; running ones stop at their next check.
+    bool cancel(const std::string &id);
+
+    size_t queued() const;
+    size_t capacity() const { return capacity_; }
+    size_t threads() const { return workers_.size(); }
+
+private:
+    void worker_loop();
+    void prune_locked();
+
+    size_t capacity_;
+    mutable std::mutex mu_;
+    std::condition_variable ready_;
+    std::deque<std::shared_ptr<Job>> queue_;
+    std::map<std::string, std::shared_ptr<Job>> jobs_;
+    std::vector<std::thread> workers_;
+    bool stop_ = false;
+};
@@ -0,0 +1,304 @@
+#include "log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+const char* log_level_name(LogLevel level){
+    switch(level){
+    case LogLevel::Debug: return "DEBUG";
+    case LogLevel::Info: return "INFO";
+    case LogLevel::Warn: return "WARN";
+    case LogLevel::Error: return "ERROR";
+    }
+    return "?";
+}
+
+namespace {
+
+LogLevel level_from_env(){
+    const char *env = getenv("BACKTEST_LOG_LEVEL");
+    string s = env ? env : "";
+    for(auto &c:s) c = static_cast<char>(tolower(c));
+    if(s=="debug") return LogLevel::Debug;
+    if(s=="warn") return LogLevel::Warn;
+    if(s=="error") return LogLevel::Error;
+    return LogLevel::Info;
+}
+
+atomic<int> min_level{static_cast<int>(level_from_env())};
+atomic<uint64_t> next_request{1};
+thread_local uint64_t current_request = 0;
+
+struct Record {
+    int64_t time_us;
+    uint64_t request;
+    LogLevel level;
+    uint32_t size;
+    char text[LOG_LINE_MAX];
+};
+
+// Single producer (the owning thread), single consumer (the drain thread).
+class Ring {
+public:
+    static const size_t SLOTS = 256;
+
+    bool push(LogLevel level,const char *text,size_t size){
+        uint64_t h = head_.load(memory_order_relaxed);
+        if(h-tail_.load(memory_order_acquire)>=SLOTS){
+            dropped_.fetch_add(1,memory_order_relaxed);
+            return false;
+        }
+        Record &r = slots_[h%SLOTS];
+        r.time_us = chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now().time_since_epoch()).count();
+        r.request = current_request;
+        r.level = level;
+        r.size = static_cast<uint32_t>(size);
+        memcpy(r.text,text,size);
+        head_.store(h+1,memory_order_release);
+        return true;
+    }
+
+    size_t pending() const { return head_.load(memory_order_acquire)-tail_.load(memory_order_relaxed); }
+
+    template <class F>
+    void drain(F &&f){
+        uint64_t t = tail_.load(memory_order_relaxed);
+        uint64_t h = head_.load(memory_order_acquire);
+        for(;t<h;t++) f(slots_[t%SLOTS]);
+        tail_.store(t,memory_order_release);
+    }
+
+    uint64_t take_dropped() { return dropped_.exchange(0,memory_order_relaxed); }
+
+private:
+    Record slots_[SLOTS];
+    atomic<uint64_t> head_{0}, tail_{0};
+    atomic<uint64_t> dropped_{0};
+};
+
+class Logger {
+public:
+    Logger() : thread_([this]{ run(); }) {}
+
+    ~Logger(){
+        {
+            lock_guard<mutex> lk(mu_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        thread_.join();
+    }
+
+    Ring& local_ring(){
+        thread_local Ring *ring = nullptr;
+        if(!ring){
+            auto r = make_unique<Ring>();
+            ring = r.get();
+            lock_guard<mutex> lk(rings_mu_);
+            rings_.push_back(move(r));
+        }
+        return *ring;
+    }
+
+    void push(LogLevel level,const char *text,size_t size){
+        Ring &ring = local_ring();
+        ring.push(level,text,size);
+        // Errors and filling rings are written out right away.
+        if(level==LogLevel::Error || ring.pending()>=Ring::SLOTS/2) cv_.notify_one();
+    }
+
+    void flush(){
+        unique_lock<mutex> lk(mu_);
+        uint64_t target = ++flush_requested_;
+        cv_.notify_all();
+        flushed_cv_.wait(lk,[&]{ return flushed_>=target || stop_; });
+    }
+
+    uint64_t dropped() const { return dropped_total_.load(); }
+
+private:
+    void run(){
+        unique_lock<mutex> lk(mu_);
+        while(true){
+            cv_.wait_for(lk,chrono::milliseconds(20));
+            bool stopping = stop_;
+            uint64_t flush_target = flush_requested_;
+            lk.unlock();
+            write_batch();
+            lk.lock();
+            flushed_ = flush_target;
+            flushed_cv_.notify_all();
+            if(stopping) return;
+        }
+    }
+
+    // Everything pending across all rings, in time order.
+    void write_batch(){
+        batch_.clear();
+        uint64_t dropped = 0;
+        {
+            lock_guard<mutex> lk(rings_mu_);
+            for(auto &ring:rings_){
+                ring->drain([&](const Record &r){ batch_.push_back(r); });
+                dropped += ring->take_dropped();
+            }
+        }
+        if(batch_.empty() && dropped==0) return;
+        stable_sort(batch_.begin(),batch_.end(),[](const Record &a,const Record &b){ return a.time_us<b.time_us; });
+
+        out_.clear();
+        for(auto &r:batch_) format(r);
+        if(dropped){
+            dropped_total_ += dropped;
+            Record note{};
+            note.time_us = chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now().time_since_epoch()).count();
+            note.level = LogLevel::Warn;
+            int n = snprintf(note.text,sizeof(note.text),"log: dropped %llu lines (ring full)",
+                             static_cast<unsigned long long>(dropped));
+            note.size = static_cast<uint32_t>(max(0,n));
+            format(note);
+        }
+        fwrite(out_.data(),1,out_.size(),stdout);
+        fflush(stdout);
+    }
+
+    // "YYYY-MM-DD HH:MM:SS.mmm LEVEL [req N] text", local time.
+    void format(const Record &r){
+        time_t sec = static_cast<time_t>(r.time_us/1000000);
+        if(sec!=stamp_sec_){
+            tm tm{};
+            localtime_r(&sec,&tm);
+            stamp_len_ = strftime(stamp_,sizeof(stamp_),"%Y-%m-%d %H:%M:%S",&tm);
+            stamp_sec_ = sec;
+        }
+        char head[96];
+        int n = snprintf(head,sizeof(head),".%03d %-5s ",static_cast<int>(r.time_us/1000%1000),log_level_name(r.level));
+        out_.append(stamp_,stamp_len_);
+        out_.append(head,static_cast<size_t>(max(0,n)));
+        if(r.request){
+            char id[32];
+            int m = snprintf(id,sizeof(id),"[req %llu] ",static_cast<unsigned long long>(r.request));
+            out_.append(id,static_cast<size_t>(max(0,m)));
+        }
+        out_.append(r.text,r.size);
+        out_ += '\n';
+    }
+
+    mutex rings_mu_;
+    vector<unique_ptr<Ring>> rings_;   // kept for the life of the process
+
+    mutex mu_;
+    condition_variable cv_, flushed_cv_;
+    bool stop_ = false;
+    uint64_t flush_requested_ = 0, flushed_ = 0;
+    atomic<uint64_t> dropped_total_{0};
+
+    // Drain thread only.
+    vector<Record> batch_;
+    string out_;
+    time_t stamp_sec_ = -1;
+    char stamp_[32];
+    size_t stamp_len_ = 0;
+
+    thread thread_;   // last, so everything above exists when it starts
+};
+
+Logger& logger(){
+    static Logger instance;
+    return instance;
+}
+
+} // namespace
+
+void set_log_level(LogLevel level){
+    min_level.store(static_cast<int>(level),memory_order_relaxed);
+}
+
+LogLevel log_level(){
+    return static_cast<LogLevel>(min_level.load(memory_order_relaxed));
+}
+
+LogLine::LogLine(LogLevel level)
+    : enabled_(static_cast<int>(level)>=min_level.load(memory_order_relaxed)), level_(level) {}
+
+LogLine::~LogLine(){
+    if(enabled_) logger().push(level_,text_,size_);
+}
+
+void LogLine::append(const char *s,size_t n){
+    if(!enabled_) return;
+    size_t room = LOG_LINE_MAX-size_;
+    if(n>room){
+        n = room;
+        if(room>=3){
+            // Mark the cut.
+            memcpy(text_+size_,s,room-3);
+            memcpy(text_+LOG_LINE_MAX-3,"...",3);
+            size_ = LOG_LINE_MAX;
+            return;
+        }
+    }
+    memcpy(text_+size_,s,n);
+    size_ += n;
+}
+
+LogLine& LogLine::operator<<(const char *s){
+    if(s) append(s,strlen(s));
+    return *this;
+}
+
+LogLine& LogLine::operator<<(long long v){
+    char buf[24];
+    append(buf,static_cast<size_t>(to_chars(buf,buf+sizeof(buf),v).ptr-buf));
+    return *this;
+}
+
+LogLine& LogLine::operator<<(unsigned long long v){
+    char buf[24];
+    append(buf,static_cast<size_t>(to_chars(buf,buf+sizeof(buf),v).ptr-buf));
+    return *this;
+}
+
+// Six significant digits, as cout printed them.
+LogLine& LogLine::operator<<(double v){
+    char buf[32];
+    append(buf,static_cast<size_t>(to_chars(buf,buf+sizeof(buf),v,chars_format::general,6).ptr-buf));
+    return *this;
+}
+
+LogRequest::LogRequest() : id_(next_request.fetch_add(1)), previous_(current_request) {
+    current_request = id_;
+}
+
+LogRequest::LogRequest(uint64_t id) : id_(id), previous_(current_request) {
+    current_request = id_;
+}
+
+LogRequest::~LogRequest(){
+    current_request = previous_;
+}
+
+uint64_t log_request_id(){
+    return current_request;
+}
+
+void log_flush(){
+    logger().flush();
+}
+
+uint64_t log_dropped(){
+    return logger().dropped();
+}
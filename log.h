@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <type_traits>
+
+// Asynchronous logging.
+//
+// A log line is formatted on the calling thread into a fixed-size record
+// and pushed onto that thread's ring buffer (single producer, single
+// consumer, no locks). A background thread drains every ring, orders the
+// records by time and writes them to stdout in batches, so request threads
+// never wait on stdout. When a ring is full the line is dropped and
+// counted; the drain thread reports the count. Lines longer than
+// LOG_LINE_MAX are cut short.
+//
+//   log_info() << "Fetched " << n << " candles";
+//
+// Every line carries the request id of the enclosing LogRequest, if any.
+enum class LogLevel { Debug, Info, Warn, Error };
+
+const size_t LOG_LINE_MAX = 480;
+
+const char* log_level_name(LogLevel level);
+
+// Lines below this level are discarded before formatting. Defaults to
+// BACKTEST_LOG_LEVEL (debug, info, warn, error) or info.
+void set_log_level(LogLevel level);
+LogLevel log_level();
+
+class LogLine {
+public:
+    explicit LogLine(LogLevel level);
+    ~LogLine();   // pushes the line
+    LogLine(const LogLine&) = delete;
+    LogLine& operator=(const LogLine&) = delete;
+
+    LogLine& operator<<(const char *s);
+    LogLine& operator<<(const std::string &s) { append(s.data(), s.size()); return *this; }
+    LogLine& operator<<(char c) { append(&c, 1); return *this; }
+    LogLine& operator<<(bool b) { return *this << (b ? "true" : "false"); }
+    LogLine& operator<<(long long v);
+    LogLine& operator<<(unsigned long long v);
+    LogLine& operator<<(double v);
+
+    template <class T, std::enable_if_t<std::is_integral<T>::value && std::is_signed<T>::value, int> = 0>
+    LogLine& operator<<(T v) { return *this << static_cast<long long>(v); }
+    template <class T, std::enable_if_t<std::is_integral<T>::value && std::is_unsigned<T>::value, int> = 0>
+    LogLine& operator<<(T v) { return *this << static_cast<unsigned long long>(v); }
+    LogLine& operator<<(float v) { return *this << static_cast<double>(v); }
+
+    // Anything else with an ostream operator (json values and the like).
+    template <class T, std::enable_if_t<!std::is_arithmetic<T>::value, int> = 0>
+    LogLine& operator<<(const T &v){
+        if(!enabled_) return *this;
+        std::ostringstream oss;
+        oss << v;
+        return *this << oss.str();
+    }
+
+private:
+    void append(const char *s, size_t n);
+
+    bool enabled_;
+    LogLevel level_;
+    size_t size_ = 0;
+    char text_[LOG_LINE_MAX];
+};
+
+inline LogLine log_debug() { return LogLine(LogLevel::Debug); }
+inline LogLine log_info() { return LogLine(LogLevel::Info); }
+inline LogLine log_warn() { return LogLine(LogLevel::Warn); }
+inline LogLine log_error() { return LogLine(LogLevel::Error); }
+
+// Tags this thread's lines with a fresh request id until destroyed, or
+// with an existing one for work done on behalf of that request elsewhere.
+class LogRequest {
+public:
+    LogRequest();
+    explicit LogRequest(uint64_t id);
+    ~LogRequest();
+    LogRequest(const LogRequest&) = delete;
+    LogRequest& operator=(const LogRequest&) = delete;
+
+    uint64_t id() const { return id_; }
+
+private:
+    uint64_t id_;
+    uint64_t previous_;
+};
+
+// This thread's current request id, 0 outside any LogRequest.
+uint64_t log_request_id();
+
+// Blocks until every line pushed before the call has been written.
+void log_flush();
+
+// Lines dropped so far because a ring was full.
+uint64_t log_dropped();
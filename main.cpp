@@ -1,587 +1,878 @@
 #include <pistache/endpoint.h>
 #include <pistache/router.h>
 #include <nlohmann/json.hpp>
+#include <atomic>
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <cerrno>
 #include <cmath>
 #include <thread>
 #include <chrono>
+#include <cstdlib>
 #include <curl/curl.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "artifact_store.h"
+#include "backtest.h"
+#include "batch.h"
+#include "compression.h"
+#include "jobs.h"
+#include "log.h"
+#include "strategy.h"
+#include "market_data.h"
+#include "metrics.h"
+#include "monte_carlo.h"
+#include "result_cache.h"
+#include "session.h"
+#include "sweep.h"
+#include "thread_pool.h"
+#include "walk_forward.h"
 
 using json = nlohmann::json;
 using namespace std;
 
-// ======================
-// COPY EXACTLY FROM strategyinc.cpp (START)
-// ======================
-
-// -------- STRUCTS --------
-struct Candle {
-    int64_t time;
-    double open, high, low, close, volume;
-};
-
-struct RenkoBrick {
-    int64_t brick_time, brick_start_time;
-    double src_open, src_high, src_low, src_close;
-    double open, high, low, close;
-    int dir;
-    bool reversal;
-};
-
-struct IchimokuRow {
-    int64_t brick_time;
-    double close;
-    double tenkan, kijun, span_a, span_b, chikou;
-};
-
-struct Trade {
-    int64_t entry_time;
-    double entry_price;
-    int64_t exit_time;
-    double exit_price;
-    string direction;
-    double profit;
-};
-
-// -------- UTILITY FUNCTIONS --------
-int64_t ist_to_unix(const string &date_str, const string &with_time = "00:00:00"){
-    tm tm{};
-    string dt = date_str + " " + with_time;
-    istringstream ss(dt);
-    ss >> get_time(&tm, "%Y-%m-%d %H:%M:%S");
-#if defined(_WIN32)
-    time_t epoch = _mkgmtime(&tm);
-#else
-    time_t epoch = timegm(&tm);
-#endif
-    const int IST_OFFSET = 5*3600 + 30*60;
-    return static_cast<int64_t>(epoch) - IST_OFFSET;
-}
+using namespace Pistache;
 
-int resolution_seconds(const string &res){
-    string s = res; for(auto &c:s) c = tolower(c);
-    if(!s.empty() && s.back()=='m') return stoi(s.substr(0,s.size()-1))*60;
-    if(!s.empty() && s.back()=='h') return stoi(s.substr(0,s.size()-1))*3600;
-    if(!s.empty() && s.back()=='d') return stoi(s.substr(0,s.size()-1))*86400;
-    return 60;
-}
+class BacktestHandler {
+public:
+    BacktestHandler(size_t job_threads, size_t job_queue, size_t inline_limit, size_t max_sessions,
+                    chrono::seconds session_ttl)
+        : sessions(max_sessions, session_ttl), jobs(job_threads, job_queue), inline_limit(inline_limit) {}
 
-size_t write_callback(void* contents, size_t size, size_t nmemb, string* s){
-    size_t total = size*nmemb;
-    s->append((char*)contents,total);
-    return total;
-}
+    void handleBacktest(const Rest::Request& request, Http::ResponseWriter response) {
+        auto start_time = chrono::steady_clock::now();
+        string client_ip = request.address().host();
+        LogRequest log_request;
+        log_info() << "BACKTEST REQUEST RECEIVED from " << client_ip;
+        ArenaScope arena;
+        RequestMetrics metrics(Endpoint::Backtest);
+        InlineSlot slot(inline_busy);
+        if (!admit(slot, response)) return;
+        
+        try {
+            auto data = json::parse(request.body());
 
-string epoch_to_ist_iso(int64_t epoch_sec){
-    const int IST_OFFSET = 5*3600+30*60;
-    time_t t = static_cast<time_t>(epoch_sec+IST_OFFSET);
-    tm tm{};
-#if defined(_WIN32)
-    gmtime_s(&tm,&t);
-#else
-    gmtime_r(&t,&tm);
-#endif
-    char buf[64];
-    strftime(buf,sizeof(buf),"%Y-%m-%dT%H:%M:%S",&tm);
-    return string(buf);
-}
+            // Log request parameters
+            log_info() << "Request parameters:";
+            log_info() << "   Symbol: " << data.value("symbol", "ETHUSDT");
+            log_info() << "   Resolution: " << data.value("resolution", "5m");
+            log_info() << "   Date range: " << data.value("start_date", "2023-08-01") << " to " 
+                 << data.value("end_date", "2023-08-02");
+
+            BacktestParams params = backtest_params_from_json(data);
+            OutputFormat format = output_format_from_json(data);
+            string file_type = data.value("file_type", "all");
+            int precision = data.value("precision", -1);
+            if (format != OutputFormat::Json) check_stream_selection(format, file_type, precision);
+            MonteCarloParams monte_carlo;
+            bool want_monte_carlo = monte_carlo_from_json(data, monte_carlo);
+            if (want_monte_carlo && format != OutputFormat::Json) {
+                throw runtime_error("monte_carlo needs json output");
+            }
+            OutputFormat artifact_format = OutputFormat::Csv;
+            bool want_artifacts = artifacts_from_json(data, artifact_format);
+            if (want_artifacts && format != OutputFormat::Json) throw runtime_error("artifacts need json output");
+            ContentEncoding encoding = accepted_encoding(request);
+
+            BacktestRun run = run_backtest(params);
+
+            if (format != OutputFormat::Json) {
+                size_t bytes = stream_run(response, format, file_type, precision, params, run, encoding);
+                auto duration = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start_time);
+                log_info() << "Backtest streamed in " << duration.count() << "ms - " << run.trades->size()
+                     << " trades, " << bytes << " bytes" << encoding_note(encoding) << arena_note(arena);
+                metrics.response_bytes(bytes);
+                metrics.succeed();
+                return;
+            }
 
-double get_source_price(const Candle &c, const string &source){
-    string s = source; for(auto &ch:s) ch = tolower(ch);
-    if(s=="close") return c.close;
-    if(s=="open") return c.open;
-    if(s=="high") return c.high;
-    if(s=="low") return c.low;
-    if(s=="hl2") return (c.high+c.low)/2.0;
-    if(s=="hlc3") return (c.high+c.low+c.close)/3.0;
-    if(s=="ohlc4") return (c.open+c.high+c.low+c.close)/4.0;
-    throw runtime_error("Unsupported source type: "+source);
-}
+            auto end_time = chrono::steady_clock::now();
+            auto duration = chrono::duration_cast<chrono::milliseconds>(end_time - start_time);
 
-vector<Candle> fetch_candles(const string &symbol,const string &resolution,int64_t start_time,int64_t end_time,int limit=4000){
-    int sec_per_candle = resolution_seconds(resolution);
-    int64_t max_window_seconds = static_cast<int64_t>(limit)*sec_per_candle;
-    vector<pair<int64_t,int64_t>> windows;
-    int64_t cur = start_time;
-    while(cur<=end_time){
-        int64_t window_end = min(end_time, cur+max_window_seconds-1);
-        windows.emplace_back(cur,window_end);
-        cur = window_end+1;
-    }
-    vector<Candle> all_data;
-    for(auto &w:windows){
-        int64_t wstart=w.first, wend=w.second;
-        // Fixed: remove extra spaces in URL
-        string url = "https://api.delta.exchange/v2/history/candles?symbol="+symbol+"&resolution="+resolution+
-                     "&start="+to_string(wstart)+"&end="+to_string(wend)+"&limit="+to_string(limit);
-        string resp;
-        CURL* curl = curl_easy_init();
-        if(curl){
-            curl_easy_setopt(curl,CURLOPT_URL,url.c_str());
-            curl_easy_setopt(curl,CURLOPT_WRITEFUNCTION,write_callback);
-            curl_easy_setopt(curl,CURLOPT_WRITEDATA,&resp);
-            curl_easy_setopt(curl,CURLOPT_TIMEOUT,30L);
-            struct curl_slist* headers=NULL;
-            headers = curl_slist_append(headers,"accept: application/json");
-            headers = curl_slist_append(headers,"User-Agent: cpp-client/1.0");
-            curl_easy_setopt(curl,CURLOPT_HTTPHEADER,headers);
-            CURLcode res = curl_easy_perform(curl);
-            curl_slist_free_all(headers);
-            curl_easy_cleanup(curl);
-            if(res!=CURLE_OK) throw runtime_error(string("curl error: ")+curl_easy_strerror(res));
-        }
-        json j = json::parse(resp);
-        if(!j.contains("result")) continue;
-        json arr = j["result"];
-        if(arr.is_null()||arr.empty()) continue;
-        for(auto &item:arr){
-            if(item.is_array() && item.size() >= 5) {
-                // Helper lambda to safely get double (0.0 if null or missing)
-                auto safe_get_double = [](const json& j, double fallback = 0.0) -> double {
-                    if (j.is_number()) return j.get<double>();
-                    if (j.is_null()) return fallback;
-                    try { return j.get<double>(); }
-                    catch(...) { return fallback; }
-                    return fallback;
-                };
+            json result = backtest_response(run, duration.count(), !want_artifacts);
+            if (want_artifacts) {
+                result["artifacts"] = write_backtest_artifacts(*artifact_store(), params, run, artifact_format, "all", precision);
+            }
+            if (want_monte_carlo) {
+                result["monte_carlo"] = monte_carlo_to_json(run_monte_carlo(*run.trades, monte_carlo, compute_pool()));
+            }
+            result["scratch_arena"] = arena.stats().to_json();
 
-                int64_t time = item[0].get<int64_t>();
-                double open = safe_get_double(item[1]);
-                double high = safe_get_double(item[2]);
-                double low = safe_get_double(item[3]);
-                double close = safe_get_double(item[4]);
-                double volume = (item.size() > 5) ? safe_get_double(item[5]) : 0.0;
+            log_info() << "Backtest completed in " << duration.count() << "ms - " 
+                 << run.trades->size() << " trades, Net Profit: " << result["summary"]["net_profit"] << arena_note(arena);
 
-                // Skip invalid candles (e.g., all zeros)
-                if (open == 0 && high == 0 && low == 0 && close == 0) {
-                    continue;
-                }
+            response.headers().add<Http::Header::ContentType>(MIME(Application, Json));
+            send_json(response, result, 2, metrics, Http::Code::Ok, encoding);
 
-                all_data.push_back({time, open, high, low, close, volume});
-            }
-            else if(item.is_object()){
-                // Same safe handling for object format
-                auto get_or_zero = [](const json& j, const char* key) {
-                    return j.contains(key) && !j[key].is_null() ? j[key].get<double>() : 0.0;
-                };
-                all_data.push_back({
-                    item.value("time", 0),
-                    get_or_zero(item, "open"),
-                    get_or_zero(item, "high"),
-                    get_or_zero(item, "low"),
-                    get_or_zero(item, "close"),
-                    get_or_zero(item, "volume")
-                });
-            }
+        } catch (const exception& e) {
+            auto end_time = chrono::steady_clock::now();
+            auto duration = chrono::duration_cast<chrono::milliseconds>(end_time - start_time);
+            
+            log_warn() << "Backtest failed after " << duration.count() << "ms: " << e.what();
+            
+            json err{{"success", false}, {"error", string("Backtest failed: ") + e.what()}};
+            response.send(Http::Code::Bad_Request, err.dump(2));
         }
-        this_thread::sleep_for(chrono::milliseconds(20));
     }
-    if(all_data.empty()) throw runtime_error("No candles returned. Check symbol/times.");
-    sort(all_data.begin(),all_data.end(),[](const Candle &a,const Candle &b){ return a.time<b.time; });
-    return all_data;
-}
 
-vector<RenkoBrick> build_renko(const vector<Candle> &candles,double brick_size,double reversal_size,const string &source){
-    vector<RenkoBrick> rows;
-    double last_price=NAN;
-    optional<int> last_dir;
-    int64_t trend_start_time=0;
-    for(auto &candle:candles){
-        double price = get_source_price(candle,source);
-        int64_t ts = candle.time;
-        double src_o=candle.open,src_h=candle.high,src_l=candle.low,src_c=candle.close;
-        if(isnan(last_price)){ last_price=price; trend_start_time=ts; continue;}
-        bool progressed=true;
-        while(progressed){
-            progressed=false;
-            if(!last_dir.has_value()){
-                double diff = price-last_price;
-                if(fabs(diff)>=brick_size){
-                    int dir = diff>0?1:-1;
-                    double new_close = last_price + dir*brick_size;
-                    rows.push_back({ts, trend_start_time, src_o,src_h,src_l,src_c,last_price,max(last_price,new_close),min(last_price,new_close),new_close,dir,false});
-                    last_price=new_close;
-                    last_dir=dir;
-                    progressed=true;
-                }
-            }else if(last_dir.value()==1){
-                if(price>=last_price+brick_size){
-                    double new_close=last_price+brick_size;
-                    rows.push_back({ts, trend_start_time, src_o,src_h,src_l,src_c,last_price,new_close,last_price,new_close,1,false});
-                    last_price=new_close; progressed=true;
-                }else if(price<=last_price-reversal_size){
-                    double new_close=last_price-reversal_size;
-                    rows.push_back({ts, ts, src_o,src_h,src_l,src_c,last_price,last_price,new_close,new_close,-1,true});
-                    last_price=new_close; last_dir=-1; trend_start_time=ts; progressed=true;
-                }
-            }else{
-                if(price<=last_price-brick_size){
-                    double new_close=last_price-brick_size;
-                    rows.push_back({ts, trend_start_time, src_o,src_h,src_l,src_c,last_price,last_price,new_close,new_close,-1,false});
-                    last_price=new_close; progressed=true;
-                }else if(price>=last_price+reversal_size){
-                    double new_close=last_price+reversal_size;
-                    rows.push_back({ts, ts, src_o,src_h,src_l,src_c,last_price,new_close,last_price,new_close,1,true});
-                    last_price=new_close; last_dir=1; trend_start_time=ts; progressed=true;
-                }
+    // Simple CSV download endpoint - returns JSON with file content
+    void handleDownloadCSV(const Rest::Request& request, Http::ResponseWriter response) {
+        string client_ip = request.address().host();
+        LogRequest log_request;
+        log_info() << "CSV DOWNLOAD REQUEST from " << client_ip;
+        ArenaScope arena;
+        RequestMetrics metrics(Endpoint::DownloadCsv);
+        InlineSlot slot(inline_busy);
+        if (!admit(slot, response)) return;
+        
+        try {
+            auto data = json::parse(request.body());
+            BacktestParams params = backtest_params_from_json(data);
+            string file_type = data.value("file_type", "all"); // renko, trades, summary, all
+            OutputFormat format = output_format_from_json(data);
+            int precision = data.value("precision", -1);
+            if (format != OutputFormat::Json) check_stream_selection(format, file_type, precision);
+            OutputFormat artifact_format = OutputFormat::Csv;
+            bool want_artifacts = artifacts_from_json(data, artifact_format);
+            if (want_artifacts && format != OutputFormat::Json) throw runtime_error("artifacts need json output");
+            ContentEncoding encoding = accepted_encoding(request);
+
+            log_info() << "Generating CSV data for " << file_type << "...";
+            BacktestRun run = run_backtest(params);
+
+            if (format != OutputFormat::Json) {
+                size_t bytes = stream_run(response, format, file_type, precision, params, run, encoding);
+                log_info() << "CSV data streamed for " << file_type << " - " << run.renko->size() << " bricks, "
+                     << run.trades->size() << " trades, " << bytes << " bytes" << encoding_note(encoding) << arena_note(arena);
+                metrics.response_bytes(bytes);
+                metrics.succeed();
+                return;
             }
-        }
-    }
-    return rows;
-}
-
-vector<double> donchian_mid(const vector<double> &series,int length){
-    size_t n = series.size();
-    vector<double> out(n,numeric_limits<double>::quiet_NaN());
-    if(length<=0) return out;
-    for(size_t i=length-1;i<n;i++){
-        double hh=series[i-length+1]; double ll=series[i-length+1];
-        for(size_t j=i-length+1;j<=i;j++){ hh=max(hh,series[j]); ll=min(ll,series[j]); }
-        out[i]=(hh+ll)/2.0;
-    }
-    return out;
-}
+            json result = download_csv_response(params, run, file_type, !want_artifacts);
+            if (want_artifacts) {
+                result["artifacts"] = write_backtest_artifacts(*artifact_store(), params, run, artifact_format, file_type, precision);
+            }
+            result["scratch_arena"] = arena.stats().to_json();
 
-vector<IchimokuRow> ichimoku_on_renko(const vector<RenkoBrick> &renko,int tenkan_len=5,int kijun_len=26,int span_b_len=52,int displacement=26){
-    size_t n = renko.size();
-    vector<IchimokuRow> rows(n);
-    vector<double> closes(n); for(size_t i=0;i<n;i++) closes[i]=renko[i].close;
-    auto tenkan_mid=donchian_mid(closes,tenkan_len);
-    auto kijun_mid=donchian_mid(closes,kijun_len);
-    auto span_b_mid=donchian_mid(closes,span_b_len);
-    for(size_t i=0;i<n;i++){
-        rows[i].brick_time=renko[i].brick_time;
-        rows[i].close=renko[i].close;
-        rows[i].tenkan=tenkan_mid[i];
-        rows[i].kijun=kijun_mid[i];
-        rows[i].span_a = isnan(tenkan_mid[i])||isnan(kijun_mid[i])?NAN:(tenkan_mid[i]+kijun_mid[i])/2.0;
-        rows[i].span_b = span_b_mid[i];
-        rows[i].chikou = i>=displacement? closes[i-displacement]:NAN;
-    }
-    return rows;
-}
+            response.headers().add<Http::Header::ContentType>(MIME(Application, Json));
+            send_json(response, result, 2, metrics, Http::Code::Ok, encoding);
 
-vector<Trade> run_strategy(const vector<IchimokuRow> &ri){
-    vector<Trade> trades;
-    bool in_long=false, in_short=false;
-    Trade current{};
-    for(size_t i=1;i<ri.size();i++){
-        double c = ri[i].close;
-        double tenkan = ri[i].tenkan;
-        double kijun = ri[i].kijun;
-        double span_a = ri[i].span_a;
-        double span_b = ri[i].span_b;
-        double cloud_top = max(span_a,span_b);
-        double cloud_bottom = min(span_a,span_b);
-        bool inside_cloud = c > cloud_bottom && c < cloud_top;
-
-        if(in_long && (c < kijun || c < cloud_top)){
-            current.exit_time = ri[i].brick_time;
-            current.exit_price = c;
-            current.profit = current.exit_price - current.entry_price;
-            trades.push_back(current);
-            in_long=false;
-        }
-        if(in_short && (c > kijun || c > cloud_bottom)){
-            current.exit_time = ri[i].brick_time;
-            current.exit_price = c;
-            current.profit = current.entry_price - current.exit_price;
-            trades.push_back(current);
-            in_short=false;
-        }
+            log_info() << "CSV data sent for " << file_type << " - " << run.renko->size() << " bricks, " << run.trades->size() << " trades" << arena_note(arena);
 
-        if(!in_long && !inside_cloud && c > kijun && c > cloud_top){
-            current = {ri[i].brick_time, c, 0, 0, "long", 0};
-            in_long=true;
-        }
-        if(!in_short && !inside_cloud && c < kijun && c < cloud_bottom){
-            current = {ri[i].brick_time, c, 0, 0, "short", 0};
-            in_short=true;
+        } catch (const exception& e) {
+            log_warn() << "CSV download failed: " << e.what();
+            json err{{"success", false}, {"error", string("CSV download failed: ") + e.what()}};
+            response.send(Http::Code::Bad_Request, err.dump(2));
         }
     }
-    if(in_long){
-        current.exit_time = ri.back().brick_time;
-        current.exit_price = ri.back().close;
-        current.profit = current.exit_price - current.entry_price;
-        trades.push_back(current);
-    }
-    if(in_short){
-        current.exit_time = ri.back().brick_time;
-        current.exit_price = ri.back().close;
-        current.profit = current.entry_price - current.exit_price;
-        trades.push_back(current);
-    }
-    return trades;
-}
 
-// -------- IN-MEMORY CSV GENERATORS (instead of file writes) --------
-string renko_to_csv_string(const vector<RenkoBrick> &rows){
-    ostringstream oss;
-    oss << "brick_time,open,high,low,close,dir,reversal\n";
-    for(auto &r:rows){
-        oss << epoch_to_ist_iso(r.brick_time) << ","
-            << r.open << ","
-            << r.high << ","
-            << r.low << ","
-            << r.close << ","
-            << r.dir << ","
-            << (r.reversal ? "true" : "false") << "\n";
-    }
-    return oss.str();
-}
+    // Multi-symbol batch - NDJSON, one record per symbol as it finishes, then the portfolio
+    void handleBatch(const Rest::Request& request, Http::ResponseWriter response) {
+        auto start_time = chrono::steady_clock::now();
+        string client_ip = request.address().host();
+        LogRequest log_request;
+        log_info() << "BATCH REQUEST RECEIVED from " << client_ip;
+        RequestMetrics metrics(Endpoint::Batch);
+        InlineSlot slot(inline_busy);
+        if (!admit(slot, response)) return;
 
-string trades_to_csv_string(const vector<Trade> &trades){
-    ostringstream oss;
-    oss << "entry_time,entry_price,exit_time,exit_price,direction,profit\n";
-    for(auto &t:trades){
-        oss << epoch_to_ist_iso(t.entry_time) << ","
-            << t.entry_price << ","
-            << epoch_to_ist_iso(t.exit_time) << ","
-            << t.exit_price << ","
-            << t.direction << ","
-            << t.profit << "\n";
-    }
-    return oss.str();
-}
+        BatchRequest req;
+        try {
+            req = batch_request_from_json(json::parse(request.body()));
+            if (req.items.size() > MAX_INLINE_BATCH_SYMBOLS) {
+                throw runtime_error("at most " + to_string(MAX_INLINE_BATCH_SYMBOLS) +
+                                    " symbols inline, submit a \"batch\" job for more");
+            }
+        } catch (const exception& e) {
+            log_warn() << "Batch rejected: " << e.what();
+            json err{{"success", false}, {"error", string("Batch failed: ") + e.what()}};
+            response.send(Http::Code::Bad_Request, err.dump(2));
+            return;
+        }
+        log_info() << "Running " << req.items.size() << " symbols, " << req.max_fetches << " downloads at a time";
+
+        ContentEncoding encoding = accepted_encoding(request);
+        response.headers().add<Http::Header::ContentType>(
+            Http::Mime::MediaType::fromString(output_content_type(OutputFormat::Ndjson)));
+        add_encoding_headers(response, encoding);
+        auto stream = response.stream(Http::Code::Ok, ChunkWriter::DEFAULT_CAPACITY);
+        Compressor compressor(encoding, [&stream](const char* data, size_t size) {
+            stream.write(data, size);
+            stream.flush();
+        });
+        // Each record goes out as soon as it is written.
+        auto send_record = [&compressor](const json& record) {
+            string line = record.dump();
+            line += '\n';
+            compressor.write(line.data(), line.size());
+            compressor.flush();
+        };
 
-string summary_to_csv_string(const vector<Trade> &trades){
-    ostringstream oss;
-    oss << "total_trades,total_profit,winning_trades,losing_trades,max_drawdown\n";
-    if(trades.empty()){
-        oss << "0,0,0,0,0\n";
-        return oss.str();
-    }
-    double total_profit=0;
-    int win=0, loss=0;
-    double max_drawdown=0, peak=0;
-    vector<double> equity_curve;
-    for(auto &t:trades){
-        total_profit += t.profit;
-        if(t.profit>0) win++; else loss++;
-        double eq = (equity_curve.empty()?0:equity_curve.back()) + t.profit;
-        equity_curve.push_back(eq);
-        if(eq>peak) peak=eq;
-        max_drawdown = max(max_drawdown, peak - eq);
+        try {
+            size_t failed = 0;
+            PortfolioSummary portfolio = run_batch(req, fetch_pool(), compute_pool(), [&](const BatchSymbolResult& r) {
+                if (!r.ok) {
+                    failed++;
+                    log_warn() << "Batch symbol " << r.symbol << " failed: " << r.error;
+                }
+                send_record(batch_symbol_to_json(r));
+            });
+            auto duration = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start_time);
+            send_record(portfolio_to_json(portfolio, duration.count()));
+            compressor.finish();
+            stream.ends();
+
+            log_info() << "Batch completed in " << duration.count() << "ms - " << portfolio.symbols << " symbols ("
+                 << failed << " failed), " << portfolio.trades << " trades, Net Profit: " << portfolio.net_profit
+                 << ", " << compressor.bytes_out() << " bytes" << encoding_note(encoding);
+            metrics.response_bytes(compressor.bytes_out());
+            metrics.succeed();
+        } catch (const exception& e) {
+            log_error() << "Batch response aborted after " << compressor.bytes_out() << " bytes: " << e.what();
+        }
     }
-    oss << trades.size() << "," << total_profit << "," << win << "," << loss << "," << max_drawdown << "\n";
-    return oss.str();
-}
-
-// ======================
-// COPY FROM strategyinc.cpp (END)
-// ======================
-
-using namespace Pistache;
 
-class BacktestHandler {
-public:
-    void handleBacktest(const Rest::Request& request, Http::ResponseWriter response) {
+    // Parameter sweep - fetches candles once and ranks every combination
+    void handleSweep(const Rest::Request& request, Http::ResponseWriter response) {
         auto start_time = chrono::steady_clock::now();
         string client_ip = request.address().host();
-        cout << " BACKTEST REQUEST RECEIVED from " << client_ip << " at " << get_current_time() << endl;
-        
+        LogRequest log_request;
+        log_info() << "SWEEP REQUEST RECEIVED from " << client_ip;
+        RequestMetrics metrics(Endpoint::Sweep);
+        InlineSlot slot(inline_busy);
+        if (!admit(slot, response)) return;
+
         try {
             auto data = json::parse(request.body());
+            SweepRequest req = sweep_request_from_json(data);
+            log_info() << "Sweeping " << sweep_combinations(req) << " combinations for " << req.symbol
+                 << " " << req.resolution;
 
-            // Log request parameters
-            cout << "Request parameters:" << endl;
-            cout << "   Symbol: " << data.value("symbol", "ETHUSDT") << endl;
-            cout << "   Resolution: " << data.value("resolution", "5m") << endl;
-            cout << "   Date range: " << data.value("start_date", "2023-08-01") << " to " 
-                 << data.value("end_date", "2023-08-02") << endl;
-
-            // Extract parameters
-            string symbol = data.value("symbol", "ETHUSDT");
-            string resolution = data.value("resolution", "5m");
-            double brick_size = data.value("brick_size", 40.0);
-            double reversal_size = data.value("reversal_size", 80.0);
-            string source_type = data.value("source_type", "ohlc4");
-            string start_date = data.value("start_date", "2023-08-01");
-            string start_time_str = data.value("start_time", "00:00:00");
-            string end_date = data.value("end_date", "2023-08-02");
-            string end_time_str = data.value("end_time", "23:59:59");
-            int tenkan = data.value("tenkan", 5);
-            int kijun = data.value("kijun", 26);
-            int span_b = data.value("span_b", 52);
-
-            auto start_ts = ist_to_unix(start_date, start_time_str);
-            auto end_ts = ist_to_unix(end_date, end_time_str);
-
-            if (start_ts >= end_ts) {
-                throw runtime_error("Start time must be before end time");
-            }
+            auto df = cached_candles(req.symbol, req.resolution, req.base_resolution, req.start_ts, req.end_ts);
+            log_info() << " Fetched " << df->size() << " candles";
 
-            cout << "Fetching candles..." << endl;
-            auto df = fetch_candles(symbol, resolution, start_ts, end_ts);
-            cout << " Fetched " << df.size() << " candles" << endl;
-
-            cout << "Building Renko bricks..." << endl;
-            auto renko = build_renko(df, brick_size, reversal_size, source_type);
-            cout << "Built " << renko.size() << " Renko bricks" << endl;
-
-            cout << "Calculating Ichimoku..." << endl;
-            auto ri = ichimoku_on_renko(renko, tenkan, kijun, span_b);
-            cout << "Calculated Ichimoku for " << ri.size() << " bricks" << endl;
-
-            cout << "Running strategy..." << endl;
-            auto trades = run_strategy(ri);
-            cout << "Strategy generated " << trades.size() << " trades" << endl;
-
-            // Generate CSVs as strings
-            string renko_csv = renko_to_csv_string(renko);
-            string trades_csv = trades_to_csv_string(trades);
-            string summary_csv = summary_to_csv_string(trades);
-
-            double net_profit = 0.0;
-            for (const auto& t : trades) net_profit += t.profit;
-            net_profit = round(net_profit * 100.0) / 100.0;
+            SweepResult sweep = run_sweep(req, *df, compute_pool());
 
             auto end_time = chrono::steady_clock::now();
             auto duration = chrono::duration_cast<chrono::milliseconds>(end_time - start_time);
 
-            // Return all CSV data in JSON response
             json result = {
                 {"success", true},
-                {"summary", {
-                    {"renko_bricks", (int)renko.size()},
-                    {"trades", (int)trades.size()},
-                    {"net_profit", net_profit},
-                    {"processing_time_ms", duration.count()}
-                }},
-                {"csv_files", {
-                    {"renko_data", {
-                        {"filename", "renko_with_ichimoku.csv"},
-                        {"content", renko_csv}
-                    }},
-                    {"trades_data", {
-                        {"filename", "trades.csv"}, 
-                        {"content", trades_csv}
-                    }},
-                    {"summary_data", {
-                        {"filename", "backtest_summary.csv"},
-                        {"content", summary_csv}
-                    }}
-                }}
+                {"symbol", req.symbol},
+                {"candles", (int)df->size()},
+                {"renko_series", sweep.renko_series},
+                {"evaluated", sweep.evaluated},
+                {"sort_by", req.sort_by},
+                {"processing_time_ms", duration.count()},
+                {"scratch_arena", sweep.memory.to_json()},
+                {"results", sweep_result_to_json(req, sweep)}
             };
 
-            cout << "Backtest completed in " << duration.count() << "ms - " 
-                 << trades.size() << " trades, Net Profit: " << net_profit << endl;
+            log_info() << "Sweep completed in " << duration.count() << "ms - " << sweep.evaluated
+                 << " combinations over " << sweep.renko_series << " Renko series, arena "
+                 << sweep.memory.allocations << " allocations / " << sweep.memory.bytes << " bytes";
 
             response.headers().add<Http::Header::ContentType>(MIME(Application, Json));
-            response.send(Http::Code::Ok, result.dump(2));
+            send_json(response, result, -1, metrics);
 
         } catch (const exception& e) {
             auto end_time = chrono::steady_clock::now();
             auto duration = chrono::duration_cast<chrono::milliseconds>(end_time - start_time);
-            
-            cout << "Backtest failed after " << duration.count() << "ms: " << e.what() << endl;
-            
-            json err{{"success", false}, {"error", string("Backtest failed: ") + e.what()}};
+
+            log_warn() << "Sweep failed after " << duration.count() << "ms: " << e.what();
+
+            json err{{"success", false}, {"error", string("Sweep failed: ") + e.what()}};
             response.send(Http::Code::Bad_Request, err.dump(2));
         }
     }
 
-    // Simple CSV download endpoint - returns JSON with file content
-    void handleDownloadCSV(const Rest::Request& request, Http::ResponseWriter response) {
-        auto start_time = chrono::steady_clock::now();
+    // Live sessions - create, then append candles and poll state
+    void handleCreateSession(const Rest::Request& request, Http::ResponseWriter response) {
         string client_ip = request.address().host();
-        cout << " CSV DOWNLOAD REQUEST from " << client_ip << " at " << get_current_time() << endl;
-        
+        LogRequest log_request;
+        log_info() << "SESSION CREATE REQUEST from " << client_ip;
+        RequestMetrics metrics(Endpoint::Session);
+
         try {
-            auto data = json::parse(request.body());
+            auto data = request.body().empty() ? json::object() : json::parse(request.body());
+            SessionConfig config = session_config_from_json(data);
+
+            // Optional warm-up history so indicators are primed from the start.
+            // Fetched before the session exists, so a failed download leaves
+            // nothing registered against the session limit.
+            vector<Candle> warm_up;
+            if (data.contains("start_date")) {
+                auto start_ts = ist_to_unix(data.value("start_date", "2023-08-01"), data.value("start_time", "00:00:00"));
+                warm_up = fetch_closed_candles(config, start_ts);
+            }
+            auto session = sessions.create(config);
+            try {
+                session->append(warm_up);
+            } catch (const exception&) {
+                sessions.remove(session->id());
+                throw;
+            }
 
-            // Extract parameters
-            string symbol = data.value("symbol", "ETHUSDT");
-            string resolution = data.value("resolution", "5m");
-            double brick_size = data.value("brick_size", 40.0);
-            double reversal_size = data.value("reversal_size", 80.0);
-            string source_type = data.value("source_type", "ohlc4");
-            string start_date = data.value("start_date", "2023-08-01");
-            string start_time_str = data.value("start_time", "00:00:00");
-            string end_date = data.value("end_date", "2023-08-02");
-            string end_time_str = data.value("end_time", "23:59:59");
-            int tenkan = data.value("tenkan", 5);
-            int kijun = data.value("kijun", 26);
-            int span_b = data.value("span_b", 52);
-            string file_type = data.value("file_type", "all"); // renko, trades, summary, all
+            log_info() << "Session " << session->id() << " created for " << config.symbol << " " << config.resolution;
+
+            json result = {{"success", true}, {"session_id", session->id()}, {"state", session->state(20)}};
+            response.headers().add<Http::Header::ContentType>(MIME(Application, Json));
+            send_json(response, result, 2, metrics, Http::Code::Created);
 
-            auto start_ts = ist_to_unix(start_date, start_time_str);
-            auto end_ts = ist_to_unix(end_date, end_time_str);
+        } catch (const exception& e) {
+            log_warn() << "Session create failed: " << e.what();
+            json err{{"success", false}, {"error", string("Session create failed: ") + e.what()}};
+            response.send(Http::Code::Bad_Request, err.dump(2));
+        }
+    }
+
+    void handleSessionCandles(const Rest::Request& request, Http::ResponseWriter response) {
+        LogRequest log_request;
+        RequestMetrics metrics(Endpoint::Session);
+        auto id = request.param(":id").as<string>();
+        auto session = sessions.get(id);
+        if (!session) {
+            json err{{"success", false}, {"error", "Unknown session: " + id}};
+            response.send(Http::Code::Not_Found, err.dump(2));
+            return;
+        }
 
-            if (start_ts >= end_ts) {
-                throw runtime_error("Start time must be before end time");
+        try {
+            auto data = request.body().empty() ? json::object() : json::parse(request.body());
+
+            // Candles in the body win; otherwise pull whatever closed since the last one.
+            vector<Candle> candles;
+            if (data.contains("candles")) {
+                candles = candles_from_json(data["candles"]);
+            } else {
+                if (session->last_candle_time() == 0)
+                    throw runtime_error("Session has no history yet; send candles or create it with start_date");
+                candles = fetch_closed_candles(session->config(), session->last_candle_time() + 1);
             }
 
-            cout << "Generating CSV data for " << file_type << "..." << endl;
-            auto df = fetch_candles(symbol, resolution, start_ts, end_ts);
-            auto renko = build_renko(df, brick_size, reversal_size, source_type);
-            auto ri = ichimoku_on_renko(renko, tenkan, kijun, span_b);
-            auto trades = run_strategy(ri);
+            auto appended = session->append(candles);
+            log_info() << "Session " << id << ": +" << appended.candles << " candles, +" << appended.bricks
+                 << " bricks, +" << appended.trades << " trades";
 
             json result = {
                 {"success", true},
-                {"symbol", symbol},
-                {"start_date", start_date},
-                {"end_date", end_date}
+                {"appended", {{"candles", appended.candles}, {"bricks", appended.bricks}, {"trades", appended.trades}}},
+                {"state", session->state(data.value("recent", 20))}
             };
+            response.headers().add<Http::Header::ContentType>(MIME(Application, Json));
+            send_json(response, result, 2, metrics);
 
-            if (file_type == "renko" || file_type == "all") {
-                result["renko_data"] = {
-                    {"filename", "renko_" + symbol + "_" + start_date + "_to_" + end_date + ".csv"},
-                    {"content", renko_to_csv_string(renko)}
-                };
-            }
+        } catch (const exception& e) {
+            log_warn() << "Session append failed: " << e.what();
+            json err{{"success", false}, {"error", string("Session append failed: ") + e.what()}};
+            response.send(Http::Code::Bad_Request, err.dump(2));
+        }
+    }
 
-            if (file_type == "trades" || file_type == "all") {
-                result["trades_data"] = {
-                    {"filename", "trades_" + symbol + "_" + start_date + "_to_" + end_date + ".csv"},
-                    {"content", trades_to_csv_string(trades)}
-                };
-            }
+    void handleSessionState(const Rest::Request& request, Http::ResponseWriter response) {
+        auto id = request.param(":id").as<string>();
+        auto session = sessions.get(id);
+        if (!session) {
+            json err{{"success", false}, {"error", "Unknown session: " + id}};
+            response.send(Http::Code::Not_Found, err.dump(2));
+            return;
+        }
+        size_t recent = 20;
+        if (auto q = request.query().get("recent")) recent = strtoul(q->c_str(), nullptr, 10);
+
+        json result = {{"success", true}, {"state", session->state(recent)}};
+        response.headers().add<Http::Header::ContentType>(MIME(Application, Json));
+        response.send(Http::Code::Ok, result.dump(2));
+    }
+
+    void handleDeleteSession(const Rest::Request& request, Http::ResponseWriter response) {
+        auto id = request.param(":id").as<string>();
+        bool removed = sessions.remove(id);
+        json result = {{"success", removed}};
+        if (!removed) result["error"] = "Unknown session: " + id;
+        response.headers().add<Http::Header::ContentType>(MIME(Application, Json));
+        response.send(removed ? Http::Code::Ok : Http::Code::Not_Found, result.dump(2));
+    }
+
+    // Background jobs - same bodies as the synchronous endpoints plus "type"
+    void handleSubmitJob(const Rest::Request& request, Http::ResponseWriter response) {
+        string client_ip = request.address().host();
+        LogRequest log_request;
+        log_info() << "JOB SUBMIT REQUEST from " << client_ip;
 
-            if (file_type == "summary" || file_type == "all") {
-                result["summary_data"] = {
-                    {"filename", "summary_" + symbol + "_" + start_date + "_to_" + end_date + ".csv"},
-                    {"content", summary_to_csv_string(trades)}
+        try {
+            auto data = json::parse(request.body());
+            string type = data.value("type", "backtest");
+            if (data.value("output", "json") != "json") {
+                throw runtime_error("Jobs only produce json output");
+            }
+            Job::Work work;
+            // Job log lines carry the submitting request's id.
+            uint64_t log_id = log_request.id();
+
+            // Parse up front so bad parameters fail the request, not the job.
+            if (type == "backtest") {
+                BacktestParams params = backtest_params_from_json(data);
+                MonteCarloParams monte_carlo;
+                bool want_monte_carlo = monte_carlo_from_json(data, monte_carlo);
+                OutputFormat artifact_format = OutputFormat::Csv;
+                bool want_artifacts = artifacts_from_json(data, artifact_format);
+                int precision = data.value("precision", -1);
+                work = [params, monte_carlo, want_monte_carlo, artifact_format, want_artifacts, precision, log_id](RunControl& control) {
+                    ArenaScope arena;
+                    LogRequest log_request(log_id);
+                    RequestMetrics metrics(Endpoint::Job);
+                    auto start_time = chrono::steady_clock::now();
+                    BacktestRun run = run_backtest(params, &control);
+                    auto duration = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start_time);
+                    json result = backtest_response(run, duration.count(), !want_artifacts);
+                    if (want_artifacts) {
+                        control.check();
+                        result["artifacts"] = write_backtest_artifacts(*artifact_store(), params, run, artifact_format, "all", precision);
+                    }
+                    if (want_monte_carlo) {
+                        control.check();
+                        control.set_progress(0.97, "monte_carlo");
+                        result["monte_carlo"] = monte_carlo_to_json(run_monte_carlo(*run.trades, monte_carlo, compute_pool()));
+                    }
+                    result["scratch_arena"] = arena.stats().to_json();
+                    metrics.succeed();
+                    return result;
+                };
+            } else if (type == "download-csv") {
+                BacktestParams params = backtest_params_from_json(data);
+                string file_type = data.value("file_type", "all");
+                OutputFormat artifact_format = OutputFormat::Csv;
+                bool want_artifacts = artifacts_from_json(data, artifact_format);
+                int precision = data.value("precision", -1);
+                work = [params, file_type, artifact_format, want_artifacts, precision, log_id](RunControl& control) {
+                    ArenaScope arena;
+                    LogRequest log_request(log_id);
+                    RequestMetrics metrics(Endpoint::Job);
+                    BacktestRun run = run_backtest(params, &control);
+                    json result = download_csv_response(params, run, file_type, !want_artifacts);
+                    if (want_artifacts) {
+                        result["artifacts"] = write_backtest_artifacts(*artifact_store(), params, run, artifact_format, file_type, precision);
+                    }
+                    result["scratch_arena"] = arena.stats().to_json();
+                    metrics.succeed();
+                    return result;
                 };
+            } else if (type == "sweep") {
+                SweepRequest req = sweep_request_from_json(data);
+                work = [req, log_id](RunControl& control) {
+                    LogRequest log_request(log_id);
+                    RequestMetrics metrics(Endpoint::Job);
+                    auto start_time = chrono::steady_clock::now();
+                    control.set_progress(0.0, "fetching");
+                    auto df = cached_candles(req.symbol, req.resolution, req.base_resolution, req.start_ts, req.end_ts, &control);
+                    control.set_progress(0.0, "sweeping");
+                    SweepResult sweep = run_sweep(req, *df, compute_pool(), &control);
+                    auto duration = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start_time);
+                    metrics.succeed();
+                    return json{
+                        {"success", true},
+                        {"symbol", req.symbol},
+                        {"candles", (int)df->size()},
+                        {"renko_series", sweep.renko_series},
+                        {"evaluated", sweep.evaluated},
+                        {"sort_by", req.sort_by},
+                        {"processing_time_ms", duration.count()},
+                        {"scratch_arena", sweep.memory.to_json()},
+                        {"results", sweep_result_to_json(req, sweep)}
+                    };
+                };
+            } else if (type == "batch") {
+                BatchRequest req = batch_request_from_json(data);
+                work = [req, log_id](RunControl& control) {
+                    LogRequest log_request(log_id);
+                    RequestMetrics metrics(Endpoint::Job);
+                    auto start_time = chrono::steady_clock::now();
+                    control.set_progress(0.0, "running");
+                    json symbols = json::array();
+                    // Throwing from on_result stops the batch, so a cancel takes effect as the next symbol finishes.
+                    PortfolioSummary portfolio = run_batch(req, fetch_pool(), compute_pool(), [&](const BatchSymbolResult& r) {
+                        control.check();
+                        if (!r.ok) log_warn() << "Batch symbol " << r.symbol << " failed: " << r.error;
+                        symbols.push_back(batch_symbol_to_json(r));
+                        control.set_progress(double(symbols.size()) / req.items.size());
+                    });
+                    auto duration = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start_time);
+                    metrics.succeed();
+                    return json{
+                        {"success", true},
+                        {"symbols", symbols},
+                        {"portfolio", portfolio_to_json(portfolio, duration.count())}
+                    };
+                };
+            } else if (type == "walk-forward") {
+                WalkForwardRequest req = walk_forward_request_from_json(data);
+                work = [req, log_id](RunControl& control) {
+                    LogRequest log_request(log_id);
+                    RequestMetrics metrics(Endpoint::Job);
+                    auto start_time = chrono::steady_clock::now();
+                    const SweepRequest& sweep = req.sweep;
+                    control.set_progress(0.0, "fetching");
+                    auto df = cached_candles(sweep.symbol, sweep.resolution, sweep.base_resolution, sweep.start_ts, sweep.end_ts, &control);
+                    WalkForwardResult wf = run_walk_forward(req, *df, compute_pool(), &control);
+                    auto duration = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start_time);
+                    metrics.succeed();
+                    json result = walk_forward_result_to_json(req, wf);
+                    result["success"] = true;
+                    result["symbol"] = sweep.symbol;
+                    result["candles"] = (int)df->size();
+                    result["renko_series"] = wf.renko_series;
+                    result["evaluated"] = wf.evaluated;
+                    result["sort_by"] = sweep.sort_by;
+                    result["anchored"] = req.anchored;
+                    result["processing_time_ms"] = duration.count();
+                    result["scratch_arena"] = wf.memory.to_json();
+                    return result;
+                };
+            } else {
+                throw runtime_error("Unsupported job type: " + type);
             }
 
+            auto job = jobs.submit(type, move(work));
             response.headers().add<Http::Header::ContentType>(MIME(Application, Json));
-            response.send(Http::Code::Ok, result.dump(2));
-
-            cout << "CSV data sent for " << file_type << " - " << renko.size() << " bricks, " << trades.size() << " trades" << endl;
+            if (!job) {
+                log_warn() << "Job rejected: queue full (" << jobs.capacity() << ")";
+                json err{{"success", false}, {"error", "Job queue is full, retry later"}};
+                response.send(Http::Code::Too_Many_Requests, err.dump(2));
+                return;
+            }
+            log_info() << "Job " << job->id() << " queued (" << type << ")";
+            json result = job->describe();
+            result["success"] = true;
+            response.send(Http::Code::Accepted, result.dump(2));
 
         } catch (const exception& e) {
-            cout << "CSV download failed: " << e.what() << endl;
-            json err{{"success", false}, {"error", string("CSV download failed: ") + e.what()}};
+            log_warn() << "Job submit failed: " << e.what();
+            json err{{"success", false}, {"error", string("Job submit failed: ") + e.what()}};
             response.send(Http::Code::Bad_Request, err.dump(2));
         }
     }
 
+    void handleJobStatus(const Rest::Request& request, Http::ResponseWriter response) {
+        auto id = request.param(":id").as<string>();
+        auto job = jobs.get(id);
+        response.headers().add<Http::Header::ContentType>(MIME(Application, Json));
+        if (!job) {
+            json err{{"success", false}, {"error", "Unknown job: " + id}};
+            response.send(Http::Code::Not_Found, err.dump(2));
+            return;
+        }
+        json result = job->describe();
+        result["success"] = true;
+        response.send(Http::Code::Ok, result.dump(2));
+    }
+
+    // 202 while the job is still pending, 409 if it ended without a result
+    void handleJobResult(const Rest::Request& request, Http::ResponseWriter response) {
+        auto id = request.param(":id").as<string>();
+        auto job = jobs.get(id);
+        response.headers().add<Http::Header::ContentType>(MIME(Application, Json));
+        if (!job) {
+            json err{{"success", false}, {"error", "Unknown job: " + id}};
+            response.send(Http::Code::Not_Found, err.dump(2));
+            return;
+        }
+        JobStatus status = job->status();
+        if (status == JobStatus::Succeeded) {
+            response.send(Http::Code::Ok, job->result().dump(2));
+        } else if (!job->finished()) {
+            json result = job->describe();
+            result["success"] = true;
+            response.send(Http::Code::Accepted, result.dump(2));
+        } else {
+            json result = job->describe();
+            result["success"] = false;
+            if (!result.contains("error")) result["error"] = string("Job ") + job_status_name(status);
+            response.send(Http::Code::Conflict, result.dump(2));
+        }
+    }
+
+    void handleCancelJob(const Rest::Request& request, Http::ResponseWriter response) {
+        auto id = request.param(":id").as<string>();
+        auto job = jobs.get(id);
+        response.headers().add<Http::Header::ContentType>(MIME(Application, Json));
+        if (!job || !jobs.cancel(id)) {
+            json err{{"success", false}, {"error", "Unknown job: " + id}};
+            response.send(Http::Code::Not_Found, err.dump(2));
+            return;
+        }
+        log_info() << "Job " << id << " cancel requested";
+        json result = job->describe();
+        result["success"] = true;
+        response.send(Http::Code::Ok, result.dump(2));
+    }
+
+    // Stored exports. A whole file goes out with sendfile; a single byte range
+    // is read from disk a buffer at a time. The id is a hash of the content,
+    // so it doubles as the ETag and an If-Range check always passes.
+    void handleArtifact(const Rest::Request& request, Http::ResponseWriter response) {
+        RequestMetrics metrics(Endpoint::Artifact);
+        auto id = request.param(":id").as<string>();
+        ArtifactStore* store = artifact_store();
+        string path = store ? store->path(id) : "";
+        int fd = path.empty() ? -1 : open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            if (fd >= 0) close(fd);
+            json err{{"success", false}, {"error", "Unknown artifact: " + id}};
+            response.headers().add<Http::Header::ContentType>(MIME(Application, Json));
+            response.send(Http::Code::Not_Found, err.dump(2));
+            return;
+        }
+        uint64_t size = static_cast<uint64_t>(st.st_size);
+        ByteRange range = parse_byte_range(header_value(request, "Range"), size);
+
+        response.headers().addRaw(Http::Header::Raw("Accept-Ranges", "bytes"));
+        response.headers().addRaw(Http::Header::Raw("ETag", "\"" + id + "\""));
+        if (range.kind == ByteRange::Unsatisfiable) {
+            close(fd);
+            response.headers().addRaw(Http::Header::Raw("Content-Range", "bytes */" + to_string(size)));
+            response.send(Http::Code::Range_Not_Satisfiable);
+            return;
+        }
+        auto content_type = Http::Mime::MediaType::fromString(output_content_type(artifact_format(id)));
+        response.headers().addRaw(Http::Header::Raw("Content-Disposition", "attachment; filename=\"" + id + "\""));
+
+        if (range.kind == ByteRange::Full) {
+            // serveFile opens the file again; ours only kept the size honest.
+            close(fd);
+            try {
+                Http::serveFile(response, path, content_type);
+            } catch (const exception& e) {
+                log_warn() << "Artifact " << id << " could not be served: " << e.what();
+                return;
+            }
+            metrics.response_bytes(size);
+            metrics.succeed();
+            return;
+        }
+
+        response.headers().add<Http::Header::ContentType>(content_type);
+        response.headers().addRaw(Http::Header::Raw("Content-Range",
+            "bytes " + to_string(range.first) + "-" + to_string(range.last) + "/" + to_string(size)));
+        auto stream = response.stream(Http::Code::Partial_Content, ChunkWriter::DEFAULT_CAPACITY);
+        vector<char> buf(ChunkWriter::DEFAULT_CAPACITY);
+        uint64_t pos = range.first, end = range.last + 1;
+        while (pos < end) {
+            ssize_t n = pread(fd, buf.data(), static_cast<size_t>(min<uint64_t>(buf.size(), end - pos)),
+                              static_cast<off_t>(pos));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            stream.write(buf.data(), static_cast<size_t>(n));
+            stream.flush();
+            pos += static_cast<uint64_t>(n);
+        }
+        close(fd);
+        stream.ends();
+        if (pos < end) {
+            log_error() << "Artifact " << id << " range cut short at byte " << pos << " of " << end;
+            return;
+        }
+        metrics.response_bytes(end - range.first);
+        metrics.succeed();
+    }
+
+    // Cache and job queue counters
+    void handleStats(const Rest::Request&, Http::ResponseWriter response) {
+        FetchStats fetch = fetch_stats();
+        json result = {
+            {"success", true},
+            {"cache", result_cache().stats()},
+            {"fetch", {{"windows_downloaded", fetch.windows_downloaded}, {"windows_shared", fetch.windows_shared}}},
+            {"jobs", {{"queued", jobs.queued()}, {"queue_capacity", jobs.capacity()}, {"threads", jobs.threads()}}}
+        };
+        response.headers().add<Http::Header::ContentType>(MIME(Application, Json));
+        response.send(Http::Code::Ok, result.dump(2));
+    }
+
+    // Prometheus text exposition of request and pipeline stage metrics.
+    void handleMetrics(const Rest::Request&, Http::ResponseWriter response) {
+        response.headers().add<Http::Header::ContentType>(MIME(Text, Plain));
+        response.send(Http::Code::Ok, metrics_prometheus_text());
+    }
+
 private:
-    string get_current_time() {
-        auto now = chrono::system_clock::now();
-        auto in_time_t = chrono::system_clock::to_time_t(now);
-        
-        char buf[100];
-        tm tm_buf;
-        localtime_r(&in_time_t, &tm_buf);
-        strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm_buf);
-        return string(buf);
+    SessionManager sessions;
+    JobManager jobs;
+
+    // The synchronous compute routes run on the HTTP thread that accepted
+    // them. At most inline_limit run at once, so the remaining threads stay
+    // free for health checks, job polling and the cheap routes.
+    size_t inline_limit;
+    atomic<size_t> inline_busy{0};
+
+    class InlineSlot {
+    public:
+        explicit InlineSlot(atomic<size_t>& busy) : busy_(busy), running_(++busy_) {}
+        ~InlineSlot() { busy_--; }
+        InlineSlot(const InlineSlot&) = delete;
+        InlineSlot& operator=(const InlineSlot&) = delete;
+        size_t running() const { return running_; }
+    private:
+        atomic<size_t>& busy_;
+        size_t running_;   // including this one
+    };
+
+    // Answers 503 when the slot is over the limit.
+    bool admit(const InlineSlot& slot, Http::ResponseWriter& response) {
+        if (slot.running() <= inline_limit) return true;
+        log_warn() << "Rejected: " << inline_limit << " inline requests already running";
+        json err{{"success", false}, {"error", "Server busy, retry later or submit a job to /backtest/jobs"}};
+        response.headers().add<Http::Header::ContentType>(MIME(Application, Json));
+        response.send(Http::Code::Service_Unavailable, err.dump(2));
+        return false;
+    }
+
+    // Sends the run as chunked CSV, NDJSON or columnar from a fixed-size
+    // buffer. Once the status line is out, failures can only be logged.
+    // Returns the bytes sent on the wire, after compression.
+    static size_t stream_run(Http::ResponseWriter& response, OutputFormat format, const string& file_type,
+                             int precision, const BacktestParams& params, const BacktestRun& run,
+                             ContentEncoding encoding) {
+        response.headers().add<Http::Header::ContentType>(
+            Http::Mime::MediaType::fromString(output_content_type(format)));
+        response.headers().addRaw(Http::Header::Raw("Content-Disposition",
+            "attachment; filename=\"" + stream_filename(params, format, file_type) + "\""));
+        add_encoding_headers(response, encoding);
+
+        auto stream = response.stream(Http::Code::Ok, ChunkWriter::DEFAULT_CAPACITY);
+        Compressor compressor(encoding, [&stream](const char* data, size_t size) {
+            stream.write(data, size);
+            stream.flush();
+        });
+        ChunkWriter out([&compressor](const char* data, size_t size) { compressor.write(data, size); });
+        try {
+            write_backtest_stream(out, format, file_type, run, precision);
+            compressor.finish();
+            stream.ends();
+        } catch (const exception& e) {
+            log_error() << "Streaming response aborted after " << compressor.bytes_out() << " bytes: " << e.what();
+        }
+        return compressor.bytes_out();
+    }
+
+    // Candles from start_ts up to the last one that has closed.
+    static vector<Candle> fetch_closed_candles(const SessionConfig& config, int64_t start_ts) {
+        int64_t end_ts = static_cast<int64_t>(time(nullptr)) - resolution_seconds(config.resolution);
+        if (start_ts > end_ts) return {};
+        return fetch_remote_candles(config.symbol, config.resolution, start_ts, end_ts);
+    }
+
+    // Dumps (and compresses) under the serialize stage timer and records the body size.
+    static void send_json(Http::ResponseWriter& response, const json& result, int indent, RequestMetrics& metrics,
+                          Http::Code code = Http::Code::Ok, ContentEncoding encoding = ContentEncoding::Identity) {
+        string body;
+        {
+            StageTimer timer(PipelineStage::Serialize);
+            body = result.dump(indent);
+            if (body.size() < MIN_COMPRESS_BYTES) encoding = ContentEncoding::Identity;
+            if (encoding != ContentEncoding::Identity) body = compress_body(encoding, body);
+        }
+        add_encoding_headers(response, encoding);
+        metrics.response_bytes(body.size());
+        metrics.succeed();
+        response.send(code, body);
+    }
+
+    // Negotiated from Accept-Encoding.
+    static ContentEncoding accepted_encoding(const Rest::Request& request) {
+        string value = header_value(request, "Accept-Encoding");
+        return value.empty() ? ContentEncoding::Identity : negotiate_encoding(value);
+    }
+
+    // A request header's value, "" when absent. Pistache may have parsed the
+    // header into a typed one, in which case it is not among the raw headers.
+    static string header_value(const Rest::Request& request, const string& name) {
+        auto headers = request.headers();
+        if (auto raw = headers.tryGetRaw(name)) return raw->value();
+        for (const auto& header : headers.list()) {
+            if (header->name() == name) {
+                ostringstream value;
+                header->write(value);
+                return value.str();
+            }
+        }
+        return "";
+    }
+
+    static void add_encoding_headers(Http::ResponseWriter& response, ContentEncoding encoding) {
+        if (encoding == ContentEncoding::Identity) return;
+        response.headers().addRaw(Http::Header::Raw("Content-Encoding", content_encoding_name(encoding)));
+        response.headers().addRaw(Http::Header::Raw("Vary", "Accept-Encoding"));
+    }
+
+    static string encoding_note(ContentEncoding encoding) {
+        return encoding == ContentEncoding::Identity ? "" : string(" ") + content_encoding_name(encoding);
+    }
+
+    // ", arena N allocations / B bytes" for the request log lines.
+    static string arena_note(const ArenaScope& arena) {
+        return ", arena " + to_string(arena.stats().allocations) + " allocations / " +
+               to_string(arena.stats().bytes) + " bytes";
     }
 };
 
-int main() {
-    cout << "Initializing Backtest API Server (CSV Download Edition)..." << endl;
+// Startup setting: "--name value" on the command line, else the environment, else the default.
+static size_t startup_setting(int argc, char* argv[], const string& flag, const char* env, size_t fallback) {
+    const char* value = nullptr;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (flag == argv[i]) value = argv[i + 1];
+    }
+    if (!value) value = getenv(env);
+    if (!value || !*value) return fallback;
+    try {
+        long long n = stoll(value);
+        if (n > 0) return static_cast<size_t>(n);
+    } catch (const exception&) {}
+    log_warn() << "Ignoring invalid " << flag << " value: " << value;
+    return fallback;
+}
+
+static string startup_text(int argc, char* argv[], const string& flag, const char* env, const string& fallback) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (flag == argv[i]) return argv[i + 1];
+    }
+    const char* value = getenv(env);
+    return value && *value ? value : fallback;
+}
+
+int main(int argc, char* argv[]) {
+    log_info() << "Initializing Backtest API Server (CSV Download Edition)...";
 
     curl_global_init(CURL_GLOBAL_DEFAULT);
-    cout << "cURL initialized" << endl;
+    log_info() << "cURL initialized";
+
+    const size_t hardware = max(1u, thread::hardware_concurrency());
+    const int PORT = static_cast<int>(startup_setting(argc, argv, "--port", "BACKTEST_PORT", 9080));
+    const size_t http_threads = startup_setting(argc, argv, "--threads", "BACKTEST_HTTP_THREADS", 4);
+    const size_t job_threads = startup_setting(argc, argv, "--job-threads", "BACKTEST_JOB_THREADS", 2);
+    const size_t job_queue = startup_setting(argc, argv, "--job-queue", "BACKTEST_JOB_QUEUE", 64);
+    const size_t max_sessions = startup_setting(argc, argv, "--max-sessions", "BACKTEST_MAX_SESSIONS", 256);
+    const size_t session_ttl = startup_setting(argc, argv, "--session-ttl", "BACKTEST_SESSION_TTL", 3600);
+    const size_t compute_threads = startup_setting(argc, argv, "--compute-threads", "BACKTEST_COMPUTE_THREADS", hardware);
+    // One HTTP thread is kept back from inline compute by default.
+    const size_t inline_limit = startup_setting(argc, argv, "--inline-requests", "BACKTEST_INLINE_REQUESTS",
+                                                max<size_t>(1, http_threads - 1));
+    set_compute_pool_threads(compute_threads);
+    set_fetch_pool_threads(startup_setting(argc, argv, "--fetch-threads", "BACKTEST_FETCH_THREADS", 8));
+    FetchOptions fetch = fetch_options();
+    fetch.base_url = startup_text(argc, argv, "--candle-api", "CANDLE_API_BASE_URL", fetch.base_url);
+    set_fetch_options(fetch);
+    const string artifact_dir = startup_text(argc, argv, "--artifact-dir", "BACKTEST_ARTIFACT_DIR", "artifacts");
+    const size_t artifact_ttl = startup_setting(argc, argv, "--artifact-ttl", "BACKTEST_ARTIFACT_TTL", 24 * 3600);
+    open_artifact_store(artifact_dir, chrono::seconds(artifact_ttl));
 
-    const int PORT = 9080;
     Address addr(Ipv4::any(), Port(PORT));
-    auto opts = Http::Endpoint::options().threads(4);
+    auto opts = Http::Endpoint::options().threads(static_cast<int>(http_threads));
     Http::Endpoint server(addr);
     server.init(opts);
 
@@ -596,7 +887,7 @@ int main() {
         });
 
     // Backtest handler
-    BacktestHandler handler;
+    BacktestHandler handler(job_threads, job_queue, inline_limit, max_sessions, chrono::seconds(session_ttl));
     
     // Regular backtest (returns JSON with CSV data as strings)
     router.post("/backtest", Rest::Routes::bind(&BacktestHandler::handleBacktest, &handler));
@@ -604,21 +895,68 @@ int main() {
     // CSV download endpoint (returns JSON with CSV content)
     router.post("/backtest/download-csv", Rest::Routes::bind(&BacktestHandler::handleDownloadCSV, &handler));
 
+    // Multi-symbol batch (NDJSON per symbol as each finishes, then the portfolio)
+    router.post("/backtest/batch", Rest::Routes::bind(&BacktestHandler::handleBatch, &handler));
+
+    // Parameter sweep (returns a ranked table of summary metrics)
+    router.post("/backtest/sweep", Rest::Routes::bind(&BacktestHandler::handleSweep, &handler));
+
+    // Live sessions (incremental Renko/Ichimoku/strategy state)
+    router.post("/backtest/sessions", Rest::Routes::bind(&BacktestHandler::handleCreateSession, &handler));
+    router.post("/backtest/sessions/:id/candles", Rest::Routes::bind(&BacktestHandler::handleSessionCandles, &handler));
+    router.get("/backtest/sessions/:id/state", Rest::Routes::bind(&BacktestHandler::handleSessionState, &handler));
+    router.del("/backtest/sessions/:id", Rest::Routes::bind(&BacktestHandler::handleDeleteSession, &handler));
+
+    // Background jobs (queued, run off the HTTP threads)
+    router.post("/backtest/jobs", Rest::Routes::bind(&BacktestHandler::handleSubmitJob, &handler));
+    router.get("/backtest/jobs/:id", Rest::Routes::bind(&BacktestHandler::handleJobStatus, &handler));
+    router.get("/backtest/jobs/:id/result", Rest::Routes::bind(&BacktestHandler::handleJobResult, &handler));
+    router.del("/backtest/jobs/:id", Rest::Routes::bind(&BacktestHandler::handleCancelJob, &handler));
+
+    // Stored exports (written when a request asks for "artifacts")
+    router.get("/backtest/artifacts/:id", Rest::Routes::bind(&BacktestHandler::handleArtifact, &handler));
+
+    // Cache and queue counters
+    router.get("/backtest/stats", Rest::Routes::bind(&BacktestHandler::handleStats, &handler));
+    router.get("/backtest/metrics", Rest::Routes::bind(&BacktestHandler::handleMetrics, &handler));
+
     server.setHandler(router.handler());
 
-    cout << "==================================================" << endl;
-    cout << "BACKTEST API SERVER STARTED!" << endl;
-    cout << "Endpoints:" << endl;
-    cout << "  POST /backtest              - Run backtest, returns JSON with CSV data" << endl;
-    cout << "  POST /backtest/download-csv  - Get CSV data as JSON (specify file_type)" << endl;
-    cout << "  GET  /backtest/health       - Health check" << endl;
-    cout << "==================================================" << endl;
-    cout << "Server running on port " << PORT << endl;
-    cout << "Ready to accept requests..." << endl;
+    log_info() << "==================================================";
+    log_info() << "BACKTEST API SERVER STARTED!";
+    log_info() << "Endpoints:";
+    log_info() << "  POST /backtest              - Run backtest, returns JSON with CSV data (or output csv/ndjson)";
+    log_info() << "  POST /backtest/download-csv  - Get CSV data as JSON (specify file_type, output csv/ndjson streams)";
+    log_info() << "  POST /backtest/batch        - Many symbols at once, streams per-symbol NDJSON and the portfolio";
+    log_info() << "  POST /backtest/sweep        - Grid search, returns ranked summary table";
+    log_info() << "  POST /backtest/sessions     - Create a live session (optional start_date warm-up)";
+    log_info() << "  POST /backtest/sessions/:id/candles - Append candles (or fetch new closed ones)";
+    log_info() << "  GET  /backtest/sessions/:id/state   - Current Renko/Ichimoku/position state";
+    log_info() << "  DELETE /backtest/sessions/:id       - Drop a session";
+    log_info() << "  POST /backtest/jobs         - Queue a backtest/download-csv/sweep/walk-forward job (429 when full)";
+    log_info() << "  GET  /backtest/jobs/:id     - Job status and progress";
+    log_info() << "  GET  /backtest/jobs/:id/result      - Job result once it has succeeded";
+    log_info() << "  DELETE /backtest/jobs/:id   - Cancel a job";
+    log_info() << "  GET  /backtest/artifacts/:id - Stored export file (Range requests supported)";
+    log_info() << "  GET  /backtest/stats        - Cache, shared-download and job queue counters";
+    log_info() << "  GET  /backtest/metrics      - Request and pipeline stage metrics (Prometheus text)";
+    log_info() << "  GET  /backtest/health       - Health check";
+    log_info() << "==================================================";
+    log_info() << "Server running on port " << PORT << " (" << http_threads << " HTTP threads, "
+         << inline_limit << " inline, " << job_threads << " job threads, queue " << job_queue << ", "
+         << compute_threads << " compute threads)";
+    log_info() << "Candles from " << fetch.base_url;
+    if (ArtifactStore* store = artifact_store()) {
+        log_info() << "Artifacts in " << store->dir() << ", kept " << store->ttl().count() << "s";
+    } else {
+        log_info() << "Artifacts disabled";
+    }
+    log_info() << "Ready to accept requests...";
 
     server.serve();
 
-    cout << "Server shutting down..." << endl;
+    log_info() << "Server shutting down...";
+    log_flush();
     curl_global_cleanup();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,436 @@
+#include "market_data.h"
+#include "candle_store.h"
+#include "candle_decoder.h"
+#include "metrics.h"
+#include "resample.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <curl/curl.h>
+
+using namespace std;
+
+using Window = pair<int64_t,int64_t>;
+
+static size_t write_callback(void* contents, size_t size, size_t nmemb, string* s){
+    size_t total = size*nmemb;
+    s->append((char*)contents,total);
+    return total;
+}
+
+// -------- OPTIONS --------
+static mutex options_mu;
+
+static FetchOptions& options_locked(){
+    static FetchOptions opts = []{
+        FetchOptions o;
+        if(const char *v = getenv("CANDLE_API_BASE_URL")) o.base_url = v;
+        if(const char *v = getenv("CANDLE_FETCH_CONCURRENCY")) o.max_in_flight = o.max_connections = max(1,atoi(v));
+        if(const char *v = getenv("CANDLE_FETCH_RPS")) o.requests_per_second = atof(v);
+        return o;
+    }();
+    return opts;
+}
+
+FetchOptions fetch_options(){
+    lock_guard<mutex> lk(options_mu);
+    return options_locked();
+}
+
+void set_fetch_options(const FetchOptions &opts){
+    lock_guard<mutex> lk(options_mu);
+    options_locked() = opts;
+}
+
+// -------- RATE LIMITING --------
+// One bucket for the whole process: the exchange rate-limits per client, not
+// per request, so concurrent backtests have to share the budget.
+class TokenBucket {
+public:
+    // Takes a token if one is available; otherwise returns how long to wait.
+    chrono::milliseconds try_acquire(double rate, int burst){
+        lock_guard<mutex> lk(mu_);
+        auto now = chrono::steady_clock::now();
+        if(rate<=0) return chrono::milliseconds(0);
+        if(!started_){ tokens_ = burst; last_ = now; started_ = true; }
+        tokens_ = min<double>(burst, tokens_ + chrono::duration<double>(now-last_).count()*rate);
+        last_ = now;
+        if(tokens_>=1){ tokens_ -= 1; return chrono::milliseconds(0); }
+        return chrono::milliseconds(static_cast<int64_t>((1-tokens_)/rate*1000)+1);
+    }
+private:
+    mutex mu_;
+    double tokens_ = 0;
+    bool started_ = false;
+    chrono::steady_clock::time_point last_;
+};
+
+static TokenBucket request_bucket;
+
+// -------- CONNECTION POOL --------
+// A multi handle owns a connection cache, so parking it between fetches
+// keeps the TLS sessions to the exchange alive for the next request.
+struct FetchSession {
+    CURLM *multi = nullptr;
+    vector<CURL*> idle;
+    curl_slist *headers = nullptr;
+
+    FetchSession(){
+        multi = curl_multi_init();
+        headers = curl_slist_append(headers,"accept: application/json");
+        headers = curl_slist_append(headers,"User-Agent: cpp-client/1.0");
+    }
+    ~FetchSession(){
+        for(CURL *e:idle) curl_easy_cleanup(e);
+        curl_multi_cleanup(multi);
+        curl_slist_free_all(headers);
+    }
+    CURL* checkout(){
+        if(idle.empty()) return curl_easy_init();
+        CURL *e = idle.back(); idle.pop_back();
+        return e;
+    }
+};
+
+class SessionPool {
+public:
+    unique_ptr<FetchSession> acquire(){
+        lock_guard<mutex> lk(mu_);
+        if(free_.empty()) return make_unique<FetchSession>();
+        auto s = move(free_.back()); free_.pop_back();
+        return s;
+    }
+    void release(unique_ptr<FetchSession> s){
+        lock_guard<mutex> lk(mu_);
+        if(free_.size()<MAX_IDLE) free_.push_back(move(s));
+    }
+private:
+    static constexpr size_t MAX_IDLE = 8;
+    mutex mu_;
+    vector<unique_ptr<FetchSession>> free_;
+};
+
+static SessionPool session_pool;
+
+// -------- DOWNLOAD --------
+// Downloads every window through one pooled multi handle, keeping up to
+// max_in_flight transfers running. Result i holds window i, sorted by time.
+static vector<vector<Candle>> fetch_windows(const string &symbol,const string &resolution,
+                                            const vector<Window> &windows,int limit,RunControl *control){
+    vector<vector<Candle>> results(windows.size());
+    if(windows.empty()) return results;
+
+    FetchOptions opts = fetch_options();
+    auto session = session_pool.acquire();
+    CURLM *multi = session->multi;
+    curl_multi_setopt(multi,CURLMOPT_MAX_HOST_CONNECTIONS,static_cast<long>(opts.max_connections));
+    curl_multi_setopt(multi,CURLMOPT_MAXCONNECTS,static_cast<long>(opts.max_connections));
+    curl_multi_setopt(multi,CURLMOPT_PIPELINING,CURLPIPE_MULTIPLEX);
+
+    struct Transfer {
+        size_t window;
+        string url, body;
+    };
+    vector<unique_ptr<Transfer>> transfers(windows.size());
+    vector<CURL*> active;
+
+    auto finish = [&](CURL *easy){
+        curl_multi_remove_handle(multi,easy);
+        active.erase(find(active.begin(),active.end(),easy));
+        curl_easy_reset(easy);
+        session->idle.push_back(easy);
+    };
+    auto abort_all = [&](){
+        while(!active.empty()) finish(active.back());
+    };
+
+    size_t next = 0, done = 0;
+    int in_flight_cap = max(1,opts.max_in_flight);
+    try {
+        while(done<windows.size()){
+            if(control) control->check();
+            long wait_ms = 100;
+            while(static_cast<int>(active.size())<in_flight_cap && next<windows.size()){
+                auto wait = request_bucket.try_acquire(opts.requests_per_second,max(1,opts.burst));
+                if(wait.count()>0){ wait_ms = min<long>(wait_ms,wait.count()); break; }
+                auto t = make_unique<Transfer>();
+                t->window = next;
+                t->url = opts.base_url+"/v2/history/candles?symbol="+symbol+"&resolution="+resolution+
+                         "&start="+to_string(windows[next].first)+"&end="+to_string(windows[next].second)+
+                         "&limit="+to_string(limit);
+                CURL *easy = session->checkout();
+                if(!easy) throw runtime_error("curl error: cannot create handle");
+                curl_easy_setopt(easy,CURLOPT_URL,t->url.c_str());
+                curl_easy_setopt(easy,CURLOPT_WRITEFUNCTION,write_callback);
+                curl_easy_setopt(easy,CURLOPT_WRITEDATA,&t->body);
+                curl_easy_setopt(easy,CURLOPT_TIMEOUT,opts.timeout_seconds);
+                curl_easy_setopt(easy,CURLOPT_HTTPHEADER,session->headers);
+                curl_easy_setopt(easy,CURLOPT_TCP_KEEPALIVE,1L);
+                curl_easy_setopt(easy,CURLOPT_PIPEWAIT,1L);
+                curl_easy_setopt(easy,CURLOPT_PRIVATE,t.get());
+                curl_multi_add_handle(multi,easy);
+                active.push_back(easy);
+                transfers[next] = move(t);
+                next++;
+            }
+
+            int running = 0;
+            CURLMcode mc = curl_multi_perform(multi,&running);
+            if(mc!=CURLM_OK) throw runtime_error(string("curl multi error: ")+curl_multi_strerror(mc));
+
+            int queued = 0;
+            while(CURLMsg *msg = curl_multi_info_read(multi,&queued)){
+                if(msg->msg!=CURLMSG_DONE) continue;
+                CURL *easy = msg->easy_handle;
+                CURLcode res = msg->data.result;
+                Transfer *t = nullptr;
+                long status = 0;
+                curl_easy_getinfo(easy,CURLINFO_PRIVATE,&t);
+                curl_easy_getinfo(easy,CURLINFO_RESPONSE_CODE,&status);
+                finish(easy);
+                if(res!=CURLE_OK) throw runtime_error(string("curl error: ")+curl_easy_strerror(res));
+                if(status>=400) throw runtime_error("Exchange returned HTTP "+to_string(status));
+
+                record_fetched_bytes(t->body.size());
+                auto &out = results[t->window];
+                out.reserve(limit);
+                decode_candles(t->body,out);
+                if(!is_sorted(out.begin(),out.end(),[](const Candle &a,const Candle &b){ return a.time<b.time; }))
+                    sort(out.begin(),out.end(),[](const Candle &a,const Candle &b){ return a.time<b.time; });
+                transfers[t->window].reset();
+                done++;
+                if(control) control->set_progress(0.7*done/windows.size());
+            }
+            if(done<windows.size())
+                curl_multi_poll(multi,nullptr,0,static_cast<int>(running>0 ? wait_ms : min<long>(wait_ms,10)),nullptr);
+        }
+    } catch(...) {
+        abort_all();
+        session_pool.release(move(session));
+        throw;
+    }
+    session_pool.release(move(session));
+    return results;
+}
+
+// -------- SINGLE-FLIGHT --------
+// Windows lie on a fixed grid of `limit` candles counted from the epoch, so
+// overlapping requests ask for identical windows. Only the last one is cut
+// short, at `end_time`.
+static vector<Window> grid_windows(int64_t start_time,int64_t end_time,int limit,int sec_per_candle){
+    int64_t span = static_cast<int64_t>(limit)*sec_per_candle;
+    int64_t cell = start_time/span*span;
+    if(cell>start_time) cell -= span;
+    vector<Window> windows;
+    for(;cell<=end_time;cell+=span) windows.emplace_back(cell,min(end_time,cell+span-1));
+    return windows;
+}
+
+using CandleBuffer = shared_ptr<const vector<Candle>>;
+
+// Downloads in progress, by window. A request that needs a window another
+// request is already downloading waits for that transfer and shares its
+// buffer instead of hitting the exchange again.
+static mutex inflight_mu;
+static unordered_map<string,shared_future<CandleBuffer>> inflight;
+static atomic<uint64_t> windows_downloaded{0}, windows_shared{0};
+
+FetchStats fetch_stats(){
+    return {windows_downloaded.load(), windows_shared.load()};
+}
+
+static vector<CandleBuffer> fetch_shared(const string &symbol,const string &resolution,
+                                         const vector<Window> &windows,int limit,RunControl *control){
+    vector<CandleBuffer> out(windows.size());
+    vector<string> owned_keys;
+    vector<size_t> owned;
+    vector<Window> owned_windows;
+    vector<promise<CandleBuffer>> promises;
+    vector<pair<size_t,shared_future<CandleBuffer>>> waits;
+    {
+        lock_guard<mutex> lk(inflight_mu);
+        for(size_t i=0;i<windows.size();i++){
+            string key = symbol+"|"+resolution+"|"+to_string(windows[i].first)+"|"+to_string(windows[i].second)+"|"+to_string(limit);
+            auto it = inflight.find(key);
+            if(it!=inflight.end()){
+                waits.emplace_back(i,it->second);
+                continue;
+            }
+            promises.emplace_back();
+            inflight.emplace(key,promises.back().get_future().share());
+            owned_keys.push_back(move(key));
+            owned.push_back(i);
+            owned_windows.push_back(windows[i]);
+        }
+    }
+    auto release = [&]{
+        lock_guard<mutex> lk(inflight_mu);
+        for(auto &k:owned_keys) inflight.erase(k);
+    };
+
+    try {
+        auto parts = fetch_windows(symbol,resolution,owned_windows,limit,control);
+        for(size_t j=0;j<owned.size();j++){
+            out[owned[j]] = make_shared<const vector<Candle>>(move(parts[j]));
+            promises[j].set_value(out[owned[j]]);
+        }
+    } catch(...) {
+        for(size_t j=0;j<owned.size();j++){
+            if(!out[owned[j]]) promises[j].set_exception(current_exception());
+        }
+        release();
+        throw;
+    }
+    release();
+    windows_downloaded += owned.size();
+    windows_shared += waits.size();
+
+    for(auto &w:waits){
+        while(w.second.wait_for(chrono::milliseconds(50))!=future_status::ready){
+            if(control) control->check();
+        }
+        try {
+            out[w.first] = w.second.get();
+        } catch(const BacktestCancelled&) {
+            // The owner was cancelled, not us: download it ourselves.
+            out[w.first] = fetch_shared(symbol,resolution,{windows[w.first]},limit,control)[0];
+        }
+    }
+    return out;
+}
+
+// Candles of `windows` (ascending, disjoint) with time in [start_time, end_time].
+static vector<Candle> concat_range(const vector<CandleBuffer> &parts,int64_t start_time,int64_t end_time){
+    auto by_time = [](const Candle &c,int64_t t){ return c.time<t; };
+    vector<Candle> out;
+    for(auto &p:parts){
+        auto lo = lower_bound(p->begin(),p->end(),start_time,by_time);
+        auto hi = lower_bound(lo,p->end(),end_time+1,by_time);
+        out.insert(out.end(),lo,hi);
+    }
+    return out;
+}
+
+vector<Candle> fetch_remote_candles(const string &symbol,const string &resolution,int64_t start_time,int64_t end_time,int limit,
+                                    RunControl *control){
+    if(start_time>end_time) return {};
+    auto windows = grid_windows(start_time,end_time,limit,resolution_seconds(resolution));
+    // Windows are disjoint and ascending, so concatenating sorted windows
+    // yields a sorted series without a final sort.
+    return concat_range(fetch_shared(symbol,resolution,windows,limit,control),start_time,end_time);
+}
+
+// -------- RESAMPLING --------
+// Exchange resolutions that sit on the epoch grid, finest first.
+static const char *const GRID_RESOLUTIONS[] = {"1m","3m","5m","15m","30m","1h","2h","4h","6h","12h","1d"};
+
+static int64_t floor_to(int64_t t,int64_t step){
+    int64_t r = t%step;
+    return t-r-(r<0 ? step : 0);
+}
+
+static int64_t ceil_to(int64_t t,int64_t step){
+    int64_t f = floor_to(t,step);
+    return f==t ? t : f+step;
+}
+
+// Builds the closed candles in [start_time, closed_end] from the coarsest
+// finer series in the store that already covers every base candle they need.
+static bool derive_from_store(CandleStore &store,const string &symbol,const string &resolution,
+                              int64_t start_time,int64_t closed_end,vector<Candle> &out){
+    int sec_per_candle = resolution_seconds(resolution);
+    int64_t first = ceil_to(start_time,sec_per_candle), last = floor_to(closed_end,sec_per_candle);
+    if(first>last) return false;
+    for(size_t i=size(GRID_RESOLUTIONS);i-->0;){
+        if(!can_resample(resolution_seconds(GRID_RESOLUTIONS[i]),sec_per_candle)) continue;
+        CandleSeriesFile *base = store.existing_series(symbol,GRID_RESOLUTIONS[i]);
+        if(!base || !base->missing(first,last+sec_per_candle-1).empty()) continue;
+        CandleColumns columns;
+        base->read_columns(first,last+sec_per_candle-1,columns);
+        out = to_candles(resample(columns,sec_per_candle));
+        return true;
+    }
+    return false;
+}
+
+vector<Candle> fetch_resampled(const string &symbol,const string &resolution,const string &base_resolution,
+                               int64_t start_time,int64_t end_time,int limit,RunControl *control){
+    int sec_per_candle = resolution_seconds(resolution);
+    if(!can_resample(resolution_seconds(base_resolution),sec_per_candle))
+        throw runtime_error("Cannot build "+resolution+" candles from "+base_resolution+" candles");
+    int64_t first = ceil_to(start_time,sec_per_candle), last = floor_to(end_time,sec_per_candle);
+    if(first>last) throw runtime_error("No candles returned. Check symbol/times.");
+    auto base = fetch_candles(symbol,base_resolution,first,last+sec_per_candle-1,limit,control);
+    return to_candles(resample(to_columns(base),sec_per_candle));
+}
+
+vector<Candle> fetch_candles(const string &symbol,const string &resolution,int64_t start_time,int64_t end_time,int limit,
+                             RunControl *control){
+    // Only candles that have closed are persisted; anything newer is fetched
+    // on every call so a still-forming candle never gets frozen in the store.
+    // closed_end sits on a candle boundary so it stays put for a whole candle
+    // and concurrent requests produce the same windows.
+    int sec_per_candle = resolution_seconds(resolution);
+    int64_t now = static_cast<int64_t>(time(nullptr));
+    int64_t closed_end = min<int64_t>(end_time, now/sec_per_candle*sec_per_candle-sec_per_candle);
+
+    CandleStore *store = candle_store();
+    CandleSeriesFile *series = store ? store->series(symbol,resolution) : nullptr;
+
+    // A closed range the store lacks may still be derivable from finer data.
+    vector<Candle> derived;
+    bool have_derived = series && start_time<=closed_end && !series->missing(start_time,closed_end).empty() &&
+                        derive_from_store(*store,symbol,resolution,start_time,closed_end,derived);
+
+    // Grid windows over the gaps (or the whole closed range without a store),
+    // plus the open tail, downloaded in one pipelined batch.
+    vector<Window> windows;
+    if(start_time<=closed_end && !have_derived){
+        vector<Window> gaps;
+        if(series) gaps = series->missing(start_time,closed_end);
+        else gaps.emplace_back(start_time,closed_end);
+        for(auto &g:gaps){
+            for(auto &w:grid_windows(g.first,g.second,limit,sec_per_candle)){
+                w.second = min(w.second,closed_end);
+                if(windows.empty() || windows.back()!=w) windows.push_back(w);
+            }
+        }
+    }
+    bool has_tail = closed_end<end_time;
+    if(has_tail) windows.emplace_back(max(start_time,closed_end+1),end_time);
+    auto parts = fetch_shared(symbol,resolution,windows,limit,control);
+    CandleBuffer recent;
+    if(has_tail){
+        recent = parts.back();
+        parts.pop_back();
+        windows.pop_back();
+    }
+
+    vector<Candle> all_data;
+    if(have_derived){
+        all_data = move(derived);
+    } else if(series){
+        for(size_t i=0;i<parts.size();i++){
+            // An empty answer is more often a bad symbol or a transient
+            // exchange error than a real hole in history; don't remember it.
+            if(parts[i]->empty()) continue;
+            series->append(windows[i].first,windows[i].second,*parts[i]);
+        }
+        if(start_time<=closed_end) series->read(start_time,closed_end,all_data);
+    } else {
+        all_data = concat_range(parts,start_time,closed_end);
+    }
+    if(recent) all_data.insert(all_data.end(),recent->begin(),recent->end());
+    if(all_data.empty()) throw runtime_error("No candles returned. Check symbol/times.");
+    return all_data;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "run_control.h"
+#include "strategy.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// How candle windows are pulled from the exchange.
+struct FetchOptions {
+    std::string base_url = "https://api.delta.exchange";
+    int max_in_flight = 4;            // windows downloading at once
+    int max_connections = 4;          // keep-alive connections per pooled multi handle
+    double requests_per_second = 20;  // token bucket refill rate
+    int burst = 4;                    // token bucket capacity
+    long timeout_seconds = 30;
+};
+
+// Process-wide options. Defaults come from CANDLE_API_BASE_URL,
+// CANDLE_FETCH_CONCURRENCY and CANDLE_FETCH_RPS when set.
+FetchOptions fetch_options();
+void set_fetch_options(const FetchOptions &opts);
+
+// Downloads [start_time, end_time] from the exchange in `limit`-sized
+// windows. Returns candles sorted by time; may be empty. `control` gets
+// per-window progress (0..0.7) and can abort the download.
+//
+// Windows are aligned to a fixed grid, and a window that another request is
+// already downloading is waited for and shared rather than fetched twice.
+std::vector<Candle> fetch_remote_candles(const std::string &symbol, const std::string &resolution,
+                                         int64_t start_time, int64_t end_time, int limit = 4000,
+                                         RunControl *control = nullptr);
+
+// Windows downloaded so far, and windows served from another request's
+// in-flight download instead.
+struct FetchStats {
+    uint64_t windows_downloaded = 0;
+    uint64_t windows_shared = 0;
+};
+FetchStats fetch_stats();
+
+// Serves the covered part of the range from the local candle store and
+// downloads only the gaps. A closed range the store lacks is resampled from
+// finer stored candles instead when those cover it completely. Throws when
+// the range holds no candles at all.
+std::vector<Candle> fetch_candles(const std::string &symbol, const std::string &resolution,
+                                  int64_t start_time, int64_t end_time, int limit = 4000,
+                                  RunControl *control = nullptr);
+
+// `resolution` candles in [start_time, end_time] aggregated from
+// `base_resolution` candles (fetched through fetch_candles), so several
+// coarser studies can share one download. Throws unless the base resolution
+// divides the target one.
+std::vector<Candle> fetch_resampled(const std::string &symbol, const std::string &resolution,
+                                    const std::string &base_resolution, int64_t start_time, int64_t end_time,
+                                    int limit = 4000, RunControl *control = nullptr);
@@ -0,0 +1,287 @@
+#include "metrics.h"
+
+#include "arena.h"
+
+#include <atomic>
+#include <charconv>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+const char* pipeline_stage_name(PipelineStage stage){
+    switch(stage){
+    case PipelineStage::Fetch: return "fetch";
+    case PipelineStage::Renko: return "renko";
+    case PipelineStage::Ichimoku: return "ichimoku";
+    case PipelineStage::Strategy: return "strategy";
+    case PipelineStage::MonteCarlo: return "monte_carlo";
+    case PipelineStage::Format: return "format";
+    case PipelineStage::Serialize: return "serialize";
+    }
+    return "unknown";
+}
+
+const char* endpoint_name(Endpoint endpoint){
+    switch(endpoint){
+    case Endpoint::Backtest: return "backtest";
+    case Endpoint::DownloadCsv: return "download_csv";
+    case Endpoint::Sweep: return "sweep";
+    case Endpoint::Session: return "session";
+    case Endpoint::Job: return "job";
+    case Endpoint::Batch: return "batch";
+    case Endpoint::Artifact: return "artifact";
+    }
+    return "unknown";
+}
+
+namespace {
+
+// -------- HISTOGRAM LAYOUT --------
+// Values below SUB get a bucket each; above that, every power of two is
+// split into SUB equal buckets. Values of 2^(MAX_EXP+1) and more share the
+// last bucket.
+const int SUB_BITS = 3;
+const uint64_t SUB = uint64_t(1)<<SUB_BITS;
+const int MAX_EXP = 47;
+const size_t BUCKETS = static_cast<size_t>(MAX_EXP-SUB_BITS+2)*SUB;
+
+int floor_log2(uint64_t v){
+#if defined(__GNUC__) || defined(__clang__)
+    return 63-__builtin_clzll(v);
+#else
+    int e = 0;
+    while(v>>=1) e++;
+    return e;
+#endif
+}
+
+size_t bucket_of(uint64_t v){
+    if(v<SUB) return static_cast<size_t>(v);
+    int e = floor_log2(v);
+    if(e>MAX_EXP) return BUCKETS-1;
+    return static_cast<size_t>(e-SUB_BITS+1)*SUB + ((v>>(e-SUB_BITS))&(SUB-1));
+}
+
+// Exclusive upper bound of bucket i.
+uint64_t bucket_limit(size_t i){
+    if(i<SUB) return i+1;
+    int e = static_cast<int>(i/SUB)-1+SUB_BITS;
+    return (SUB+i%SUB+1)<<(e-SUB_BITS);
+}
+
+// Only the owning thread writes a shard, so a relaxed load and store is
+// enough; scrapes read concurrently and may be a few events behind.
+template <class T>
+inline void bump(atomic<T> &a,T by){
+    a.store(a.load(memory_order_relaxed)+by,memory_order_relaxed);
+}
+
+struct Histogram {
+    atomic<uint64_t> counts[BUCKETS];
+    atomic<uint64_t> sum;
+
+    void record(uint64_t v){
+        bump<uint64_t>(counts[bucket_of(v)],1);
+        bump(sum,v);
+    }
+};
+
+struct Shard {
+    Histogram stages[PIPELINE_STAGES];
+    Histogram latency[ENDPOINTS];
+    Histogram response_bytes[ENDPOINTS];
+    atomic<uint64_t> requests[ENDPOINTS][2];   // [endpoint][ok]
+    atomic<int64_t> in_flight[ENDPOINTS];
+    atomic<uint64_t> fetched_bytes;
+};
+
+// Shards live as long as the process; threads here are long-lived pools.
+mutex shards_mu;
+vector<Shard*> shards;
+
+Shard* register_shard(){
+    Shard *s = new Shard();   // value-initialized: all zero
+    lock_guard<mutex> lk(shards_mu);
+    shards.push_back(s);
+    return s;
+}
+
+inline Shard& local_shard(){
+    thread_local Shard *shard = register_shard();
+    return *shard;
+}
+
+// -------- SCRAPE --------
+struct Totals {
+    vector<uint64_t> counts = vector<uint64_t>(BUCKETS);
+    uint64_t sum = 0, count = 0;
+
+    void add(const Histogram &h){
+        for(size_t i=0;i<BUCKETS;i++){
+            uint64_t c = h.counts[i].load(memory_order_relaxed);
+            counts[i] += c;
+            count += c;
+        }
+        sum += h.sum.load(memory_order_relaxed);
+    }
+    // Upper bound of the bucket holding quantile q.
+    uint64_t quantile(double q) const{
+        if(count==0) return 0;
+        uint64_t rank = static_cast<uint64_t>(q*count);
+        if(rank>=count) rank = count-1;
+        uint64_t seen = 0;
+        for(size_t i=0;i<BUCKETS;i++){
+            seen += counts[i];
+            if(seen>rank) return bucket_limit(i);
+        }
+        return bucket_limit(BUCKETS-1);
+    }
+};
+
+void put_number(string &out,double v){
+    char buf[32];
+    auto r = to_chars(buf,buf+sizeof(buf),v);
+    out.append(buf,r.ptr);
+}
+
+void put_number(string &out,uint64_t v){
+    char buf[24];
+    auto r = to_chars(buf,buf+sizeof(buf),v);
+    out.append(buf,r.ptr);
+}
+
+void put_header(string &out,const char *name,const char *type,const char *help){
+    out += "# HELP "; out += name; out += ' '; out += help; out += '\n';
+    out += "# TYPE "; out += name; out += ' '; out += type; out += '\n';
+}
+
+// Cumulative buckets at every power of two from 2^first_exp to 2^last_exp.
+// Those are bucket edges, so the counts are exact. Recorded values are
+// divided by `unit` (1e9 for ns to seconds) on the way out.
+void put_histogram(string &out,const char *name,const string &labels,const Totals &t,
+                   int first_exp,int last_exp,double unit){
+    size_t i = 0;
+    uint64_t cumulative = 0;
+    for(int e=first_exp;e<=last_exp;e++){
+        uint64_t edge = uint64_t(1)<<e;
+        while(i<BUCKETS && bucket_limit(i)<=edge) cumulative += t.counts[i++];
+        out += name; out += "_bucket{"; out += labels; out += ",le=\"";
+        put_number(out,edge/unit); out += "\"} "; put_number(out,cumulative); out += '\n';
+    }
+    out += name; out += "_bucket{"; out += labels; out += ",le=\"+Inf\"} "; put_number(out,t.count); out += '\n';
+    out += name; out += "_sum{"; out += labels; out += "} "; put_number(out,t.sum/unit); out += '\n';
+    out += name; out += "_count{"; out += labels; out += "} "; put_number(out,t.count); out += '\n';
+}
+
+// Quantiles from the fine buckets, which the exported ones are too coarse for.
+void put_quantiles(string &out,const char *name,const string &labels,const Totals &t,double unit){
+    for(double q : {0.5,0.9,0.99}){
+        out += name; out += '{'; out += labels; out += ",quantile=\"";
+        put_number(out,q); out += "\"} "; put_number(out,t.quantile(q)/unit); out += '\n';
+    }
+}
+
+string label(const char *key,const char *value){
+    return string(key)+"=\""+value+"\"";
+}
+
+} // namespace
+
+void record_stage(PipelineStage stage,uint64_t nanoseconds){
+    local_shard().stages[static_cast<size_t>(stage)].record(nanoseconds);
+}
+
+void record_request(Endpoint endpoint,bool ok,uint64_t nanoseconds){
+    Shard &s = local_shard();
+    size_t e = static_cast<size_t>(endpoint);
+    bump<uint64_t>(s.requests[e][ok ? 1 : 0],1);
+    s.latency[e].record(nanoseconds);
+}
+
+void record_response_bytes(Endpoint endpoint,size_t bytes){
+    local_shard().response_bytes[static_cast<size_t>(endpoint)].record(bytes);
+}
+
+void record_fetched_bytes(size_t bytes){
+    bump<uint64_t>(local_shard().fetched_bytes,bytes);
+}
+
+RequestMetrics::RequestMetrics(Endpoint endpoint) : endpoint_(endpoint), start_(chrono::steady_clock::now()) {
+    bump<int64_t>(local_shard().in_flight[static_cast<size_t>(endpoint_)],1);
+}
+
+RequestMetrics::~RequestMetrics(){
+    bump<int64_t>(local_shard().in_flight[static_cast<size_t>(endpoint_)],-1);
+    record_request(endpoint_,ok_,static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now()-start_).count()));
+}
+
+string metrics_prometheus_text(){
+    vector<Totals> stages(PIPELINE_STAGES), latency(ENDPOINTS), sizes(ENDPOINTS);
+    uint64_t requests[ENDPOINTS][2] = {};
+    int64_t in_flight[ENDPOINTS] = {};
+    uint64_t fetched = 0;
+    {
+        lock_guard<mutex> lk(shards_mu);
+        for(Shard *s : shards){
+            for(size_t i=0;i<PIPELINE_STAGES;i++) stages[i].add(s->stages[i]);
+            for(size_t e=0;e<ENDPOINTS;e++){
+                latency[e].add(s->latency[e]);
+                sizes[e].add(s->response_bytes[e]);
+                requests[e][0] += s->requests[e][0].load(memory_order_relaxed);
+                requests[e][1] += s->requests[e][1].load(memory_order_relaxed);
+                in_flight[e] += s->in_flight[e].load(memory_order_relaxed);
+            }
+            fetched += s->fetched_bytes.load(memory_order_relaxed);
+        }
+    }
+
+    // Latencies from 1 us (2^10 ns) to about 69 s, sizes from 64 B to 4 GiB.
+    const double NS = 1e9;
+    string out;
+    out.reserve(64*1024);
+
+    put_header(out,"backtest_requests_total","counter","Requests handled, by endpoint and outcome.");
+    for(size_t e=0;e<ENDPOINTS;e++){
+        for(int ok=1;ok>=0;ok--){
+            out += "backtest_requests_total{"; out += label("endpoint",endpoint_name(static_cast<Endpoint>(e)));
+            out += ','; out += label("outcome",ok ? "ok" : "error"); out += "} ";
+            put_number(out,requests[e][ok]); out += '\n';
+        }
+    }
+
+    put_header(out,"backtest_requests_in_flight","gauge","Requests currently being handled.");
+    for(size_t e=0;e<ENDPOINTS;e++){
+        out += "backtest_requests_in_flight{"; out += label("endpoint",endpoint_name(static_cast<Endpoint>(e)));
+        out += "} "; out += to_string(in_flight[e]); out += '\n';
+    }
+
+    put_header(out,"backtest_request_duration_seconds","histogram","Request latency, by endpoint.");
+    for(size_t e=0;e<ENDPOINTS;e++)
+        put_histogram(out,"backtest_request_duration_seconds",label("endpoint",endpoint_name(static_cast<Endpoint>(e))),latency[e],10,36,NS);
+
+    put_header(out,"backtest_request_duration_quantile_seconds","gauge","Request latency quantiles since start, by endpoint.");
+    for(size_t e=0;e<ENDPOINTS;e++)
+        put_quantiles(out,"backtest_request_duration_quantile_seconds",label("endpoint",endpoint_name(static_cast<Endpoint>(e))),latency[e],NS);
+
+    put_header(out,"backtest_stage_duration_seconds","histogram","Time spent in each pipeline stage (cache hits excluded).");
+    for(size_t i=0;i<PIPELINE_STAGES;i++)
+        put_histogram(out,"backtest_stage_duration_seconds",label("stage",pipeline_stage_name(static_cast<PipelineStage>(i))),stages[i],10,36,NS);
+
+    put_header(out,"backtest_stage_duration_quantile_seconds","gauge","Pipeline stage latency quantiles since start.");
+    for(size_t i=0;i<PIPELINE_STAGES;i++)
+        put_quantiles(out,"backtest_stage_duration_quantile_seconds",label("stage",pipeline_stage_name(static_cast<PipelineStage>(i))),stages[i],NS);
+
+    put_header(out,"backtest_response_bytes","histogram","Response body size, by endpoint.");
+    for(size_t e=0;e<ENDPOINTS;e++)
+        put_histogram(out,"backtest_response_bytes",label("endpoint",endpoint_name(static_cast<Endpoint>(e))),sizes[e],6,32,1.0);
+
+    put_header(out,"backtest_fetched_bytes_total","counter","Candle data downloaded from the exchange.");
+    out += "backtest_fetched_bytes_total "; put_number(out,fetched); out += '\n';
+
+    put_header(out,"backtest_arena_retained_bytes","gauge","Scratch arena blocks kept for reuse, all threads.");
+    out += "backtest_arena_retained_bytes "; put_number(out,arena_retained_bytes()); out += '\n';
+    return out;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Request and pipeline instrumentation, exported in Prometheus text format.
+//
+// Every thread records into its own shard with plain relaxed stores (no
+// locks, no shared cache lines); a scrape sums the shards. Latencies and
+// sizes go into log-linear histograms (8 sub-buckets per power of two, so
+// any recorded value is within 12.5% of its bucket's bounds).
+enum class PipelineStage { Fetch, Renko, Ichimoku, Strategy, MonteCarlo, Format, Serialize };
+const size_t PIPELINE_STAGES = 7;
+
+enum class Endpoint { Backtest, DownloadCsv, Sweep, Session, Job, Batch, Artifact };
+const size_t ENDPOINTS = 7;
+
+const char* pipeline_stage_name(PipelineStage stage);
+const char* endpoint_name(Endpoint endpoint);
+
+void record_stage(PipelineStage stage, uint64_t nanoseconds);
+void record_request(Endpoint endpoint, bool ok, uint64_t nanoseconds);
+void record_response_bytes(Endpoint endpoint, size_t bytes);
+void record_fetched_bytes(size_t bytes);
+
+// Times a pipeline stage from construction to destruction.
+class StageTimer {
+public:
+    explicit StageTimer(PipelineStage stage) : stage_(stage), start_(std::chrono::steady_clock::now()) {}
+    ~StageTimer(){
+        record_stage(stage_, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_).count()));
+    }
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    PipelineStage stage_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Counts a request as in flight while alive and records its outcome and
+// latency when destroyed; it counts as failed unless succeed() was called.
+class RequestMetrics {
+public:
+    explicit RequestMetrics(Endpoint endpoint);
+    ~RequestMetrics();
+    RequestMetrics(const RequestMetrics&) = delete;
+    RequestMetrics& operator=(const RequestMetrics&) = delete;
+
+    void succeed() { ok_ = true; }
+    void response_bytes(size_t bytes) { record_response_bytes(endpoint_, bytes); }
+
+private:
+    Endpoint endpoint_;
+    bool ok_ = false;
+    std::chrono::steady_clock::time_point start_;
+};
+
+std::string metrics_prometheus_text();
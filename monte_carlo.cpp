@@ -0,0 +1,213 @@
+#include "monte_carlo.h"
+#include "arena.h"
+#include "metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory_resource>
+#include <stdexcept>
+
+using json = nlohmann::json;
+using namespace std;
+
+static const size_t MAX_ITERATIONS = 1000000;
+static const double MAX_TRADE_DRAWS = 5e9;   // iterations * trades
+static const size_t LANES = 8;               // resamples replayed side by side
+static const size_t BLOCK = 32*LANES;        // resamples per pool task
+
+const char* resample_method_name(ResampleMethod method){
+    switch(method){
+    case ResampleMethod::Bootstrap: return "bootstrap";
+    case ResampleMethod::Shuffle: return "shuffle";
+    }
+    return "bootstrap";
+}
+
+bool monte_carlo_from_json(const json &data,MonteCarloParams &out){
+    if(!data.contains("monte_carlo")) return false;
+    const json &mc = data["monte_carlo"];
+    out = MonteCarloParams();
+    if(mc.is_boolean()) return mc.get<bool>();
+    if(!mc.is_object()) throw runtime_error("monte_carlo must be true or an object");
+    long long iterations = mc.value("iterations", static_cast<long long>(out.iterations));
+    if(iterations<1 || static_cast<size_t>(iterations)>MAX_ITERATIONS)
+        throw runtime_error("monte_carlo iterations must be between 1 and "+to_string(MAX_ITERATIONS));
+    out.iterations = static_cast<size_t>(iterations);
+    string method = mc.value("method", "bootstrap");
+    if(method=="bootstrap") out.method = ResampleMethod::Bootstrap;
+    else if(method=="shuffle") out.method = ResampleMethod::Shuffle;
+    else throw runtime_error("monte_carlo method must be bootstrap or shuffle");
+    out.seed = mc.value("seed", out.seed);
+    return true;
+}
+
+// -------- RANDOM NUMBERS --------
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3").
+// Fills the 32-bit draws of LANES consecutive resamples for every position,
+// position-major (draws[j*LANES + lane]). Draw j of resample r is word j%4
+// of the block with counter (j/4, r) and the seed as key. The rounds run
+// across lanes side by side.
+static void fill_draws(uint64_t seed,uint64_t first_resample,size_t n,uint32_t *draws){
+    const uint32_t k0 = static_cast<uint32_t>(seed), k1 = static_cast<uint32_t>(seed>>32);
+    for(size_t j=0;j<n;j+=4){
+        uint64_t block = j>>2;
+        uint32_t c0[LANES], c1[LANES], c2[LANES], c3[LANES];
+        for(size_t l=0;l<LANES;l++){
+            uint64_t r = first_resample+l;
+            c0[l] = static_cast<uint32_t>(block);
+            c1[l] = static_cast<uint32_t>(block>>32);
+            c2[l] = static_cast<uint32_t>(r);
+            c3[l] = static_cast<uint32_t>(r>>32);
+        }
+        uint32_t key0 = k0, key1 = k1;
+        for(int round=0;round<10;round++){
+            for(size_t l=0;l<LANES;l++){
+                uint64_t p0 = static_cast<uint64_t>(0xD2511F53u)*c0[l];
+                uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57u)*c2[l];
+                uint32_t n0 = static_cast<uint32_t>(p1>>32)^c1[l]^key0;
+                uint32_t n2 = static_cast<uint32_t>(p0>>32)^c3[l]^key1;
+                c1[l] = static_cast<uint32_t>(p1);
+                c3[l] = static_cast<uint32_t>(p0);
+                c0[l] = n0;
+                c2[l] = n2;
+            }
+            key0 += 0x9E3779B9u;
+            key1 += 0xBB67AE85u;
+        }
+        uint32_t *out = draws+j*LANES;
+        if(j+4<=n){
+            for(size_t l=0;l<LANES;l++){
+                out[l] = c0[l];
+                out[LANES+l] = c1[l];
+                out[2*LANES+l] = c2[l];
+                out[3*LANES+l] = c3[l];
+            }
+        } else {
+            const uint32_t *words[4] = {c0, c1, c2, c3};
+            for(size_t w=0;j+w<n;w++)
+                for(size_t l=0;l<LANES;l++) out[w*LANES+l] = words[w][l];
+        }
+    }
+}
+
+// Uniform in [0, bound), by multiply-shift.
+static inline size_t below(uint32_t draw,size_t bound){
+    return static_cast<size_t>((static_cast<uint64_t>(draw)*bound)>>32);
+}
+
+// -------- KERNEL --------
+// Replays LANES resamples stored position-major (profits[j*LANES + lane]).
+// The lanes are independent, so the inner loop compiles to vector max/add.
+static void replay(const double *profits,size_t n,double *final_equity,double *max_drawdown,double *losing_streak){
+    double equity[LANES] = {}, peak[LANES] = {}, drawdown[LANES] = {}, run[LANES] = {}, longest[LANES] = {};
+    for(size_t j=0;j<n;j++){
+        const double *p = profits+j*LANES;
+        for(size_t l=0;l<LANES;l++){
+            equity[l] += p[l];
+            peak[l] = max(peak[l],equity[l]);
+            drawdown[l] = max(drawdown[l],peak[l]-equity[l]);
+            double loss = p[l]<=0 ? 1.0 : 0.0;
+            run[l] = (run[l]+1.0)*loss;
+            longest[l] = max(longest[l],run[l]);
+        }
+    }
+    for(size_t l=0;l<LANES;l++){
+        final_equity[l] = equity[l];
+        max_drawdown[l] = drawdown[l];
+        losing_streak[l] = longest[l];
+    }
+}
+
+MonteCarloResult run_monte_carlo(const vector<Trade> &trades,const MonteCarloParams &params,WorkStealingPool &pool){
+    StageTimer timer(PipelineStage::MonteCarlo);
+    size_t n = trades.size();
+    if(static_cast<double>(n)*params.iterations>MAX_TRADE_DRAWS)
+        throw runtime_error("monte_carlo: "+to_string(params.iterations)+" resamples of "+to_string(n)+
+                            " trades is too much work; use fewer iterations");
+    MonteCarloResult result;
+    result.params = params;
+    result.trades = n;
+    size_t run = 0;
+    for(auto &t:trades){
+        result.original.add(t.profit);
+        run = t.profit<=0 ? run+1 : 0;
+        result.original_losing_streak = max(result.original_losing_streak,run);
+    }
+
+    size_t iterations = params.iterations;
+    // Padded to whole lane groups; the extra lanes are computed and dropped.
+    size_t padded = (iterations+LANES-1)/LANES*LANES;
+    vector<double> final_equity(padded), max_drawdown(padded), losing_streak(padded);
+    if(n>0){
+        vector<double> profit(n);
+        for(size_t j=0;j<n;j++) profit[j] = trades[j].profit;
+        size_t blocks = (padded+BLOCK-1)/BLOCK;
+        pool.parallel_for(blocks,[&](size_t b){
+            ArenaScope arena;
+            pmr::vector<uint32_t> draws(n*LANES,arena.memory());
+            pmr::vector<double> lanes(n*LANES,arena.memory());
+            pmr::vector<double> perm(params.method==ResampleMethod::Shuffle ? n : 0,arena.memory());
+            size_t end = min(padded,(b+1)*BLOCK);
+            for(size_t first=b*BLOCK;first<end;first+=LANES){
+                fill_draws(params.seed,first,n,draws.data());
+                if(params.method==ResampleMethod::Bootstrap){
+                    for(size_t i=0;i<n*LANES;i++) lanes[i] = profit[below(draws[i],n)];
+                } else {
+                    for(size_t l=0;l<LANES;l++){
+                        copy(profit.begin(),profit.end(),perm.begin());
+                        for(size_t j=n-1;j>0;j--) swap(perm[j],perm[below(draws[j*LANES+l],j+1)]);
+                        for(size_t j=0;j<n;j++) lanes[j*LANES+l] = perm[j];
+                    }
+                }
+                replay(lanes.data(),n,&final_equity[first],&max_drawdown[first],&losing_streak[first]);
+            }
+        });
+    }
+    final_equity.resize(iterations);
+    max_drawdown.resize(iterations);
+    losing_streak.resize(iterations);
+    result.final_equity = move(final_equity);
+    result.max_drawdown = move(max_drawdown);
+    result.losing_streak = move(losing_streak);
+    return result;
+}
+
+static double round2(double v) { return round(v*100.0)/100.0; }
+
+static json distribution(vector<double> values){
+    sort(values.begin(),values.end());
+    json j = json::object();
+    if(values.empty()) return j;
+    double sum = 0;
+    for(double v:values) sum += v;
+    // Nearest-rank percentiles.
+    for(int p : {1, 5, 25, 50, 75, 95, 99}){
+        size_t rank = static_cast<size_t>(ceil(p/100.0*values.size()));
+        j["p"+to_string(p)] = round2(values[max<size_t>(rank,1)-1]);
+    }
+    j["mean"] = round2(sum/values.size());
+    j["min"] = round2(values.front());
+    j["max"] = round2(values.back());
+    return j;
+}
+
+json monte_carlo_to_json(const MonteCarloResult &result){
+    size_t below_zero = 0;
+    for(double v:result.final_equity) if(v<0) below_zero++;
+    return {
+        {"method", resample_method_name(result.params.method)},
+        {"iterations", result.params.iterations},
+        {"seed", result.params.seed},
+        {"trades", result.trades},
+        {"original", {
+            {"final_equity", round2(result.original.total_profit)},
+            {"max_drawdown", round2(result.original.max_drawdown)},
+            {"longest_losing_streak", result.original_losing_streak}
+        }},
+        {"final_equity", distribution(result.final_equity)},
+        {"max_drawdown", distribution(result.max_drawdown)},
+        {"longest_losing_streak", distribution(result.losing_streak)},
+        {"probability_of_loss", result.final_equity.empty() ? 0.0 :
+            round(static_cast<double>(below_zero)/result.final_equity.size()*10000.0)/10000.0}
+    };
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "strategy.h"
+#include "thread_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+// Robustness check of a backtest's trade sequence: the trades are resampled
+// many times and each resampled sequence is replayed as an equity curve.
+//
+//   bootstrap - draw n trades with replacement
+//   shuffle   - permute the n trades (final equity never changes; drawdown
+//               and losing streaks do)
+//
+// Random numbers come from Philox4x32-10 keyed by the seed and counted by
+// (resample, position), so results depend only on the seed, never on how
+// resamples are spread over threads. Resamples are replayed eight at a time
+// side by side, one per vector lane.
+enum class ResampleMethod { Bootstrap, Shuffle };
+
+const char* resample_method_name(ResampleMethod method);
+
+struct MonteCarloParams {
+    size_t iterations = 10000;
+    ResampleMethod method = ResampleMethod::Bootstrap;
+    uint64_t seed = 1;
+};
+
+// "monte_carlo": true, or {"iterations", "method", "seed"}. Returns false when
+// the field is absent or false. Throws std::runtime_error on invalid input.
+bool monte_carlo_from_json(const nlohmann::json &data, MonteCarloParams &out);
+
+// One value per resample, in resample order.
+struct MonteCarloResult {
+    MonteCarloParams params;
+    size_t trades = 0;
+    std::vector<double> final_equity, max_drawdown, losing_streak;
+    TradeSummary original;
+    size_t original_losing_streak = 0;
+};
+
+// Losing trades are those with profit <= 0, as in TradeSummary.
+MonteCarloResult run_monte_carlo(const std::vector<Trade> &trades, const MonteCarloParams &params,
+                                 WorkStealingPool &pool);
+
+// Percentiles (1, 5, 25, 50, 75, 95, 99), mean, min and max per metric,
+// the share of resamples ending below zero, and the original sequence's values.
+nlohmann::json monte_carlo_to_json(const MonteCarloResult &result);
@@ -0,0 +1,75 @@
+#include "resample.h"
+
+using namespace std;
+
+CandleColumns to_columns(const vector<Candle> &candles){
+    CandleColumns c;
+    c.resize(candles.size());
+    for(size_t i=0;i<candles.size();i++){
+        c.time[i] = candles[i].time;
+        c.open[i] = candles[i].open;
+        c.high[i] = candles[i].high;
+        c.low[i] = candles[i].low;
+        c.close[i] = candles[i].close;
+        c.volume[i] = candles[i].volume;
+    }
+    return c;
+}
+
+vector<Candle> to_candles(const CandleColumns &c){
+    vector<Candle> out(c.size());
+    for(size_t i=0;i<out.size();i++)
+        out[i] = {c.time[i],c.open[i],c.high[i],c.low[i],c.close[i],c.volume[i]};
+    return out;
+}
+
+bool can_resample(int base_seconds,int target_seconds){
+    return base_seconds>0 && target_seconds>base_seconds && target_seconds%base_seconds==0;
+}
+
+// Each pass below runs over one column with no dependence on the others, so
+// the loops stay simple enough for the compiler to unroll and vectorize.
+CandleColumns resample(const CandleColumns &base,int64_t target_seconds){
+    size_t n = base.size();
+    CandleColumns out;
+    if(n==0) return out;
+
+    // Bucket start of every base candle (floor division, epoch aligned).
+    vector<int64_t> bucket(n);
+    const int64_t *t = base.time.data();
+    for(size_t i=0;i<n;i++){
+        int64_t r = t[i]%target_seconds;
+        bucket[i] = t[i]-r-(r<0 ? target_seconds : 0);
+    }
+
+    // Row ranges [first[k], first[k+1]) that share a bucket.
+    vector<size_t> first;
+    first.reserve(n/2+2);
+    first.push_back(0);
+    for(size_t i=1;i<n;i++) if(bucket[i]!=bucket[i-1]) first.push_back(i);
+    size_t m = first.size();
+    first.push_back(n);
+    out.resize(m);
+
+    for(size_t k=0;k<m;k++) out.time[k] = bucket[first[k]];
+    for(size_t k=0;k<m;k++) out.open[k] = base.open[first[k]];
+    for(size_t k=0;k<m;k++) out.close[k] = base.close[first[k+1]-1];
+
+    const double *h = base.high.data(), *l = base.low.data(), *v = base.volume.data();
+    for(size_t k=0;k<m;k++){
+        double x = h[first[k]];
+        for(size_t i=first[k]+1;i<first[k+1];i++) x = h[i]>x ? h[i] : x;
+        out.high[k] = x;
+    }
+    for(size_t k=0;k<m;k++){
+        double x = l[first[k]];
+        for(size_t i=first[k]+1;i<first[k+1];i++) x = l[i]<x ? l[i] : x;
+        out.low[k] = x;
+    }
+    for(size_t k=0;k<m;k++){
+        double x = 0;
+        for(size_t i=first[k];i<first[k+1];i++) x += v[i];
+        out.volume[k] = x;
+    }
+    return out;
+}
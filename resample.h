@@ -0,0 +1,19 @@
+#pragma once
+
+#include "strategy.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+CandleColumns to_columns(const std::vector<Candle> &candles);
+std::vector<Candle> to_candles(const CandleColumns &columns);
+
+// True when candles of `target_seconds` can be built from `base_seconds`.
+bool can_resample(int base_seconds, int target_seconds);
+
+// Aggregates a time-sorted series into buckets of `target_seconds` aligned
+// to the epoch (as the exchange aligns its own candles): first open, highest
+// high, lowest low, last close, summed volume. Each bucket is stamped with
+// its start. Buckets without any base candle are not emitted.
+CandleColumns resample(const CandleColumns &base, int64_t target_seconds);
@@ -0,0 +1,106 @@
+#include "result_cache.h"
+
+#include <cstdlib>
+
+using json = nlohmann::json;
+using namespace std;
+
+const char* cache_layer_name(CacheLayer layer){
+    switch(layer){
+    case CacheLayer::Candles: return "candles";
+    case CacheLayer::Renko: return "renko";
+    case CacheLayer::Ichimoku: return "ichimoku";
+    case CacheLayer::Trades: return "trades";
+    }
+    return "unknown";
+}
+
+// Keys are unique per layer only, so the index key carries the layer too.
+static string index_key(CacheLayer layer,const string &key){
+    string k;
+    k.reserve(key.size()+2);
+    k += static_cast<char>('0'+static_cast<int>(layer));
+    k += '|';
+    k += key;
+    return k;
+}
+
+ResultCache::ResultCache(size_t budget_bytes) : budget_(budget_bytes) {}
+
+shared_ptr<const void> ResultCache::lookup(CacheLayer layer,const string &key){
+    lock_guard<mutex> lk(mu_);
+    Counters &c = counters_[static_cast<size_t>(layer)];
+    auto it = index_.find(index_key(layer,key));
+    if(it==index_.end()){
+        c.misses++;
+        return nullptr;
+    }
+    c.hits++;
+    lru_.splice(lru_.begin(),lru_,it->second);
+    return it->second->value;
+}
+
+bool ResultCache::contains(CacheLayer layer,const string &key) const{
+    lock_guard<mutex> lk(mu_);
+    return index_.count(index_key(layer,key))>0;
+}
+
+void ResultCache::store(CacheLayer layer,const string &key,shared_ptr<const void> value,size_t bytes){
+    if(!value || bytes>budget_) return;
+    string k = index_key(layer,key);
+    lock_guard<mutex> lk(mu_);
+    auto it = index_.find(k);
+    if(it!=index_.end()) erase_locked(it->second);
+    while(bytes_+bytes>budget_ && !lru_.empty()){
+        auto victim = prev(lru_.end());
+        counters_[static_cast<size_t>(victim->layer)].evictions++;
+        erase_locked(victim);
+    }
+    lru_.push_front({layer,k,move(value),bytes});
+    index_.emplace(move(k),lru_.begin());
+    Counters &c = counters_[static_cast<size_t>(layer)];
+    c.entries++;
+    c.bytes += bytes;
+    bytes_ += bytes;
+}
+
+void ResultCache::erase_locked(list<Entry>::iterator it){
+    Counters &c = counters_[static_cast<size_t>(it->layer)];
+    c.entries--;
+    c.bytes -= it->bytes;
+    bytes_ -= it->bytes;
+    index_.erase(it->key);
+    lru_.erase(it);
+}
+
+json ResultCache::stats() const{
+    lock_guard<mutex> lk(mu_);
+    json layers = json::object();
+    uint64_t hits = 0, misses = 0, evictions = 0;
+    for(size_t i=0;i<CACHE_LAYERS;i++){
+        const Counters &c = counters_[i];
+        layers[cache_layer_name(static_cast<CacheLayer>(i))] = {
+            {"hits", c.hits}, {"misses", c.misses}, {"evictions", c.evictions},
+            {"entries", c.entries}, {"bytes", c.bytes}
+        };
+        hits += c.hits; misses += c.misses; evictions += c.evictions;
+    }
+    return {
+        {"budget_bytes", budget_},
+        {"bytes", bytes_},
+        {"entries", lru_.size()},
+        {"hits", hits},
+        {"misses", misses},
+        {"evictions", evictions},
+        {"layers", layers}
+    };
+}
+
+ResultCache& result_cache(){
+    static ResultCache cache([]{
+        const char *env = getenv("RESULT_CACHE_MB");
+        size_t mb = env && *env ? strtoull(env,nullptr,10) : 256;
+        return mb*1024*1024;
+    }());
+    return cache;
+}
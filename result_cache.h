@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <nlohmann/json.hpp>
+
+// Intermediate backtest results shared across requests.
+//
+// Each pipeline stage is a layer keyed by the normalized parameters it
+// depends on (a layer's key extends the one below it), so a request that only
+// differs in Ichimoku lengths still reuses the candles and Renko series. All
+// layers share one LRU list and one memory budget. Values are immutable and
+// handed out as shared_ptr, so eviction never invalidates a running request.
+enum class CacheLayer { Candles, Renko, Ichimoku, Trades };
+const size_t CACHE_LAYERS = 4;
+
+const char* cache_layer_name(CacheLayer layer);
+
+class ResultCache {
+public:
+    explicit ResultCache(size_t budget_bytes);
+
+    template <class T>
+    std::shared_ptr<const T> get(CacheLayer layer, const std::string &key){
+        return std::static_pointer_cast<const T>(lookup(layer, key));
+    }
+    // Presence only: no hit or miss is counted and recency is unchanged.
+    bool contains(CacheLayer layer, const std::string &key) const;
+    // `bytes` is the value's approximate footprint. Values larger than the
+    // whole budget are not kept.
+    template <class T>
+    void put(CacheLayer layer, const std::string &key, std::shared_ptr<const T> value, size_t bytes){
+        store(layer, key, std::static_pointer_cast<const void>(std::move(value)), bytes);
+    }
+
+    size_t budget() const { return budget_; }
+    // Hits, misses, evictions and bytes per layer plus totals.
+    nlohmann::json stats() const;
+
+private:
+    struct Entry {
+        CacheLayer layer;
+        std::string key;   // index key, layer included
+        std::shared_ptr<const void> value;
+        size_t bytes;
+    };
+    struct Counters {
+        uint64_t hits = 0, misses = 0, evictions = 0;
+        size_t entries = 0, bytes = 0;
+    };
+
+    std::shared_ptr<const void> lookup(CacheLayer layer, const std::string &key);
+    void store(CacheLayer layer, const std::string &key, std::shared_ptr<const void> value, size_t bytes);
+    void erase_locked(std::list<Entry>::iterator it);
+
+    size_t budget_;
+    size_t bytes_ = 0;
+    mutable std::mutex mu_;
+    std::list<Entry> lru_;   // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    Counters counters_[CACHE_LAYERS];
+};
+
+// Process-wide cache, sized by RESULT_CACHE_MB (default 256; 0 disables).
+ResultCache& result_cache();
@@ -0,0 +1,600 @@
+#include "rules.h"
+#include "arena.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <memory_resource>
+#include <stdexcept>
+#include <unordered_map>
+
+using json = nlohmann::json;
+using namespace std;
+
+using Op = RuleSet::Op;
+using Instr = RuleSet::Instr;
+
+static const size_t BLOCK = 64;            // rows per pass over the program, one bit word
+static const size_t MAX_RULE_LENGTH = 4096;
+static const int MAX_DEPTH = 64;
+static const size_t MAX_REGISTERS = 4096;
+
+static const RuleKind RULE_KINDS[] = {RuleKind::LongEntry, RuleKind::LongExit, RuleKind::ShortEntry, RuleKind::ShortExit};
+
+const char* rule_kind_name(RuleKind kind){
+    switch(kind){
+    case RuleKind::LongEntry: return "long_entry";
+    case RuleKind::LongExit: return "long_exit";
+    case RuleKind::ShortEntry: return "short_entry";
+    case RuleKind::ShortExit: return "short_exit";
+    }
+    return "long_entry";
+}
+
+const char* default_rule(RuleKind kind){
+    switch(kind){
+    case RuleKind::LongEntry:
+        return "not (close > cloud_bottom and close < cloud_top) and close > kijun and close > cloud_top";
+    case RuleKind::LongExit:
+        return "close < kijun or close < cloud_top";
+    case RuleKind::ShortEntry:
+        return "not (close > cloud_bottom and close < cloud_top) and close < kijun and close < cloud_bottom";
+    case RuleKind::ShortExit:
+        return "close > kijun or close > cloud_bottom";
+    }
+    return "false";
+}
+
+struct Column {
+    const char *name;
+    double IchimokuRow::*field;
+};
+
+static const Column COLUMNS[] = {
+    {"close", &IchimokuRow::close},
+    {"tenkan", &IchimokuRow::tenkan},
+    {"kijun", &IchimokuRow::kijun},
+    {"span_a", &IchimokuRow::span_a},
+    {"span_b", &IchimokuRow::span_b},
+    {"chikou", &IchimokuRow::chikou}
+};
+static const size_t COLUMN_COUNT = sizeof(COLUMNS)/sizeof(COLUMNS[0]);
+
+static double scalar(Op op,double x,double y){
+    switch(op){
+    case Op::Add: return x+y;
+    case Op::Sub: return x-y;
+    case Op::Mul: return x*y;
+    case Op::Div: return x/y;
+    case Op::Neg: return -x;
+    case Op::Abs: return fabs(x);
+    case Op::Min: return min(x,y);
+    case Op::Max: return max(x,y);
+    case Op::Lt: return x<y ? 1.0 : 0.0;
+    case Op::Le: return x<=y ? 1.0 : 0.0;
+    case Op::Gt: return x>y ? 1.0 : 0.0;
+    case Op::Ge: return x>=y ? 1.0 : 0.0;
+    case Op::Eq: return x==y ? 1.0 : 0.0;
+    case Op::Ne: return x!=y ? 1.0 : 0.0;
+    case Op::And: return x*y;
+    case Op::Or: return max(x,y);
+    case Op::Not: return 1.0-x;
+    default: return x;
+    }
+}
+
+static const char* op_text(Op op){
+    switch(op){
+    case Op::Add: return "+";
+    case Op::Sub: return "-";
+    case Op::Mul: return "*";
+    case Op::Div: return "/";
+    case Op::Neg: return "-";
+    case Op::Abs: return "abs";
+    case Op::Min: return "min";
+    case Op::Max: return "max";
+    case Op::Lt: return "<";
+    case Op::Le: return "<=";
+    case Op::Gt: return ">";
+    case Op::Ge: return ">=";
+    case Op::Eq: return "==";
+    case Op::Ne: return "!=";
+    case Op::And: return " and ";
+    case Op::Or: return " or ";
+    case Op::Not: return "not ";
+    default: return "";
+    }
+}
+
+// -------- COMPILER --------
+// Recursive descent straight to instructions. Every value has a normalized
+// text; equal texts share a register, and operations on constants are
+// folded at compile time.
+namespace {
+
+struct Value {
+    uint16_t reg = 0;
+    bool condition = false;
+    bool constant = false;
+    double number = 0;
+    string text;
+};
+
+struct Token {
+    enum Kind { Number, Name, Symbol, End } kind = End;
+    string text;
+    double number = 0;
+    size_t column = 0;
+};
+
+class Compiler {
+public:
+    explicit Compiler(vector<Instr> &code) : code_(code) {}
+
+    Value compile(const string &source,const char *rule){
+        src_ = &source;
+        rule_ = rule;
+        pos_ = 0;
+        depth_ = 0;
+        if(source.size()>MAX_RULE_LENGTH) fail("longer than "+to_string(MAX_RULE_LENGTH)+" characters",string::npos);
+        advance();
+        if(tok_.kind==Token::End) fail("empty rule",string::npos);
+        Value v = parse_or();
+        if(tok_.kind!=Token::End) fail("unexpected '"+tok_.text+"'",tok_.column);
+        if(!v.condition) fail("must be a condition, not a number",string::npos);
+        return materialize(v);
+    }
+
+    size_t numbers() const { return numbers_; }
+    size_t conditions() const { return conditions_; }
+
+private:
+    [[noreturn]] void fail(const string &what,size_t column) const{
+        string where = column==string::npos ? "" : " at column "+to_string(column+1);
+        throw runtime_error(string("rules.")+rule_+": "+what+where);
+    }
+
+    // -------- lexer --------
+    void advance(){
+        const string &s = *src_;
+        while(pos_<s.size() && isspace(static_cast<unsigned char>(s[pos_]))) pos_++;
+        tok_ = Token();
+        tok_.column = pos_;
+        if(pos_>=s.size()) return;
+        char c = s[pos_];
+        if(isdigit(static_cast<unsigned char>(c)) || (c=='.' && pos_+1<s.size() && isdigit(static_cast<unsigned char>(s[pos_+1])))){
+            const char *begin = s.c_str()+pos_;
+            char *end = nullptr;
+            tok_.kind = Token::Number;
+            tok_.number = strtod(begin,&end);
+            tok_.text.assign(begin,static_cast<size_t>(end-begin));
+            pos_ += static_cast<size_t>(end-begin);
+            return;
+        }
+        if(isalpha(static_cast<unsigned char>(c)) || c=='_'){
+            size_t start = pos_;
+            while(pos_<s.size() && (isalnum(static_cast<unsigned char>(s[pos_])) || s[pos_]=='_')) pos_++;
+            tok_.kind = Token::Name;
+            tok_.text = s.substr(start,pos_-start);
+            transform(tok_.text.begin(),tok_.text.end(),tok_.text.begin(),[](unsigned char ch){ return tolower(ch); });
+            return;
+        }
+        static const char *TWO[] = {"<=", ">=", "==", "!=", "&&", "||"};
+        for(const char *t:TWO){
+            if(s.compare(pos_,2,t)==0){
+                tok_.kind = Token::Symbol;
+                tok_.text = t;
+                pos_ += 2;
+                return;
+            }
+        }
+        if(string("<>+-*/(),!").find(c)==string::npos) fail(string("unexpected '")+c+"'",pos_);
+        tok_.kind = Token::Symbol;
+        tok_.text = string(1,c);
+        pos_++;
+    }
+
+    bool accept(const char *text){
+        if(tok_.kind==Token::End || tok_.kind==Token::Number || tok_.text!=text) return false;
+        advance();
+        return true;
+    }
+
+    void expect(const char *text){
+        if(!accept(text)) fail(string("expected '")+text+"'",tok_.column);
+    }
+
+    // -------- grammar --------
+    // or > and > not > comparison > + - > * / > unary minus > primary
+    Value parse_or(){
+        Value v = parse_and();
+        for(size_t col=tok_.column; accept("or") || accept("||"); col=tok_.column) v = binary(Op::Or,v,parse_and(),col);
+        return v;
+    }
+
+    Value parse_and(){
+        Value v = parse_not();
+        for(size_t col=tok_.column; accept("and") || accept("&&"); col=tok_.column) v = binary(Op::And,v,parse_not(),col);
+        return v;
+    }
+
+    Value parse_not(){
+        size_t col = tok_.column;
+        if(accept("not") || accept("!")){
+            Nest nest(*this,col);
+            return unary(Op::Not,parse_not(),col);
+        }
+        return parse_comparison();
+    }
+
+    Value parse_comparison(){
+        Value v = parse_sum();
+        static const pair<const char*,Op> OPS[] = {
+            {"<=", Op::Le}, {">=", Op::Ge}, {"<", Op::Lt}, {">", Op::Gt}, {"==", Op::Eq}, {"!=", Op::Ne}
+        };
+        size_t col = tok_.column;
+        for(auto &op:OPS) if(accept(op.first)) return binary(op.second,v,parse_sum(),col);
+        return v;
+    }
+
+    Value parse_sum(){
+        Value v = parse_product();
+        while(true){
+            size_t col = tok_.column;
+            if(accept("+")) v = binary(Op::Add,v,parse_product(),col);
+            else if(accept("-")) v = binary(Op::Sub,v,parse_product(),col);
+            else return v;
+        }
+    }
+
+    Value parse_product(){
+        Value v = parse_unary();
+        while(true){
+            size_t col = tok_.column;
+            if(accept("*")) v = binary(Op::Mul,v,parse_unary(),col);
+            else if(accept("/")) v = binary(Op::Div,v,parse_unary(),col);
+            else return v;
+        }
+    }
+
+    Value parse_unary(){
+        size_t col = tok_.column;
+        if(accept("-")){
+            Nest nest(*this,col);
+            return unary(Op::Neg,parse_unary(),col);
+        }
+        if(accept("+")){
+            Nest nest(*this,col);
+            return number(parse_unary(),col);
+        }
+        return parse_primary();
+    }
+
+    Value parse_primary(){
+        Token t = tok_;
+        if(t.kind==Token::Number){
+            advance();
+            return constant(t.number,false);
+        }
+        if(accept("(")){
+            Nest nest(*this,t.column);
+            Value v = parse_or();
+            expect(")");
+            return v;
+        }
+        if(t.kind!=Token::Name) fail(t.kind==Token::End ? "unexpected end" : "unexpected '"+t.text+"'",t.column);
+        advance();
+        if(t.text=="true" || t.text=="false") return constant(t.text=="true" ? 1.0 : 0.0,true);
+        for(size_t i=0;i<COLUMN_COUNT;i++) if(t.text==COLUMNS[i].name) return load(i);
+        if(t.text=="cloud_top" || t.text=="cloud_bottom")
+            return binary(t.text=="cloud_top" ? Op::Max : Op::Min,load(3),load(4),t.column);
+        if(t.text=="abs" || t.text=="min" || t.text=="max"){
+            Nest nest(*this,t.column);
+            expect("(");
+            Value a = parse_or();
+            Value v;
+            if(t.text=="abs") v = unary(Op::Abs,a,t.column);
+            else {
+                expect(",");
+                v = binary(t.text=="min" ? Op::Min : Op::Max,a,parse_or(),t.column);
+            }
+            expect(")");
+            return v;
+        }
+        fail("unknown name '"+t.text+"'",t.column);
+    }
+
+    // Bounds recursion on deeply nested input.
+    struct Nest {
+        Compiler &c;
+        Nest(Compiler &compiler,size_t column) : c(compiler) {
+            if(++c.depth_>MAX_DEPTH) c.fail("nested too deeply",column);
+        }
+        ~Nest() { c.depth_--; }
+    };
+
+    // -------- code generation --------
+    static bool is_logic(Op op) { return op==Op::And || op==Op::Or || op==Op::Not; }
+    static bool is_comparison(Op op) { return op>=Op::Lt && op<=Op::Ne; }
+
+    Value number(Value v,size_t column){
+        if(v.condition) fail("expected a number, got a condition",column);
+        return v;
+    }
+
+    Value condition(Value v,size_t column){
+        if(!v.condition) fail("expected a condition, got a number",column);
+        return v;
+    }
+
+    Value constant(double value,bool is_condition){
+        Value v;
+        v.constant = true;
+        v.condition = is_condition;
+        v.number = value;
+        if(is_condition) v.text = value!=0 ? "true" : "false";
+        else {
+            char buf[32];
+            auto r = to_chars(buf,buf+sizeof(buf),value);
+            v.text.assign(buf,r.ptr);
+        }
+        return v;
+    }
+
+    Value load(size_t column){
+        Value v;
+        v.text = COLUMNS[column].name;
+        v.reg = emit(Op::Load,static_cast<uint16_t>(column),0,0,v.text,false);
+        return v;
+    }
+
+    Value unary(Op op,Value a,size_t column){
+        a = is_logic(op) ? condition(a,column) : number(a,column);
+        if(a.constant) return constant(scalar(op,a.number,0),is_logic(op));
+        Value v;
+        v.condition = is_logic(op);
+        v.text = op==Op::Abs ? "abs("+a.text+")" : string(op_text(op))+a.text;
+        v.reg = emit(op,a.reg,a.reg,0,v.text,v.condition);
+        return v;
+    }
+
+    Value binary(Op op,Value a,Value b,size_t column){
+        if(is_logic(op)){
+            a = condition(a,column);
+            b = condition(b,column);
+        } else {
+            a = number(a,column);
+            b = number(b,column);
+        }
+        bool result_condition = is_logic(op) || is_comparison(op);
+        if(a.constant && b.constant) return constant(scalar(op,a.number,b.number),result_condition);
+        a = materialize(a);
+        b = materialize(b);
+        Value v;
+        v.condition = result_condition;
+        if(op==Op::Min || op==Op::Max) v.text = string(op_text(op))+"("+a.text+","+b.text+")";
+        else v.text = "("+a.text+op_text(op)+b.text+")";
+        v.reg = emit(op,a.reg,b.reg,0,v.text,v.condition);
+        return v;
+    }
+
+    // Constants get a register only once they meet a column.
+    Value materialize(Value v){
+        if(v.constant) v.reg = emit(v.condition ? Op::Flag : Op::Const,0,0,v.number,"#"+v.text,v.condition);
+        return v;
+    }
+
+    uint16_t emit(Op op,uint16_t a,uint16_t b,double value,const string &text,bool condition){
+        auto it = registers_.find(text);
+        if(it!=registers_.end()) return it->second;
+        size_t &count = condition ? conditions_ : numbers_;
+        if(count>=MAX_REGISTERS) fail("too many operations",string::npos);
+        uint16_t dst = static_cast<uint16_t>(count++);
+        code_.push_back({op,dst,a,b,value});
+        registers_.emplace(text,dst);
+        return dst;
+    }
+
+    vector<Instr> &code_;
+    unordered_map<string,uint16_t> registers_;   // by normalized text
+    size_t numbers_ = 0, conditions_ = 0;
+    const string *src_ = nullptr;
+    const char *rule_ = "";
+    size_t pos_ = 0;
+    int depth_ = 0;
+    Token tok_;
+};
+
+}
+
+RuleSet::RuleSet(const string &long_entry,const string &long_exit,const string &short_entry,const string &short_exit){
+    const string *sources[] = {&long_entry, &long_exit, &short_entry, &short_exit};
+    Compiler compiler(code_);
+    for(RuleKind kind:RULE_KINDS){
+        size_t k = static_cast<size_t>(kind);
+        Value v = compiler.compile(*sources[k],rule_kind_name(kind));
+        outputs_[k] = v.reg;
+        key_ += (k ? ";" : "")+v.text;
+    }
+    numbers_ = compiler.numbers();
+    conditions_ = compiler.conditions();
+}
+
+// -------- EVALUATION --------
+// A block is 64 rows, so a condition is one word and and/or/not are single
+// word operations. Every number loop runs over a whole block, so the
+// compiler vectorizes them, compares included, without a remainder loop
+// even at -O2.
+template <class F>
+static void unary_loop(double *__restrict d,const double *a,F f){
+    for(size_t i=0;i<BLOCK;i++) d[i] = f(a[i]);
+}
+
+template <class F>
+static void binary_loop(double *__restrict d,const double *a,const double *b,F f){
+    for(size_t i=0;i<BLOCK;i++) d[i] = f(a[i],b[i]);
+}
+
+// A whole block of one column; the strided loads vectorize as shuffles.
+static void load_loop(double *__restrict d,const IchimokuRow *rows,double IchimokuRow::*field){
+    for(size_t i=0;i<BLOCK;i++) d[i] = rows[i].*field;
+}
+
+// Bit i of a word, as a table: selecting from it vectorizes to a compare
+// and a mask, where a shift by the lane index needs AVX2 and more work.
+struct BitTable {
+    uint64_t bit[BLOCK];
+    constexpr BitTable() : bit() { for(size_t i=0;i<BLOCK;i++) bit[i] = 1ULL<<i; }
+};
+static constexpr BitTable BITS;
+
+// Packs f(a[i], b[i]) into bit i.
+template <class F>
+static uint64_t compare_loop(const double *a,const double *b,F f){
+    uint64_t word = 0;
+    for(size_t i=0;i<BLOCK;i++) word |= f(a[i],b[i]) ? BITS.bit[i] : 0;
+    return word;
+}
+
+RuleSet::Registers RuleSet::registers() const{
+    return {pmr::vector<double>(numbers_*BLOCK,request_memory()),
+            pmr::vector<uint64_t>(conditions_,request_memory())};
+}
+
+// Built once more for AVX2 where the toolchain can pick a version by CPU at
+// load time: the block loops are twice as wide with it.
+#if defined(__x86_64__) && defined(__GNUC__) && defined(__linux__)
+__attribute__((target_clones("avx2","default")))
+#endif
+void RuleSet::evaluate(const IchimokuRow *rows,size_t n,Registers &regs,uint64_t out[4]) const{
+    size_t m = min(BLOCK,n);
+    auto num = [&](uint16_t r){ return regs.numbers.data()+static_cast<size_t>(r)*BLOCK; };
+    uint64_t *cond = regs.conditions.data();
+    for(const Instr &in:code_){
+        switch(in.op){
+        case Op::Load: {
+            // Rows past m keep stale values; their bits are masked below.
+            double *d = num(in.dst);
+            double IchimokuRow::*field = COLUMNS[in.a].field;
+            if(m==BLOCK) load_loop(d,rows,field);
+            else for(size_t i=0;i<m;i++) d[i] = rows[i].*field;
+            break;
+        }
+        case Op::Const: fill(num(in.dst),num(in.dst)+BLOCK,in.value); break;
+        case Op::Flag: cond[in.dst] = in.value!=0 ? ~0ULL : 0ULL; break;
+        case Op::Add: binary_loop(num(in.dst),num(in.a),num(in.b),[](double x,double y){ return x+y; }); break;
+        case Op::Sub: binary_loop(num(in.dst),num(in.a),num(in.b),[](double x,double y){ return x-y; }); break;
+        case Op::Mul: binary_loop(num(in.dst),num(in.a),num(in.b),[](double x,double y){ return x*y; }); break;
+        case Op::Div: binary_loop(num(in.dst),num(in.a),num(in.b),[](double x,double y){ return x/y; }); break;
+        case Op::Neg: unary_loop(num(in.dst),num(in.a),[](double x){ return -x; }); break;
+        case Op::Abs: unary_loop(num(in.dst),num(in.a),[](double x){ return fabs(x); }); break;
+        case Op::Min: binary_loop(num(in.dst),num(in.a),num(in.b),[](double x,double y){ return min(x,y); }); break;
+        case Op::Max: binary_loop(num(in.dst),num(in.a),num(in.b),[](double x,double y){ return max(x,y); }); break;
+        case Op::Lt: cond[in.dst] = compare_loop(num(in.a),num(in.b),[](double x,double y){ return x<y; }); break;
+        case Op::Le: cond[in.dst] = compare_loop(num(in.a),num(in.b),[](double x,double y){ return x<=y; }); break;
+        case Op::Gt: cond[in.dst] = compare_loop(num(in.a),num(in.b),[](double x,double y){ return x>y; }); break;
+        case Op::Ge: cond[in.dst] = compare_loop(num(in.a),num(in.b),[](double x,double y){ return x>=y; }); break;
+        case Op::Eq: cond[in.dst] = compare_loop(num(in.a),num(in.b),[](double x,double y){ return x==y; }); break;
+        case Op::Ne: cond[in.dst] = compare_loop(num(in.a),num(in.b),[](double x,double y){ return x!=y; }); break;
+        case Op::And: cond[in.dst] = cond[in.a] & cond[in.b]; break;
+        case Op::Or: cond[in.dst] = cond[in.a] | cond[in.b]; break;
+        case Op::Not: cond[in.dst] = ~cond[in.a]; break;
+        }
+    }
+    uint64_t valid = m==BLOCK ? ~0ULL : (1ULL<<m)-1;
+    for(size_t k=0;k<4;k++) out[k] = cond[outputs_[k]]&valid;
+}
+
+shared_ptr<const RuleSet> rule_set_from_json(const json &data){
+    if(!data.contains("rules")) return nullptr;
+    const json &rules = data["rules"];
+    if(!rules.is_object()) throw runtime_error("rules must be an object with long_entry, long_exit, short_entry and/or short_exit");
+    for(auto it=rules.begin();it!=rules.end();++it){
+        bool known = false;
+        for(RuleKind kind:RULE_KINDS) known = known || it.key()==rule_kind_name(kind);
+        if(!known) throw runtime_error("rules: unknown rule '"+it.key()+"'");
+        if(!it->is_string()) throw runtime_error("rules."+it.key()+" must be a string");
+    }
+    auto text = [&](RuleKind kind){
+        const char *name = rule_kind_name(kind);
+        return rules.contains(name) ? rules[name].get<string>() : string(default_rule(kind));
+    };
+    auto set = make_shared<const RuleSet>(text(RuleKind::LongEntry),text(RuleKind::LongExit),
+                                          text(RuleKind::ShortEntry),text(RuleKind::ShortExit));
+    // Rules that normalize to the defaults are the built-in strategy, which
+    // run_strategy runs faster than the register program.
+    static const string default_key = RuleSet(default_rule(RuleKind::LongEntry),default_rule(RuleKind::LongExit),
+                                              default_rule(RuleKind::ShortEntry),default_rule(RuleKind::ShortExit)).key();
+    return set->key()==default_key ? nullptr : set;
+}
+
+vector<Trade> run_rules(const vector<IchimokuRow> &rows,const RuleSet &rules){
+    vector<Trade> trades;
+    size_t n = rows.size();
+    if(n==0) return trades;
+    RuleSet::Registers regs = rules.registers();
+
+    // StrategyRunner::apply's position handling, run on each block of rows
+    // as soon as its rules are evaluated. Only the open side's exit, or
+    // exactly one entry while flat, can act, so each step jumps to the next
+    // such row in the word. Positions flip unpredictably, so a step has no
+    // branches: the position is kept as all-ones/zero masks that select the
+    // bits that act next, selections go through two-element arrays, and
+    // every step writes a slot in `closed` that is only kept when a position
+    // closed. A block steps at most 64 times, so the slots are appended to
+    // the result once per block. Room for a trade every other row is
+    // reserved up front, which covers even choppy series, and a mostly
+    // empty result is shrunk at the end.
+    uint64_t in_long = 0, in_short = 0;
+    int64_t entry_time = 0;
+    double entry_price = 0;
+    Trade closed[BLOCK];
+    size_t count = 0;
+    trades.reserve(n/2+1);
+    auto step = [&](size_t i,uint64_t open_long,uint64_t open_short){
+        const IchimokuRow &row = rows[i];
+        Trade &t = closed[count];
+        t.entry_time = entry_time;
+        t.entry_price = entry_price;
+        t.exit_time = row.brick_time;
+        t.exit_price = row.close;
+        t.direction = static_cast<TradeDirection>(in_short&1);
+        const double profit[2] = {row.close-entry_price, entry_price-row.close};
+        t.profit = profit[in_short&1];
+        count += (in_long|in_short)&1;
+        uint64_t entry = open_long|open_short;
+        const int64_t time[2] = {entry_time, row.brick_time};
+        const double price[2] = {entry_price, row.close};
+        entry_time = time[entry];
+        entry_price = price[entry];
+        in_long = 0-open_long;
+        in_short = 0-open_short;
+    };
+    uint64_t sets[4];
+    for(size_t start=0;start<n;start+=BLOCK){
+        rules.evaluate(rows.data()+start,n-start,regs,sets);
+        uint64_t long_entry = sets[static_cast<size_t>(RuleKind::LongEntry)];
+        uint64_t short_entry = sets[static_cast<size_t>(RuleKind::ShortEntry)];
+        uint64_t open_long = long_entry&~short_entry, open_short = short_entry&~long_entry;
+        uint64_t entry = open_long|open_short;
+        uint64_t long_exit = sets[static_cast<size_t>(RuleKind::LongExit)];
+        uint64_t short_exit = sets[static_cast<size_t>(RuleKind::ShortExit)];
+        // Bits past n are clear; row 0 only primes.
+        for(uint64_t rest = start==0 ? ~1ULL : ~0ULL;;){
+            uint64_t word = ((long_exit&in_long)|(short_exit&in_short)|(entry&~(in_long|in_short)))&rest;
+            if(word==0) break;
+            int b = __builtin_ctzll(word);
+            rest = ~1ULL<<b;
+            step(start+static_cast<size_t>(b),(open_long>>b)&1,(open_short>>b)&1);
+        }
+        trades.insert(trades.end(),closed,closed+count);
+        count = 0;
+    }
+    // The last row closes what is still open; nothing opens after it.
+    step(n-1,0,0);
+    trades.insert(trades.end(),closed,closed+count);
+    if(trades.size()<trades.capacity()/2) trades.shrink_to_fit();
+    return trades;
+}
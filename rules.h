@@ -0,0 +1,88 @@
+#pragma once
+
+#include "strategy.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+// Entry and exit rules written as expressions over the Ichimoku columns:
+//
+//   columns   close tenkan kijun span_a span_b chikou
+//             cloud_top cloud_bottom (max and min of the spans)
+//   numbers   40  1.5  2e-3
+//   math      + - * /  abs(x)  min(a, b)  max(a, b)
+//   compare   < <= > >= == !=
+//   logic     and or not (or && || !), true, false
+//
+// A comparison with NaN is false, as in the built-in rules. The four rules
+// are compiled together into one register program: each instruction runs
+// over a block of 64 rows, so the inner loops are fixed-length array loops
+// the compiler vectorizes, and subexpressions shared between rules (say
+// cloud_top) are computed once. As each block is evaluated its positions
+// are resolved as in StrategyRunner::apply, visiting only the rows where a
+// rule that matters for the current position fires.
+enum class RuleKind { LongEntry, LongExit, ShortEntry, ShortExit };
+
+// "long_entry", "long_exit", "short_entry" or "short_exit".
+const char* rule_kind_name(RuleKind kind);
+
+// The rule run_strategy hard-codes.
+const char* default_rule(RuleKind kind);
+
+class RuleSet {
+public:
+    // Throws std::runtime_error naming the rule and column of the problem.
+    RuleSet(const std::string &long_entry, const std::string &long_exit,
+            const std::string &short_entry, const std::string &short_exit);
+
+    // The rules in a normalized form: same key, same trades.
+    const std::string& key() const { return key_; }
+
+    // Register files for evaluate(), from request_memory().
+    struct Registers {
+        std::pmr::vector<double> numbers;
+        std::pmr::vector<uint64_t> conditions;
+    };
+    Registers registers() const;
+
+    // Rule outcomes for the first min(n, 64) rows, one word per RuleKind:
+    // bit r is set when the rule fires on rows[r]; higher bits are clear.
+    void evaluate(const IchimokuRow *rows, size_t n, Registers &regs, uint64_t out[4]) const;
+
+    enum class Op : uint8_t {
+        Load, Const, Flag, Add, Sub, Mul, Div, Neg, Abs, Min, Max,
+        Lt, Le, Gt, Ge, Eq, Ne, And, Or, Not
+    };
+
+    // dst = op(a, b). Numbers and conditions have separate register files:
+    // comparisons read numbers and write conditions, a bit per row, so
+    // and/or/not take one word operation per 64 rows. Load reads column `a`; Const (a
+    // number) and Flag (a condition) broadcast `value`.
+    struct Instr {
+        Op op;
+        uint16_t dst, a, b;
+        double value;
+    };
+
+private:
+    std::vector<Instr> code_;
+    size_t numbers_ = 0, conditions_ = 0;   // registers of each kind
+    uint16_t outputs_[4] = {};   // by RuleKind
+    std::string key_;
+};
+
+// "rules": {"long_entry", "long_exit", "short_entry", "short_exit"}; a rule
+// left out keeps its default. Null when the field is absent or the rules
+// normalize to the defaults, so callers run run_strategy instead.
+// Throws std::runtime_error on invalid rules.
+std::shared_ptr<const RuleSet> rule_set_from_json(const nlohmann::json &data);
+
+// run_strategy with these rules in place of the built-in ones, with
+// StrategyRunner::apply's one-position handling.
+std::vector<Trade> run_rules(const std::vector<IchimokuRow> &rows, const RuleSet &rules);
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <atomic>
+#include <stdexcept>
+
+struct BacktestCancelled : std::runtime_error {
+    BacktestCancelled() : std::runtime_error("Cancelled") {}
+};
+
+// Progress and cancellation shared between a running backtest and whoever
+// started it. Long stages call check() at safe points; a cancelled run
+// unwinds with BacktestCancelled.
+class RunControl {
+public:
+    void cancel() { cancelled_ = true; }
+    bool cancelled() const { return cancelled_.load(); }
+    void check() const { if(cancelled()) throw BacktestCancelled(); }
+
+    // `stage` must point at a string literal.
+    void set_progress(double fraction, const char *stage){
+        progress_ = fraction;
+        stage_ = stage;
+    }
+    void set_progress(double fraction) { progress_ = fraction; }
+    double progress() const { return progress_.load(); }
+    const char* stage() const { return stage_.load(); }
+
+private:
+    std::atomic<bool> cancelled_{false};
+    std::atomic<double> progress_{0.0};
+    std::atomic<const char*> stage_{"queued"};
+};
@@ -0,0 +1,186 @@
+#include "session.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+
+using json = nlohmann::json;
+using namespace std;
+
+SessionConfig session_config_from_json(const json &data){
+    SessionConfig c;
+    c.symbol = data.value("symbol", "ETHUSDT");
+    c.resolution = data.value("resolution", "5m");
+    c.brick_size = data.value("brick_size", 40.0);
+    c.reversal_size = data.value("reversal_size", 80.0);
+    c.source_type = data.value("source_type", "ohlc4");
+    c.tenkan = data.value("tenkan", 5);
+    c.kijun = data.value("kijun", 26);
+    c.span_b = data.value("span_b", 52);
+    if(!(c.brick_size>0) || !(c.reversal_size>0)) throw runtime_error("brick_size and reversal_size must be positive");
+    parse_source_type(c.source_type);   // throws on unsupported sources
+    return c;
+}
+
+vector<Candle> candles_from_json(const json &rows){
+    if(!rows.is_array()) throw runtime_error("candles must be an array");
+    vector<Candle> out;
+    out.reserve(rows.size());
+    auto num = [](const json &v){ return v.is_number() ? v.get<double>() : 0.0; };
+    for(auto &r:rows){
+        if(r.is_array() && r.size()>=5){
+            Candle c{r[0].get<int64_t>(), num(r[1]), num(r[2]), num(r[3]), num(r[4]), r.size()>5 ? num(r[5]) : 0.0};
+            if(c.open==0 && c.high==0 && c.low==0 && c.close==0) continue;
+            out.push_back(c);
+        }else if(r.is_object()){
+            auto get = [&](const char *k){ return r.contains(k) ? num(r[k]) : 0.0; };
+            out.push_back({r.value("time", int64_t(0)), get("open"), get("high"), get("low"), get("close"), get("volume")});
+        }
+    }
+    sort(out.begin(),out.end(),[](const Candle &a,const Candle &b){ return a.time<b.time; });
+    return out;
+}
+
+// -------- LiveSession --------
+LiveSession::LiveSession(string id,SessionConfig config)
+    : id_(move(id)), config_(move(config)),
+      source_(parse_source_type(config_.source_type)),
+      renko_(config_.brick_size,config_.reversal_size),
+      ichimoku_(config_.tenkan,config_.kijun,config_.span_b,26) {}
+
+int64_t LiveSession::last_candle_time() const{
+    lock_guard<mutex> lk(mu_);
+    return last_candle_time_;
+}
+
+LiveSession::AppendResult LiveSession::append(const vector<Candle> &candles){
+    lock_guard<mutex> lk(mu_);
+    AppendResult r;
+    auto on_trade = [&](const Trade &t){
+        summary_.add(t.profit);
+        recent_trades_.push_back(t);
+        if(recent_trades_.size()>KEEP_RECENT) recent_trades_.pop_front();
+        r.trades++;
+    };
+    auto on_brick = [&](const RenkoBrick &b){
+        last_row_ = ichimoku_.push(b.brick_time,b.close);
+        strategy_.step(last_row_,on_trade);
+        recent_bricks_.push_back(b);
+        if(recent_bricks_.size()>KEEP_RECENT) recent_bricks_.pop_front();
+        bricks_++;
+        r.bricks++;
+    };
+    for(auto &c:candles){
+        if(candles_>0 && c.time<=last_candle_time_) continue;
+        renko_.push(c,get_source_price(c,source_),on_brick);
+        last_candle_time_ = c.time;
+        candles_++;
+        r.candles++;
+    }
+    return r;
+}
+
+static json brick_to_json(const RenkoBrick &b){
+    return {{"brick_time", epoch_to_ist_iso(b.brick_time)}, {"open", b.open}, {"high", b.high},
+            {"low", b.low}, {"close", b.close}, {"dir", b.dir}, {"reversal", b.reversal}};
+}
+
+static json trade_to_json(const Trade &t){
+    return {{"entry_time", epoch_to_ist_iso(t.entry_time)}, {"entry_price", t.entry_price},
+            {"exit_time", epoch_to_ist_iso(t.exit_time)}, {"exit_price", t.exit_price},
+            {"direction", trade_direction_name(t.direction)}, {"profit", t.profit}};
+}
+
+json LiveSession::state(size_t recent) const{
+    lock_guard<mutex> lk(mu_);
+    json position = nullptr;
+    if(strategy_.in_long() || strategy_.in_short()){
+        const Trade &t = strategy_.open_trade();
+        double unrealized = strategy_.in_long() ? last_row_.close - t.entry_price : t.entry_price - last_row_.close;
+        position = {{"direction", trade_direction_name(t.direction)}, {"entry_time", epoch_to_ist_iso(t.entry_time)},
+                    {"entry_price", t.entry_price}, {"unrealized_profit", unrealized}};
+    }
+    json ichimoku = nullptr;
+    if(bricks_>0){
+        // NaN (window still filling) serialises as null.
+        ichimoku = {{"brick_time", epoch_to_ist_iso(last_row_.brick_time)}, {"close", last_row_.close},
+                    {"tenkan", last_row_.tenkan}, {"kijun", last_row_.kijun}, {"span_a", last_row_.span_a},
+                    {"span_b", last_row_.span_b}, {"chikou", last_row_.chikou}};
+    }
+    json bricks = json::array(), trades = json::array();
+    size_t nb = min(recent,recent_bricks_.size()), nt = min(recent,recent_trades_.size());
+    for(size_t i=recent_bricks_.size()-nb;i<recent_bricks_.size();i++) bricks.push_back(brick_to_json(recent_bricks_[i]));
+    for(size_t i=recent_trades_.size()-nt;i<recent_trades_.size();i++) trades.push_back(trade_to_json(recent_trades_[i]));
+
+    return {
+        {"session_id", id_},
+        {"symbol", config_.symbol},
+        {"resolution", config_.resolution},
+        {"params", {{"brick_size", config_.brick_size}, {"reversal_size", config_.reversal_size},
+                    {"source_type", config_.source_type}, {"tenkan", config_.tenkan},
+                    {"kijun", config_.kijun}, {"span_b", config_.span_b}}},
+        {"candles", candles_},
+        {"bricks", bricks_},
+        {"last_candle_time", candles_ ? json(epoch_to_ist_iso(last_candle_time_)) : json(nullptr)},
+        {"renko", {{"last_price", renko_.last_price()}, {"last_dir", renko_.last_dir()},
+                   {"trend_start_time", candles_ ? json(epoch_to_ist_iso(renko_.trend_start_time())) : json(nullptr)}}},
+        {"ichimoku", ichimoku},
+        {"position", position},
+        {"summary", {{"total_trades", summary_.total_trades},
+                     {"net_profit", round(summary_.total_profit*100.0)/100.0},
+                     {"winning_trades", summary_.winning_trades},
+                     {"losing_trades", summary_.losing_trades},
+                     {"max_drawdown", summary_.max_drawdown}}},
+        {"recent_bricks", bricks},
+        {"recent_trades", trades}
+    };
+}
+
+// -------- SessionManager --------
+static string new_session_id(){
+    static mutex mu;
+    static mt19937_64 rng(random_device{}());
+    lock_guard<mutex> lk(mu);
+    char buf[17];
+    snprintf(buf,sizeof(buf),"%016llx",static_cast<unsigned long long>(rng()));
+    return buf;
+}
+
+shared_ptr<LiveSession> SessionManager::create(const SessionConfig &config){
+    lock_guard<mutex> lk(mu_);
+    auto now = Clock::now();
+    prune_locked(now);
+    if(sessions_.size()>=max_sessions_) throw runtime_error("Too many live sessions (limit "+to_string(max_sessions_)+")");
+    string id;
+    do { id = new_session_id(); } while(sessions_.count(id));
+    auto s = make_shared<LiveSession>(id,config);
+    sessions_.emplace(id,Entry{s,now});
+    return s;
+}
+
+shared_ptr<LiveSession> SessionManager::get(const string &id){
+    lock_guard<mutex> lk(mu_);
+    auto it = sessions_.find(id);
+    if(it==sessions_.end()) return nullptr;
+    auto now = Clock::now();
+    if(now-it->second.last_used>idle_ttl_){
+        sessions_.erase(it);
+        return nullptr;
+    }
+    it->second.last_used = now;
+    return it->second.session;
+}
+
+bool SessionManager::remove(const string &id){
+    lock_guard<mutex> lk(mu_);
+    return sessions_.erase(id)>0;
+}
+
+void SessionManager::prune_locked(Clock::time_point now){
+    for(auto it=sessions_.begin();it!=sessions_.end();){
+        if(now-it->second.last_used>idle_ttl_) it = sessions_.erase(it);
+        else ++it;
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "ichimoku.h"
+#include "strategy.h"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+// Live strategy sessions.
+//
+// A session keeps the Renko builder, the rolling Ichimoku windows and the
+// position state in memory, so appending candles costs O(new bricks)
+// instead of replaying the whole history.
+struct SessionConfig {
+    std::string symbol = "ETHUSDT";
+    std::string resolution = "5m";
+    double brick_size = 40.0;
+    double reversal_size = 80.0;
+    std::string source_type = "ohlc4";
+    int tenkan = 5, kijun = 26, span_b = 52;
+};
+
+// Same parameter names and defaults as POST /backtest.
+SessionConfig session_config_from_json(const nlohmann::json &data);
+
+// Rows of a {"candles": [...]} body, as [time, o, h, l, c, v?] or objects.
+std::vector<Candle> candles_from_json(const nlohmann::json &rows);
+
+class LiveSession {
+public:
+    struct AppendResult {
+        size_t candles = 0, bricks = 0, trades = 0;
+    };
+
+    LiveSession(std::string id, SessionConfig config);
+
+    // Candles at or before the last one already seen are ignored.
+    AppendResult append(const std::vector<Candle> &candles);
+
+    nlohmann::json state(size_t recent) const;
+
+    const std::string& id() const { return id_; }
+    const SessionConfig& config() const { return config_; }
+    int64_t last_candle_time() const;
+
+private:
+    static const size_t KEEP_RECENT = 500;
+
+    mutable std::mutex mu_;
+    std::string id_;
+    SessionConfig config_;
+    SourceType source_;
+    RenkoBuilder renko_;
+    IchimokuEngine ichimoku_;
+    StrategyRunner strategy_;
+    TradeSummary summary_;
+    IchimokuRow last_row_{};
+    size_t candles_ = 0, bricks_ = 0;
+    int64_t last_candle_time_ = 0;
+    std::deque<RenkoBrick> recent_bricks_;
+    std::deque<Trade> recent_trades_;
+};
+
+// Sessions left idle for longer than the TTL are dropped, checked lazily on
+// create() and get().
+class SessionManager {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit SessionManager(size_t max_sessions = 256, std::chrono::seconds idle_ttl = std::chrono::hours(1))
+        : max_sessions_(max_sessions), idle_ttl_(idle_ttl) {}
+
+    // Throws std::runtime_error when the session limit is reached.
+    std::shared_ptr<LiveSession> create(const SessionConfig &config);
+    // Counts as a use and restarts the session's idle time.
+    std::shared_ptr<LiveSession> get(const std::string &id);
+    bool remove(const std::string &id);
+
+private:
+    struct Entry {
+        std::shared_ptr<LiveSession> session;
+        Clock::time_point last_used;
+    };
+
+    void prune_locked(Clock::time_point now);
+
+    size_t max_sessions_;
+    std::chrono::seconds idle_ttl_;
+    std::mutex mu_;
+    std::map<std::string, Entry> sessions_;
+};
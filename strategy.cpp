@@ -0,0 +1,234 @@
+#include "strategy.h"
+#include "export_writer.h"
+#include "ichimoku.h"
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+
+using namespace std;
+
+// ======================
+// COPY EXACTLY FROM strategyinc.cpp (START)
+// ======================
+
+// -------- UTILITY FUNCTIONS --------
+int64_t ist_to_unix(const string &date_str, const string &with_time){
+    tm tm{};
+    string dt = date_str + " " + with_time;
+    istringstream ss(dt);
+    ss >> get_time(&tm, "%Y-%m-%d %H:%M:%S");
+#if defined(_WIN32)
+    time_t epoch = _mkgmtime(&tm);
+#else
+    time_t epoch = timegm(&tm);
+#endif
+    const int IST_OFFSET = 5*3600 + 30*60;
+    return static_cast<int64_t>(epoch) - IST_OFFSET;
+}
+
+int resolution_seconds(const string &res){
+    string s = res; for(auto &c:s) c = tolower(c);
+    if(!s.empty() && s.back()=='m') return stoi(s.substr(0,s.size()-1))*60;
+    if(!s.empty() && s.back()=='h') return stoi(s.substr(0,s.size()-1))*3600;
+    if(!s.empty() && s.back()=='d') return stoi(s.substr(0,s.size()-1))*86400;
+    return 60;
+}
+
+string epoch_to_ist_iso(int64_t epoch_sec){
+    const int IST_OFFSET = 5*3600+30*60;
+    time_t t = static_cast<time_t>(epoch_sec+IST_OFFSET);
+    tm tm{};
+#if defined(_WIN32)
+    gmtime_s(&tm,&t);
+#else
+    gmtime_r(&t,&tm);
+#endif
+    char buf[64];
+    strftime(buf,sizeof(buf),"%Y-%m-%dT%H:%M:%S",&tm);
+    return string(buf);
+}
+
+void CandleColumns::reserve(size_t n){
+    time.reserve(n); open.reserve(n); high.reserve(n);
+    low.reserve(n); close.reserve(n); volume.reserve(n);
+}
+
+void CandleColumns::resize(size_t n){
+    time.resize(n); open.resize(n); high.resize(n);
+    low.resize(n); close.resize(n); volume.resize(n);
+}
+
+const char* trade_direction_name(TradeDirection direction){
+    return direction==TradeDirection::Long ? "long" : "short";
+}
+
+SourceType parse_source_type(const string &source){
+    string s = source; for(auto &ch:s) ch = tolower(ch);
+    if(s=="close") return SourceType::Close;
+    if(s=="open") return SourceType::Open;
+    if(s=="high") return SourceType::High;
+    if(s=="low") return SourceType::Low;
+    if(s=="hl2") return SourceType::HL2;
+    if(s=="hlc3") return SourceType::HLC3;
+    if(s=="ohlc4") return SourceType::OHLC4;
+    throw runtime_error("Unsupported source type: "+source);
+}
+
+const char* source_type_name(SourceType source){
+    switch(source){
+    case SourceType::Close: return "close";
+    case SourceType::Open: return "open";
+    case SourceType::High: return "high";
+    case SourceType::Low: return "low";
+    case SourceType::HL2: return "hl2";
+    case SourceType::HLC3: return "hlc3";
+    case SourceType::OHLC4: return "ohlc4";
+    }
+    return "unknown";
+}
+
+// Calls `f` with the source as a compile-time constant.
+template <class F>
+static decltype(auto) with_source(SourceType source,F &&f){
+    switch(source){
+    case SourceType::Close: return f(integral_constant<SourceType,SourceType::Close>{});
+    case SourceType::Open: return f(integral_constant<SourceType,SourceType::Open>{});
+    case SourceType::High: return f(integral_constant<SourceType,SourceType::High>{});
+    case SourceType::Low: return f(integral_constant<SourceType,SourceType::Low>{});
+    case SourceType::HL2: return f(integral_constant<SourceType,SourceType::HL2>{});
+    case SourceType::HLC3: return f(integral_constant<SourceType,SourceType::HLC3>{});
+    case SourceType::OHLC4: break;
+    }
+    return f(integral_constant<SourceType,SourceType::OHLC4>{});
+}
+
+double get_source_price(const Candle &c,SourceType source){
+    return with_source(source,[&](auto s){ return source_price<decltype(s)::value>(c.open,c.high,c.low,c.close); });
+}
+
+double get_source_price(const Candle &c, const string &source){
+    return get_source_price(c,parse_source_type(source));
+}
+
+// Row access for the brick loop, over either candle layout.
+struct CandleRows {
+    const Candle *c;
+    int64_t time(size_t i) const { return c[i].time; }
+    template <SourceType S> double price(size_t i) const { return source_price<S>(c[i].open,c[i].high,c[i].low,c[i].close); }
+    RenkoSource ohlc(size_t i) const { return {c[i].open,c[i].high,c[i].low,c[i].close}; }
+};
+
+struct ColumnRows {
+    const int64_t *t;
+    const double *o, *h, *l, *c;
+    int64_t time(size_t i) const { return t[i]; }
+    template <SourceType S> double price(size_t i) const { return source_price<S>(o[i],h[i],l[i],c[i]); }
+    RenkoSource ohlc(size_t i) const { return {o[i],h[i],l[i],c[i]}; }
+};
+
+// One instantiation per (layout, source): only the columns the source reads
+// are loaded and the price formula is inlined into the loop.
+template <SourceType S,class Rows>
+static vector<RenkoBrick> renko_loop(const Rows &rows,size_t n,double brick_size,double reversal_size,vector<RenkoSource> *sources){
+    vector<RenkoBrick> bricks;
+    if(sources) sources->clear();
+    RenkoBuilder builder(brick_size,reversal_size);
+    for(size_t i=0;i<n;i++){
+        builder.push(rows.time(i),rows.template price<S>(i),[&](const RenkoBrick &b){
+            bricks.push_back(b);
+            if(sources) sources->push_back(rows.ohlc(i));
+        });
+    }
+    return bricks;
+}
+
+vector<RenkoBrick> build_renko(const vector<Candle> &candles,double brick_size,double reversal_size,SourceType source,vector<RenkoSource> *sources){
+    CandleRows rows{candles.data()};
+    return with_source(source,[&](auto s){
+        return renko_loop<decltype(s)::value>(rows,candles.size(),brick_size,reversal_size,sources);
+    });
+}
+
+vector<RenkoBrick> build_renko(const CandleColumns &candles,double brick_size,double reversal_size,SourceType source,vector<RenkoSource> *sources){
+    ColumnRows rows{candles.time.data(),candles.open.data(),candles.high.data(),candles.low.data(),candles.close.data()};
+    return with_source(source,[&](auto s){
+        return renko_loop<decltype(s)::value>(rows,candles.size(),brick_size,reversal_size,sources);
+    });
+}
+
+vector<RenkoBrick> build_renko(const vector<Candle> &candles,double brick_size,double reversal_size,const string &source){
+    return build_renko(candles,brick_size,reversal_size,parse_source_type(source));
+}
+
+vector<double> donchian_mid(const vector<double> &series,int length){
+    vector<double> out(series.size());
+    donchian_mid(series.data(),series.size(),length,out.data());
+    return out;
+}
+
+void donchian_mid(const double *series,size_t n,int length,double *out){
+    fill(out,out+n,numeric_limits<double>::quiet_NaN());
+    if(length<=0) return;
+    RollingMinMax window(length);
+    for(size_t i=0;i<n;i++){
+        window.push(series[i]);
+        if(window.ready()) out[i]=window.mid();
+    }
+}
+
+vector<IchimokuRow> ichimoku_on_renko(const vector<RenkoBrick> &renko,int tenkan_len,int kijun_len,int span_b_len,int displacement){
+    vector<IchimokuRow> rows;
+    rows.reserve(renko.size());
+    IchimokuEngine engine(tenkan_len,kijun_len,span_b_len,displacement);
+    for(auto &brick:renko) rows.push_back(engine.push(brick.brick_time,brick.close));
+    return rows;
+}
+
+vector<Trade> run_strategy(const vector<IchimokuRow> &ri){
+    vector<Trade> trades;
+    StrategyRunner runner;
+    auto keep = [&](const Trade &t){ trades.push_back(t); };
+    for(auto &row:ri) runner.step(row,keep);
+    if(!ri.empty()) runner.finish(ri.back().brick_time,ri.back().close,keep);
+    return trades;
+}
+
+TradeSummary summarize_trades(const vector<Trade> &trades){
+    TradeSummary s;
+    for(auto &t:trades) s.add(t.profit);
+    return s;
+}
+
+// -------- IN-MEMORY CSV GENERATORS (instead of file writes) --------
+// Formatted by the export writers; the output is unchanged byte for byte.
+template <class Write>
+static string csv_string(size_t size_hint,Write write){
+    string s;
+    s.reserve(size_hint);
+    ChunkWriter out([&s](const char *data,size_t size){ s.append(data,size); },min(size_hint,ChunkWriter::DEFAULT_CAPACITY));
+    write(out);
+    out.flush();
+    return s;
+}
+
+string renko_to_csv_string(const vector<RenkoBrick> &rows){
+    return csv_string(64+rows.size()*72,[&](ChunkWriter &out){ write_renko_csv(out,rows); });
+}
+
+string trades_to_csv_string(const vector<Trade> &trades){
+    return csv_string(64+trades.size()*72,[&](ChunkWriter &out){ write_trades_csv(out,trades); });
+}
+
+string summary_to_csv_string(const vector<Trade> &trades){
+    return csv_string(128,[&](ChunkWriter &out){ write_summary_csv(out,trades); });
+}
+
+// ======================
+// COPY FROM strategyinc.cpp (END)
+// ======================
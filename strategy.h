@@ -0,0 +1,260 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// -------- STRUCTS --------
+struct Candle {
+    int64_t time;
+    double open, high, low, close, volume;
+};
+
+// Candles stored column by column, the layout of the candle store segments.
+struct CandleColumns {
+    std::vector<int64_t> time;
+    std::vector<double> open, high, low, close, volume;
+
+    size_t size() const { return time.size(); }
+    void reserve(size_t n);
+    void resize(size_t n);
+};
+
+struct RenkoBrick {
+    int64_t brick_time, brick_start_time;
+    double open, high, low, close;
+    int dir;
+    bool reversal;
+};
+
+// OHLC of the candle that completed a brick. Only a few consumers want it,
+// so it is kept beside the bricks (same index) rather than in every brick.
+struct RenkoSource {
+    double open, high, low, close;
+};
+
+struct IchimokuRow {
+    int64_t brick_time;
+    double close;
+    double tenkan, kijun, span_a, span_b, chikou;
+};
+
+enum class TradeDirection : uint8_t { Long, Short };
+
+// "long" or "short", as in the trade exports.
+const char* trade_direction_name(TradeDirection direction);
+
+struct Trade {
+    int64_t entry_time;
+    double entry_price;
+    int64_t exit_time;
+    double exit_price;
+    TradeDirection direction;
+    double profit;
+};
+
+// -------- UTILITY FUNCTIONS --------
+int64_t ist_to_unix(const std::string &date_str, const std::string &with_time = "00:00:00");
+int resolution_seconds(const std::string &res);
+std::string epoch_to_ist_iso(int64_t epoch_sec);
+
+// Price a Renko series is built from. Parsed once per request so the brick
+// loop is specialized per source instead of comparing strings per candle.
+enum class SourceType { Close, Open, High, Low, HL2, HLC3, OHLC4 };
+
+// Case-insensitive; throws on unsupported sources.
+SourceType parse_source_type(const std::string &source);
+const char* source_type_name(SourceType source);
+
+template <SourceType S>
+inline double source_price(double o, double h, double l, double c){
+    if constexpr(S==SourceType::Close) return c;
+    else if constexpr(S==SourceType::Open) return o;
+    else if constexpr(S==SourceType::High) return h;
+    else if constexpr(S==SourceType::Low) return l;
+    else if constexpr(S==SourceType::HL2) return (h+l)/2.0;
+    else if constexpr(S==SourceType::HLC3) return (h+l+c)/3.0;
+    else return (o+h+l+c)/4.0;
+}
+
+double get_source_price(const Candle &c, SourceType source);
+double get_source_price(const Candle &c, const std::string &source);
+
+// -------- PIPELINE --------
+// `sources`, when given, receives the completing candle of every brick.
+std::vector<RenkoBrick> build_renko(const std::vector<Candle> &candles, double brick_size, double reversal_size, SourceType source, std::vector<RenkoSource> *sources = nullptr);
+std::vector<RenkoBrick> build_renko(const CandleColumns &candles, double brick_size, double reversal_size, SourceType source, std::vector<RenkoSource> *sources = nullptr);
+std::vector<RenkoBrick> build_renko(const std::vector<Candle> &candles, double brick_size, double reversal_size, const std::string &source);
+
+// Resumable Renko construction: candles are pushed in time order and every
+// brick they complete is handed to `on_brick`, so a series can be extended
+// without replaying its history.
+class RenkoBuilder {
+public:
+    RenkoBuilder(double brick_size, double reversal_size)
+        : brick_size_(brick_size), reversal_size_(reversal_size) {}
+
+    template <class OnBrick>
+    void push(const Candle &candle, double price, OnBrick &&on_brick){
+        push(candle.time, price, on_brick);
+    }
+
+    template <class OnBrick>
+    void push(int64_t ts, double price, OnBrick &&on_brick){
+        if(std::isnan(last_price_)){ last_price_=price; trend_start_time_=ts; return; }
+        bool progressed=true;
+        while(progressed){
+            progressed=false;
+            if(last_dir_==0){
+                double diff = price-last_price_;
+                if(std::fabs(diff)>=brick_size_){
+                    int dir = diff>0?1:-1;
+                    double new_close = last_price_ + dir*brick_size_;
+                    on_brick(RenkoBrick{ts, trend_start_time_, last_price_,std::max(last_price_,new_close),std::min(last_price_,new_close),new_close,dir,false});
+                    last_price_=new_close;
+                    last_dir_=dir;
+                    progressed=true;
+                }
+            }else if(last_dir_==1){
+                if(price>=last_price_+brick_size_){
+                    double new_close=last_price_+brick_size_;
+                    on_brick(RenkoBrick{ts, trend_start_time_, last_price_,new_close,last_price_,new_close,1,false});
+                    last_price_=new_close; progressed=true;
+                }else if(price<=last_price_-reversal_size_){
+                    double new_close=last_price_-reversal_size_;
+                    on_brick(RenkoBrick{ts, ts, last_price_,last_price_,new_close,new_close,-1,true});
+                    last_price_=new_close; last_dir_=-1; trend_start_time_=ts; progressed=true;
+                }
+            }else{
+                if(price<=last_price_-brick_size_){
+                    double new_close=last_price_-brick_size_;
+                    on_brick(RenkoBrick{ts, trend_start_time_, last_price_,last_price_,new_close,new_close,-1,false});
+                    last_price_=new_close; progressed=true;
+                }else if(price>=last_price_+reversal_size_){
+                    double new_close=last_price_+reversal_size_;
+                    on_brick(RenkoBrick{ts, ts, last_price_,new_close,last_price_,new_close,1,true});
+                    last_price_=new_close; last_dir_=1; trend_start_time_=ts; progressed=true;
+                }
+            }
+        }
+    }
+
+    double last_price() const { return last_price_; }
+    int last_dir() const { return last_dir_; }   // 0 until the first brick
+    int64_t trend_start_time() const { return trend_start_time_; }
+
+private:
+    double brick_size_, reversal_size_;
+    double last_price_ = NAN;
+    int last_dir_ = 0;
+    int64_t trend_start_time_ = 0;
+};
+
+std::vector<double> donchian_mid(const std::vector<double> &series, int length);
+// Same, written to `out` (n values) so callers can choose where it lives.
+void donchian_mid(const double *series, size_t n, int length, double *out);
+std::vector<IchimokuRow> ichimoku_on_renko(const std::vector<RenkoBrick> &renko, int tenkan_len = 5, int kijun_len = 26, int span_b_len = 52, int displacement = 26);
+std::vector<Trade> run_strategy(const std::vector<IchimokuRow> &ri);
+
+// What the entry and exit rules say about one row. Exits are acted on
+// before entries.
+struct RuleSignals {
+    bool long_entry, long_exit, short_entry, short_exit;
+};
+
+// The Renko + Ichimoku rule set as a state machine fed one row at a time, so
+// batch backtests, parameter sweeps and live sessions share one set of rules.
+// As in run_strategy, the first row only primes the state.
+class StrategyRunner {
+public:
+    template <class OnTrade>
+    void step(const IchimokuRow &row, OnTrade &&on_trade){
+        step(row.brick_time, row.close, row.kijun, row.span_a, row.span_b, on_trade);
+    }
+
+    template <class OnTrade>
+    void step(int64_t time, double c, double kijun, double span_a, double span_b, OnTrade &&on_trade){
+        double cloud_top = std::max(span_a,span_b);
+        double cloud_bottom = std::min(span_a,span_b);
+        bool inside_cloud = c > cloud_bottom && c < cloud_top;
+        RuleSignals s;
+        s.long_exit = c < kijun || c < cloud_top;
+        s.short_exit = c > kijun || c > cloud_bottom;
+        s.long_entry = !inside_cloud && c > kijun && c > cloud_top;
+        s.short_entry = !inside_cloud && c < kijun && c < cloud_bottom;
+        apply(time, c, s, on_trade);
+    }
+
+    // Position handling for signals computed elsewhere (compiled rule sets).
+    // One position at a time: the open side's exit closes it, and only then
+    // can an entry act, possibly on the same row. An entry for the other
+    // side while a position is open is ignored, and so are both entries
+    // when they fire together. The built-in rules never do either.
+    template <class OnTrade>
+    void apply(int64_t time, double c, const RuleSignals &s, OnTrade &&on_trade){
+        if(!primed_){ primed_ = true; return; }
+        // Two branches rather than four: signals flip often.
+        if((in_long_ & s.long_exit) | (in_short_ & s.short_exit)){
+            close_position(time, c, on_trade);
+        }
+        bool flat = !(in_long_ | in_short_);
+        bool open_long = flat & s.long_entry & !s.short_entry;
+        bool open_short = flat & s.short_entry & !s.long_entry;
+        if(open_long | open_short){
+            current_ = {time, c, 0, 0, open_short ? TradeDirection::Short : TradeDirection::Long, 0};
+            in_long_ = open_long;
+            in_short_ = open_short;
+        }
+    }
+
+    // Closes whatever is still open at the last row.
+    template <class OnTrade>
+    void finish(int64_t time, double close, OnTrade &&on_trade){
+        if(in_long_ || in_short_) close_position(time, close, on_trade);
+    }
+
+    bool in_long() const { return in_long_; }
+    bool in_short() const { return in_short_; }
+    const Trade& open_trade() const { return current_; }
+
+private:
+    template <class OnTrade>
+    void close_position(int64_t time, double price, OnTrade &on_trade){
+        current_.exit_time = time;
+        current_.exit_price = price;
+        current_.profit = current_.direction == TradeDirection::Long ? current_.exit_price - current_.entry_price
+                                                                      : current_.entry_price - current_.exit_price;
+        in_long_ = in_short_ = false;
+        on_trade(static_cast<const Trade&>(current_));
+    }
+
+    bool primed_ = false;
+    bool in_long_ = false, in_short_ = false;
+    Trade current_{};
+};
+
+// Running totals over a trade sequence, as reported in backtest_summary.csv.
+struct TradeSummary {
+    size_t total_trades = 0;
+    double total_profit = 0;
+    int winning_trades = 0, losing_trades = 0;
+    double max_drawdown = 0;
+    double peak = 0;
+
+    void add(double profit){
+        total_trades++;
+        total_profit += profit;
+        if(profit>0) winning_trades++; else losing_trades++;
+        if(total_profit>peak) peak = total_profit;
+        max_drawdown = std::max(max_drawdown, peak - total_profit);
+    }
+};
+
+TradeSummary summarize_trades(const std::vector<Trade> &trades);
+
+// -------- IN-MEMORY CSV GENERATORS (instead of file writes) --------
+std::string renko_to_csv_string(const std::vector<RenkoBrick> &rows);
+std::string trades_to_csv_string(const std::vector<Trade> &trades);
+std::string summary_to_csv_string(const std::vector<Trade> &trades);
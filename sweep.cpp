@@ -0,0 +1,265 @@
+#include "sweep.h"
+#include "resample.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory_resource>
+#include <mutex>
+#include <stdexcept>
+
+using json = nlohmann::json;
+using namespace std;
+
+static const size_t MAX_SWEEP_COMBINATIONS = 10000000;
+
+// -------- REQUEST PARSING --------
+template <class T>
+static vector<T> parse_range(const json &data,const char *key,T fallback){
+    vector<T> values;
+    if(!data.contains(key)) values.push_back(fallback);
+    else {
+        const json &v = data[key];
+        if(v.is_number()) values.push_back(v.get<T>());
+        else if(v.is_array()) for(auto &x:v) values.push_back(x.get<T>());
+        else if(v.is_object()){
+            T start = v.value("start",fallback);
+            T stop = v.value("stop",start);
+            T step = v.value("step",static_cast<T>(1));
+            if(!(step>0)) throw runtime_error(string(key)+".step must be positive");
+            if(stop<start) throw runtime_error(string(key)+".stop must not be below start");
+            // Index-based so floating steps do not accumulate error.
+            size_t count = static_cast<size_t>(floor((stop-start)/static_cast<double>(step)+1e-9))+1;
+            if(count>MAX_SWEEP_COMBINATIONS) throw runtime_error(string(key)+" range is too large");
+            for(size_t i=0;i<count;i++) values.push_back(static_cast<T>(start+step*static_cast<T>(i)));
+        }
+        else throw runtime_error(string(key)+" must be a number, a list or a {start, stop, step} range");
+    }
+    sort(values.begin(),values.end());
+    values.erase(unique(values.begin(),values.end()),values.end());
+    for(auto x:values) if(!(x>0)) throw runtime_error(string(key)+" values must be positive");
+    return values;
+}
+
+static bool valid_sort_key(const string &key){
+    return key=="net_profit" || key=="max_drawdown" || key=="win_rate" ||
+           key=="total_trades" || key=="return_to_drawdown";
+}
+
+SweepRequest sweep_request_from_json(const json &data){
+    SweepRequest req;
+    req.symbol = data.value("symbol", "ETHUSDT");
+    req.resolution = data.value("resolution", "5m");
+    req.base_resolution = data.value("base_resolution", "");
+    if(req.base_resolution==req.resolution) req.base_resolution.clear();
+    if(!req.base_resolution.empty() && !can_resample(resolution_seconds(req.base_resolution),resolution_seconds(req.resolution)))
+        throw runtime_error("resolution must be a multiple of base_resolution");
+    string start_date = data.value("start_date", "2023-08-01");
+    string start_time_str = data.value("start_time", "00:00:00");
+    string end_date = data.value("end_date", "2023-08-02");
+    string end_time_str = data.value("end_time", "23:59:59");
+    req.start_ts = ist_to_unix(start_date, start_time_str);
+    req.end_ts = ist_to_unix(end_date, end_time_str);
+    if(req.start_ts >= req.end_ts) throw runtime_error("Start time must be before end time");
+
+    req.brick_sizes = parse_range<double>(data,"brick_size",40.0);
+    req.reversal_sizes = parse_range<double>(data,"reversal_size",80.0);
+    req.tenkans = parse_range<int>(data,"tenkan",5);
+    req.kijuns = parse_range<int>(data,"kijun",26);
+    req.span_bs = parse_range<int>(data,"span_b",52);
+
+    if(!data.contains("source_type")) req.source_types.push_back("ohlc4");
+    else if(data["source_type"].is_string()) req.source_types.push_back(data["source_type"].get<string>());
+    else for(auto &s:data["source_type"]) req.source_types.push_back(s.get<string>());
+    // Canonical names, so "close" and "Close" are one series; throws on unsupported sources.
+    for(auto &s:req.source_types) s = source_type_name(parse_source_type(s));
+    sort(req.source_types.begin(),req.source_types.end());
+    req.source_types.erase(unique(req.source_types.begin(),req.source_types.end()),req.source_types.end());
+
+    req.sort_by = data.value("sort_by", "net_profit");
+    if(!valid_sort_key(req.sort_by)) throw runtime_error("Unsupported sort_by: "+req.sort_by);
+    req.top = static_cast<size_t>(max(0, data.value("top", 50)));
+    req.min_trades = static_cast<size_t>(max(0, data.value("min_trades", 0)));
+
+    if(sweep_combinations(req)>MAX_SWEEP_COMBINATIONS)
+        throw runtime_error("Sweep has "+to_string(sweep_combinations(req))+" combinations; the limit is "+
+                            to_string(MAX_SWEEP_COMBINATIONS));
+    return req;
+}
+
+size_t sweep_combinations(const SweepRequest &req){
+    double n = 1.0*req.brick_sizes.size()*req.reversal_sizes.size()*req.source_types.size()*
+               req.tenkans.size()*req.kijuns.size()*req.span_bs.size();
+    return n>1e18 ? static_cast<size_t>(1e18) : static_cast<size_t>(n);
+}
+
+// -------- RANKING --------
+double sweep_score(const string &sort_by,const TradeSummary &s){
+    if(sort_by=="max_drawdown") return -s.max_drawdown;
+    if(sort_by=="win_rate") return s.total_trades ? static_cast<double>(s.winning_trades)/s.total_trades : 0.0;
+    if(sort_by=="total_trades") return static_cast<double>(s.total_trades);
+    if(sort_by=="return_to_drawdown") return s.total_profit/max(s.max_drawdown,1e-9);
+    return s.total_profit;
+}
+
+bool sweep_params_less(const SweepRow &x,const SweepRow &y){
+    if(x.brick_size!=y.brick_size) return x.brick_size<y.brick_size;
+    if(x.reversal_size!=y.reversal_size) return x.reversal_size<y.reversal_size;
+    if(x.source!=y.source) return x.source<y.source;
+    if(x.tenkan!=y.tenkan) return x.tenkan<y.tenkan;
+    if(x.kijun!=y.kijun) return x.kijun<y.kijun;
+    return x.span_b<y.span_b;
+}
+
+namespace {
+
+// Keeps the best k rows seen so far. Ties are broken on the parameters so
+// the ranking does not depend on thread scheduling.
+class TopK {
+public:
+    TopK(size_t k,const string &sort_by) : k_(k), sort_by_(sort_by) {}
+
+    void push(const SweepRow &row){
+        if(k_==0) return;
+        rows_.push_back({sweep_score(sort_by_,row.summary),row});
+        if(rows_.size()>=2*k_+64) trim();
+    }
+    void merge(TopK &other){
+        for(auto &r:other.rows_) rows_.push_back(r);
+        other.rows_.clear();
+        if(rows_.size()>=2*k_+64) trim();
+    }
+    vector<SweepRow> take(){
+        sort(rows_.begin(),rows_.end(),better);
+        if(rows_.size()>k_) rows_.resize(k_);
+        vector<SweepRow> out;
+        for(auto &r:rows_) out.push_back(r.second);
+        return out;
+    }
+
+private:
+    using Scored = pair<double,SweepRow>;
+
+    static bool better(const Scored &a,const Scored &b){
+        if(a.first!=b.first) return a.first>b.first;
+        return sweep_params_less(a.second,b.second);
+    }
+    void trim(){
+        nth_element(rows_.begin(),rows_.begin()+k_,rows_.end(),better);
+        rows_.resize(k_);
+    }
+
+    size_t k_;
+    const string &sort_by_;
+    vector<Scored> rows_;
+};
+
+struct RenkoKey {
+    double brick_size, reversal_size;
+    size_t source;
+};
+
+} // namespace
+
+// -------- EVALUATION --------
+SweepResult run_sweep(const SweepRequest &req,const vector<Candle> &candles,WorkStealingPool &pool,RunControl *control){
+    vector<RenkoKey> keys;
+    for(double b:req.brick_sizes)
+        for(double r:req.reversal_sizes)
+            for(size_t s=0;s<req.source_types.size();s++) keys.push_back({b,r,s});
+
+    vector<int> lengths;
+    lengths.insert(lengths.end(),req.tenkans.begin(),req.tenkans.end());
+    lengths.insert(lengths.end(),req.kijuns.begin(),req.kijuns.end());
+    lengths.insert(lengths.end(),req.span_bs.begin(),req.span_bs.end());
+    sort(lengths.begin(),lengths.end());
+    lengths.erase(unique(lengths.begin(),lengths.end()),lengths.end());
+
+    TopK best(req.top,req.sort_by);
+    mutex best_mu;
+    atomic<size_t> evaluated{0};
+
+    size_t total = sweep_combinations(req);
+    // Series, midpoints and span A live in per-task arenas; their totals are
+    // reported with the result.
+    ArenaStats memory;
+    mutex memory_mu;
+    auto record = [&](const ArenaScope &arena){
+        lock_guard<mutex> lk(memory_mu);
+        memory.add(arena.stats());
+    };
+
+    pool.parallel_for(keys.size(),[&](size_t k){
+        if(control) control->check();
+        ArenaScope arena;
+        const RenkoKey &key = keys[k];
+        auto renko = build_renko(candles,key.brick_size,key.reversal_size,parse_source_type(req.source_types[key.source]));
+        size_t n = renko.size();
+        pmr::vector<int64_t> times(n,arena.memory());
+        pmr::vector<double> closes(n,arena.memory());
+        for(size_t i=0;i<n;i++){ times[i] = renko[i].brick_time; closes[i] = renko[i].close; }
+        renko = {};
+
+        // Donchian midpoints shared by every combination on this series.
+        // Sized here so the tasks filling them never allocate from this arena.
+        pmr::vector<pmr::vector<double>> mids(arena.memory());
+        mids.reserve(lengths.size());
+        for(size_t li=0;li<lengths.size();li++) mids.emplace_back(n);
+        pool.parallel_for(lengths.size(),[&](size_t li){ donchian_mid(closes.data(),n,lengths[li],mids[li].data()); });
+        auto column = [&](int len) -> const pmr::vector<double>& {
+            return mids[lower_bound(lengths.begin(),lengths.end(),len)-lengths.begin()];
+        };
+
+        size_t pairs = req.tenkans.size()*req.kijuns.size();
+        pool.parallel_for(pairs,[&](size_t p){
+            if(control) control->check();
+            ArenaScope pair_arena;
+            int tenkan = req.tenkans[p/req.kijuns.size()];
+            int kijun = req.kijuns[p%req.kijuns.size()];
+            const pmr::vector<double> &tk = column(tenkan);
+            const pmr::vector<double> &kj = column(kijun);
+            pmr::vector<double> span_a(n,pair_arena.memory());
+            for(size_t i=0;i<n;i++) span_a[i] = isnan(tk[i])||isnan(kj[i]) ? NAN : (tk[i]+kj[i])/2.0;
+
+            TopK local(req.top,req.sort_by);
+            for(int span_b:req.span_bs){
+                const pmr::vector<double> &sb = column(span_b);
+                StrategyRunner runner;
+                SweepRow row{key.brick_size,key.reversal_size,key.source,tenkan,kijun,span_b,{}};
+                auto add = [&row](const Trade &t){ row.summary.add(t.profit); };
+                for(size_t i=0;i<n;i++) runner.step(times[i],closes[i],kj[i],span_a[i],sb[i],add);
+                if(n) runner.finish(times[n-1],closes[n-1],add);
+                if(row.summary.total_trades>=req.min_trades) local.push(row);
+            }
+            size_t done = evaluated.fetch_add(req.span_bs.size())+req.span_bs.size();
+            if(control && total) control->set_progress(static_cast<double>(done)/total);
+            record(pair_arena);
+            lock_guard<mutex> lk(best_mu);
+            best.merge(local);
+        });
+        record(arena);
+    });
+
+    SweepResult result;
+    result.rows = best.take();
+    result.evaluated = evaluated.load();
+    result.renko_series = keys.size();
+    result.memory = memory;
+    return result;
+}
+
+json sweep_result_to_json(const SweepRequest &req,const SweepResult &result){
+    json rows = json::array();
+    for(auto &r:result.rows){
+        const TradeSummary &s = r.summary;
+        double win_rate = s.total_trades ? static_cast<double>(s.winning_trades)/s.total_trades : 0.0;
+        rows.push_back({r.brick_size, r.reversal_size, req.source_types[r.source], r.tenkan, r.kijun, r.span_b,
+                        s.total_trades, round(s.total_profit*100.0)/100.0, s.winning_trades, s.losing_trades,
+                        round(win_rate*10000.0)/10000.0, round(s.max_drawdown*100.0)/100.0});
+    }
+    return {
+        {"columns", {"brick_size","reversal_size","source_type","tenkan","kijun","span_b",
+                     "total_trades","net_profit","winning_trades","losing_trades","win_rate","max_drawdown"}},
+        {"rows", rows}
+    };
+}
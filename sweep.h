@@ -0,0 +1,65 @@
+#pragma once
+
+#include "arena.h"
+#include "run_control.h"
+#include "strategy.h"
+#include "thread_pool.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+// Grid search over Renko + Ichimoku parameters on one candle series.
+//
+// Every distinct (brick_size, reversal_size, source_type) Renko series is
+// built once, and every distinct Donchian length is computed once per
+// series; each parameter combination then only runs the strategy over
+// those shared columns and keeps summary metrics.
+struct SweepRequest {
+    std::string symbol = "ETHUSDT";
+    std::string resolution = "5m";
+    std::string base_resolution;   // when set, candles are resampled from this resolution
+    int64_t start_ts = 0, end_ts = 0;
+
+    std::vector<double> brick_sizes, reversal_sizes;
+    std::vector<std::string> source_types;
+    std::vector<int> tenkans, kijuns, span_bs;
+
+    std::string sort_by = "net_profit";   // net_profit, max_drawdown, win_rate, total_trades, return_to_drawdown
+    size_t top = 50;
+    size_t min_trades = 0;
+};
+
+// Each parameter accepts a number, a list, or {"start", "stop", "step"}.
+// Throws std::runtime_error on invalid input.
+SweepRequest sweep_request_from_json(const nlohmann::json &data);
+
+size_t sweep_combinations(const SweepRequest &req);
+
+struct SweepRow {
+    double brick_size, reversal_size;
+    size_t source;   // index into SweepRequest::source_types
+    int tenkan, kijun, span_b;
+    TradeSummary summary;
+};
+
+struct SweepResult {
+    std::vector<SweepRow> rows;   // best first, at most req.top
+    size_t evaluated = 0;
+    size_t renko_series = 0;
+    ArenaStats memory;   // scratch used by the evaluation tasks
+};
+
+// Ranking used for results: higher sort_by score first, ties broken on the
+// parameters so the order does not depend on thread scheduling.
+double sweep_score(const std::string &sort_by, const TradeSummary &s);
+bool sweep_params_less(const SweepRow &a, const SweepRow &b);
+
+// `control`, when given, receives progress and is checked between parameter pairs.
+SweepResult run_sweep(const SweepRequest &req, const std::vector<Candle> &candles, WorkStealingPool &pool,
+                      RunControl *control = nullptr);
+
+// Column names and compact row arrays for the response table.
+nlohmann::json sweep_result_to_json(const SweepRequest &req, const SweepResult &result);
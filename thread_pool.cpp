@@ -0,0 +1,97 @@
+#include "thread_pool.h"
+
+using namespace std;
+
+// Pool and queue index of the current worker thread, if any.
+static thread_local const WorkStealingPool *current_pool = nullptr;
+static thread_local size_t current_index = 0;
+
+WorkStealingPool::WorkStealingPool(size_t threads){
+    threads = max<size_t>(1,threads);
+    for(size_t i=0;i<threads;i++) queues_.push_back(make_unique<Queue>());
+    for(size_t i=0;i<threads;i++) workers_.emplace_back([this,i]{ worker_loop(i); });
+}
+
+WorkStealingPool::~WorkStealingPool(){
+    {
+        lock_guard<mutex> lk(sleep_mu_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for(auto &t:workers_) t.join();
+}
+
+void WorkStealingPool::submit(function<void()> task){
+    size_t q = home_queue();
+    if(q==queues_.size()) q = next_queue_.fetch_add(1)%queues_.size();
+    {
+        lock_guard<mutex> lk(queues_[q]->mu);
+        queues_[q]->tasks.push_back(move(task));
+    }
+    {
+        lock_guard<mutex> lk(sleep_mu_);
+        pending_.fetch_add(1);
+    }
+    wake_.notify_one();
+}
+
+size_t WorkStealingPool::home_queue() const{
+    return current_pool==this ? current_index : queues_.size();
+}
+
+bool WorkStealingPool::try_run_one(size_t home){
+    function<void()> task;
+    size_t n = queues_.size();
+    if(home<n){
+        lock_guard<mutex> lk(queues_[home]->mu);
+        if(!queues_[home]->tasks.empty()){
+            task = move(queues_[home]->tasks.back());
+            queues_[home]->tasks.pop_back();
+        }
+    }
+    for(size_t k=1;!task && k<=n;k++){
+        size_t victim = (home+k)%n;
+        lock_guard<mutex> lk(queues_[victim]->mu);
+        if(!queues_[victim]->tasks.empty()){
+            task = move(queues_[victim]->tasks.front());
+            queues_[victim]->tasks.pop_front();
+        }
+    }
+    if(!task) return false;
+    pending_.fetch_sub(1);
+    task();
+    return true;
+}
+
+void WorkStealingPool::worker_loop(size_t index){
+    current_pool = this;
+    current_index = index;
+    while(true){
+        if(try_run_one(index)) continue;
+        unique_lock<mutex> lk(sleep_mu_);
+        wake_.wait(lk,[this]{ return stop_ || pending_.load()>0; });
+        if(stop_ && pending_.load()==0) return;
+    }
+}
+
+static size_t compute_pool_threads = 0;
+
+void set_compute_pool_threads(size_t threads){
+    compute_pool_threads = threads;
+}
+
+WorkStealingPool& compute_pool(){
+    static WorkStealingPool pool(compute_pool_threads ? compute_pool_threads : thread::hardware_concurrency());
+    return pool;
+}
+
+static size_t fetch_pool_threads = 0;
+
+void set_fetch_pool_threads(size_t threads){
+    fetch_pool_threads = threads;
+}
+
+WorkStealingPool& fetch_pool(){
+    static WorkStealingPool pool(fetch_pool_threads ? fetch_pool_threads : 8);
+    return pool;
+}
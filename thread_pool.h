@@ -0,0 +1,111 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool for CPU-bound backtest work.
+//
+// Each worker owns a deque: it pops its own newest task and, when empty,
+// steals the oldest task from another worker. Threads that block in
+// parallel_for keep running queued tasks while they wait, so nested
+// parallel_for calls cannot starve the pool.
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(size_t threads);
+    ~WorkStealingPool();
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    void submit(std::function<void()> task);
+
+    // Runs f(0..n-1) across the pool and the calling thread and returns when
+    // every index is done. The first exception thrown by f is rethrown.
+    template <class F>
+    void parallel_for(size_t n, F &&f);
+
+    size_t size() const { return workers_.size(); }
+
+private:
+    struct Queue {
+        std::mutex mu;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    // The calling worker's own queue, or size() off the pool.
+    size_t home_queue() const;
+    bool try_run_one(size_t home);
+    void worker_loop(size_t index);
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<size_t> pending_{0};
+    std::atomic<size_t> next_queue_{0};
+    std::mutex sleep_mu_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+};
+
+template <class F>
+void WorkStealingPool::parallel_for(size_t n, F &&f){
+    if(n==0) return;
+    struct Shared {
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+        std::atomic<bool> failed{false};
+        std::exception_ptr error;
+        std::mutex mu;
+        std::condition_variable finished;
+    };
+    auto shared = std::make_shared<Shared>();
+    auto claim = [shared, n, &f](){
+        for(size_t i; (i = shared->next.fetch_add(1)) < n; ){
+            if(!shared->failed.load(std::memory_order_relaxed)){
+                try { f(i); }
+                catch(...){
+                    std::lock_guard<std::mutex> lk(shared->mu);
+                    if(!shared->error) shared->error = std::current_exception();
+                    shared->failed = true;
+                }
+            }
+            if(shared->done.fetch_add(1)+1 == n){
+                std::lock_guard<std::mutex> lk(shared->mu);
+                shared->finished.notify_all();
+            }
+        }
+    };
+    // One helper per worker is enough: helpers keep claiming indices until
+    // none are left. Helpers that start late find nothing and exit, so `f`
+    // (captured by reference) is never touched after we return.
+    size_t helpers = std::min(n-1, workers_.size());
+    for(size_t h=0; h<helpers; h++) submit(claim);
+    claim();
+    while(shared->done.load() < n){
+        if(try_run_one(home_queue())) continue;
+        std::unique_lock<std::mutex> lk(shared->mu);
+        shared->finished.wait_for(lk, std::chrono::milliseconds(1), [&]{ return shared->done.load() >= n; });
+    }
+    if(shared->error) std::rethrow_exception(shared->error);
+}
+
+// Shared pool for compute-heavy endpoints, sized to the hardware unless
+// set_compute_pool_threads() ran first.
+WorkStealingPool& compute_pool();
+// Only takes effect before the first compute_pool() call; 0 keeps the default.
+void set_compute_pool_threads(size_t threads);
+
+// Shared pool for exchange downloads, so concurrent batch requests together
+// never have more than its size downloading. 8 threads unless
+// set_fetch_pool_threads() ran first.
+WorkStealingPool& fetch_pool();
+// Only takes effect before the first fetch_pool() call; 0 keeps the default.
+void set_fetch_pool_threads(size_t threads);
@@ -0,0 +1,272 @@
+// Load generator for the backtest server.
+//
+//   loadgen [--url http://127.0.0.1:9080] [--mix backtest:1,download-csv:1,health:8]
+//           [--body request.json] [--concurrency 8] [--rate 0] [--duration 30]
+//           [--warmup 2] [--timeout 60] [--compressed 0] [--out results.json]
+//
+// Closed loop by default: each of --concurrency workers sends its next
+// request as soon as the previous one returns. With --rate N the workers
+// instead follow a fixed schedule of N requests per second in total, and
+// latency counts from the scheduled send time, so a server that falls
+// behind shows the queueing it causes (up to --concurrency requests in
+// flight). Endpoints are picked at random by --mix weight; --body replaces
+// the built-in backtest request (download-csv adds "file_type": "all").
+//
+// Requests started in the first --warmup seconds are not counted. Per
+// endpoint and overall: requests, errors (transport failures and HTTP
+// status >= 400), throughput, and p50/p95/p99/max latency. JSON goes to
+// --out or stdout, a readable table to stderr.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <curl/curl.h>
+#include <nlohmann/json.hpp>
+
+using namespace std;
+using json = nlohmann::json;
+using Clock = chrono::steady_clock;
+
+struct Target {
+    string name, path, body;   // empty body: GET
+    double weight;
+};
+
+struct LoadOptions {
+    string url = "http://127.0.0.1:9080";
+    string mix = "backtest:1";
+    string body_file;
+    int concurrency = 8;
+    double rate = 0;
+    double duration = 30, warmup = 2;
+    long timeout = 60;
+    bool compressed = false;
+    string out;
+};
+
+static const char *DEFAULT_BODY = R"({"symbol": "BTCUSD", "resolution": "5m", "brick_size": 40, "reversal_size": 80,
+ "source_type": "ohlc4", "start_date": "2024-01-01", "end_date": "2024-01-31"})";
+
+static LoadOptions parse_options(int argc,char **argv){
+    LoadOptions o;
+    for(int i=1;i<argc;i++){
+        string arg = argv[i];
+        if(i+1>=argc) throw runtime_error("Missing value for "+arg);
+        string value = argv[++i];
+        if(arg=="--url") o.url = value;
+        else if(arg=="--mix") o.mix = value;
+        else if(arg=="--body") o.body_file = value;
+        else if(arg=="--concurrency") o.concurrency = max(1,atoi(value.c_str()));
+        else if(arg=="--rate") o.rate = max(0.0,atof(value.c_str()));
+        else if(arg=="--duration") o.duration = atof(value.c_str());
+        else if(arg=="--warmup") o.warmup = max(0.0,atof(value.c_str()));
+        else if(arg=="--timeout") o.timeout = max(1L,atol(value.c_str()));
+        else if(arg=="--compressed") o.compressed = value!="0";
+        else if(arg=="--out") o.out = value;
+        else throw runtime_error("Unknown option: "+arg);
+    }
+    if(!(o.duration>0)) throw runtime_error("--duration must be positive");
+    while(!o.url.empty() && o.url.back()=='/') o.url.pop_back();
+    return o;
+}
+
+static vector<Target> parse_mix(const LoadOptions &o){
+    string body = DEFAULT_BODY;
+    if(!o.body_file.empty()){
+        ifstream f(o.body_file);
+        if(!f) throw runtime_error("Cannot read "+o.body_file);
+        stringstream ss;
+        ss << f.rdbuf();
+        body = ss.str();
+    }
+    json request = json::parse(body);
+    json csv_request = request;
+    if(!csv_request.contains("file_type")) csv_request["file_type"] = "all";
+
+    vector<Target> targets;
+    stringstream ss(o.mix);
+    for(string item; getline(ss,item,',');){
+        if(item.empty()) continue;
+        size_t colon = item.find(':');
+        string name = item.substr(0,colon);
+        double weight = colon==string::npos ? 1.0 : atof(item.c_str()+colon+1);
+        if(!(weight>0)) continue;
+        if(name=="backtest") targets.push_back({name,"/backtest",request.dump(),weight});
+        else if(name=="download-csv") targets.push_back({name,"/backtest/download-csv",csv_request.dump(),weight});
+        else if(name=="health") targets.push_back({name,"/backtest/health","",weight});
+        else throw runtime_error("Unknown endpoint in --mix: "+name+" (backtest, download-csv, health)");
+    }
+    if(targets.empty()) throw runtime_error("--mix selects no endpoints");
+    return targets;
+}
+
+struct Sample {
+    double ms;
+    size_t bytes;
+    bool ok;
+};
+
+static size_t discard(char*,size_t size,size_t nmemb,void *userdata){
+    *static_cast<size_t*>(userdata) += size*nmemb;
+    return size*nmemb;
+}
+
+static double percentile(const vector<double> &sorted,double p){
+    if(sorted.empty()) return 0;
+    size_t rank = static_cast<size_t>(ceil(p/100.0*sorted.size()));
+    return sorted[min(sorted.size(),max<size_t>(rank,1))-1];
+}
+
+int main(int argc,char **argv){
+    LoadOptions o;
+    vector<Target> targets;
+    try {
+        o = parse_options(argc,argv);
+        targets = parse_mix(o);
+    } catch(const exception &e){
+        cerr << e.what() << endl;
+        return 2;
+    }
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    vector<double> cumulative;
+    double total_weight = 0;
+    for(auto &t:targets) cumulative.push_back(total_weight += t.weight);
+
+    auto start = Clock::now();
+    auto measure_from = start+chrono::duration_cast<Clock::duration>(chrono::duration<double>(o.warmup));
+    auto end = measure_from+chrono::duration_cast<Clock::duration>(chrono::duration<double>(o.duration));
+    atomic<uint64_t> scheduled{0};
+
+    mutex results_mu;
+    vector<vector<Sample>> results(targets.size());
+
+    auto worker = [&](int id){
+        CURL *easy = curl_easy_init();
+        if(!easy) return;
+        curl_slist *headers = curl_slist_append(nullptr,"Content-Type: application/json");
+        mt19937_64 rng(static_cast<uint64_t>(id)*7919+1);
+        uniform_real_distribution<double> pick(0,total_weight);
+        vector<vector<Sample>> local(targets.size());
+
+        while(true){
+            Clock::time_point sent;
+            if(o.rate>0){
+                uint64_t k = scheduled.fetch_add(1);
+                sent = start+chrono::duration_cast<Clock::duration>(chrono::duration<double>(k/o.rate));
+                if(sent>=end) break;
+                this_thread::sleep_until(sent);
+            } else {
+                sent = Clock::now();
+                if(sent>=end) break;
+            }
+            size_t ti = static_cast<size_t>(upper_bound(cumulative.begin(),cumulative.end(),pick(rng))-cumulative.begin());
+            const Target &t = targets[min(ti,targets.size()-1)];
+
+            string url = o.url+t.path;
+            size_t bytes = 0;
+            curl_easy_reset(easy);
+            curl_easy_setopt(easy,CURLOPT_URL,url.c_str());
+            curl_easy_setopt(easy,CURLOPT_WRITEFUNCTION,discard);
+            curl_easy_setopt(easy,CURLOPT_WRITEDATA,&bytes);
+            curl_easy_setopt(easy,CURLOPT_TIMEOUT,o.timeout);
+            curl_easy_setopt(easy,CURLOPT_NOSIGNAL,1L);
+            if(o.compressed) curl_easy_setopt(easy,CURLOPT_ACCEPT_ENCODING,"");
+            if(!t.body.empty()){
+                curl_easy_setopt(easy,CURLOPT_HTTPHEADER,headers);
+                curl_easy_setopt(easy,CURLOPT_POSTFIELDS,t.body.c_str());
+                curl_easy_setopt(easy,CURLOPT_POSTFIELDSIZE,static_cast<long>(t.body.size()));
+            }
+            CURLcode rc = curl_easy_perform(easy);
+            long status = 0;
+            curl_easy_getinfo(easy,CURLINFO_RESPONSE_CODE,&status);
+            double ms = chrono::duration<double,milli>(Clock::now()-sent).count();
+            if(sent>=measure_from) local[&t-targets.data()].push_back({ms,bytes,rc==CURLE_OK && status>0 && status<400});
+        }
+        curl_slist_free_all(headers);
+        curl_easy_cleanup(easy);
+        lock_guard<mutex> lk(results_mu);
+        for(size_t i=0;i<local.size();i++) results[i].insert(results[i].end(),local[i].begin(),local[i].end());
+    };
+
+    vector<thread> workers;
+    for(int i=0;i<o.concurrency;i++) workers.emplace_back(worker,i);
+    for(auto &w:workers) w.join();
+    double seconds = max(1e-9,chrono::duration<double>(min(Clock::now(),end)-measure_from).count());
+
+    auto summarize = [&](const string &name,const vector<Sample> &samples){
+        vector<double> ms;
+        size_t errors = 0, bytes = 0;
+        double sum = 0;
+        for(auto &s:samples){
+            ms.push_back(s.ms);
+            sum += s.ms;
+            bytes += s.bytes;
+            if(!s.ok) errors++;
+        }
+        sort(ms.begin(),ms.end());
+        json row = {
+            {"endpoint", name},
+            {"requests", samples.size()},
+            {"errors", errors},
+            {"throughput_rps", samples.size()/seconds},
+            {"bytes", bytes},
+            {"mean_ms", samples.empty() ? 0.0 : sum/samples.size()},
+            {"p50_ms", percentile(ms,50)},
+            {"p95_ms", percentile(ms,95)},
+            {"p99_ms", percentile(ms,99)},
+            {"max_ms", ms.empty() ? 0.0 : ms.back()}
+        };
+        fprintf(stderr,"%-14s %9zu %7zu %10.1f %9.1f %9.1f %9.1f %9.1f\n",name.c_str(),samples.size(),errors,
+                samples.size()/seconds,percentile(ms,50),percentile(ms,95),percentile(ms,99),ms.empty() ? 0.0 : ms.back());
+        return row;
+    };
+
+    fprintf(stderr,"%-14s %9s %7s %10s %9s %9s %9s %9s\n","endpoint","requests","errors","req/s","p50 ms","p95 ms","p99 ms","max ms");
+    json rows = json::array();
+    vector<Sample> all;
+    for(size_t i=0;i<targets.size();i++){
+        rows.push_back(summarize(targets[i].name,results[i]));
+        all.insert(all.end(),results[i].begin(),results[i].end());
+    }
+    if(targets.size()>1) rows.push_back(summarize("all",all));
+
+    json doc = {
+        {"tool", "loadgen"},
+        {"url", o.url},
+        {"mix", o.mix},
+        {"mode", o.rate>0 ? "open" : "closed"},
+        {"concurrency", o.concurrency},
+        {"rate", o.rate},
+        {"warmup_s", o.warmup},
+        {"duration_s", seconds},
+        {"compressed", o.compressed},
+        {"results", rows}
+    };
+    int code = 0;
+    if(o.out.empty()){
+        cout << doc.dump(2) << endl;
+    } else {
+        ofstream f(o.out);
+        f << doc.dump(2) << endl;
+        if(!f){
+            cerr << "Could not write " << o.out << endl;
+            code = 1;
+        }
+    }
+    curl_global_cleanup();
+    return code;
+}
@@ -0,0 +1,222 @@
+// Local stand-in for the exchange's candle endpoint, for load tests and
+// offline development.
+//
+//   mock_exchange [--port 18080] [--threads 4] [--latency-ms 0] [--jitter-ms 0]
+//                 [--error-rate 0] [--error-status 503] [--seed 7]
+//
+// GET /v2/history/candles?symbol=&resolution=&start=&end=[&limit=] answers
+// like the real endpoint, newest candle first. Prices are a pure function
+// of (seed, symbol, time): smooth noise at periods from an hour to a month
+// plus per-minute jitter, so any window, in any order or size, returns the
+// same candles and consecutive candles join up (close == next open).
+//
+// Every request sleeps latency-ms +/- jitter-ms on its handler thread, and
+// fails with error-status at error-rate (0..1). GET /stats reports the
+// counters. Point the server at it with --candle-api http://127.0.0.1:18080.
+
+#include <pistache/endpoint.h>
+#include <pistache/http.h>
+#include <pistache/router.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+
+#include <nlohmann/json.hpp>
+
+using namespace Pistache;
+using namespace std;
+using json = nlohmann::json;
+
+struct MockOptions {
+    int port = 18080;
+    int threads = 4;
+    double latency_ms = 0, jitter_ms = 0;
+    double error_rate = 0;
+    int error_status = 503;
+    uint64_t seed = 7;
+};
+
+static MockOptions options;
+static atomic<uint64_t> requests{0}, errors{0}, candles_served{0};
+
+// -------- DETERMINISTIC PRICES --------
+static uint64_t mix(uint64_t x){
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x^(x>>30))*0xbf58476d1ce4e5b9ULL;
+    x = (x^(x>>27))*0x94d049bb133111ebULL;
+    return x^(x>>31);
+}
+
+// FNV-1a over the bytes, so a symbol keys the same series on any toolchain
+// (std::hash is implementation-defined).
+static uint64_t symbol_hash(const string &symbol){
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for(unsigned char c:symbol) h = (h^c)*0x100000001b3ULL;
+    return mix(h);
+}
+
+// Uniform in [-1, 1].
+static double unit_hash(uint64_t key,int64_t i){
+    return static_cast<double>(mix(key^mix(static_cast<uint64_t>(i))) >> 11)*(2.0/9007199254740992.0)-1.0;
+}
+
+// Hashed knots every `period` seconds, cosine-interpolated between.
+static double value_noise(uint64_t key,int64_t t,double period){
+    double x = t/period;
+    double cell = floor(x);
+    double f = (1.0-cos((x-cell)*M_PI))/2.0;
+    int64_t i = static_cast<int64_t>(cell);
+    return unit_hash(key,i)*(1.0-f)+unit_hash(key,i+1)*f;
+}
+
+struct PriceModel {
+    uint64_t key;
+    double base;
+
+    explicit PriceModel(const string &symbol)
+        : key(mix(options.seed^symbol_hash(symbol))), base(50.0+static_cast<double>(key%500000)/100.0) {}
+
+    double at(int64_t t) const{
+        static const double periods[] = {3600, 6*3600, 86400, 7*86400, 30*86400};
+        static const double amplitudes[] = {0.004, 0.01, 0.025, 0.06, 0.15};
+        double x = 0;
+        for(int k=0;k<5;k++) x += amplitudes[k]*value_noise(key+k,t,periods[k]);
+        x += 0.001*unit_hash(key+99,t/60);
+        return round(base*exp(x)*100.0)/100.0;
+    }
+
+    json candle(int64_t t,int seconds) const{
+        double open = at(t), close = at(t+seconds);
+        double high = max(open,close), low = min(open,close);
+        for(int k=1;k<4;k++){
+            double p = at(t+seconds*k/4);
+            high = max(high,p);
+            low = min(low,p);
+        }
+        double wick = base*0.0005*fabs(unit_hash(key+7,t));
+        return {
+            {"time", t},
+            {"open", open},
+            {"high", round((high+wick)*100.0)/100.0},
+            {"low", round((low-wick)*100.0)/100.0},
+            {"close", close},
+            {"volume", round((10.0+90.0*fabs(unit_hash(key+8,t)))*1000.0)/1000.0}
+        };
+    }
+};
+
+static int resolution_seconds(const string &res){
+    if(res.size()<2) return 0;
+    int n = atoi(res.substr(0,res.size()-1).c_str());
+    switch(res.back()){
+    case 'm': return n*60;
+    case 'h': return n*3600;
+    case 'd': return n*86400;
+    case 'w': return n*7*86400;
+    }
+    return 0;
+}
+
+// -------- HANDLERS --------
+static void send_json(Http::ResponseWriter &response,Http::Code code,const json &body){
+    response.headers().add<Http::Header::ContentType>(MIME(Application, Json));
+    response.send(code,body.dump());
+}
+
+static void handle_candles(const Rest::Request &request,Http::ResponseWriter response){
+    requests++;
+    static thread_local mt19937_64 rng(options.seed^hash<thread::id>()(this_thread::get_id()));
+    if(options.latency_ms>0 || options.jitter_ms>0){
+        uniform_real_distribution<double> jitter(-options.jitter_ms,options.jitter_ms);
+        double ms = max(0.0,options.latency_ms+jitter(rng));
+        this_thread::sleep_for(chrono::microseconds(static_cast<int64_t>(ms*1000)));
+    }
+    if(options.error_rate>0 && uniform_real_distribution<double>(0,1)(rng)<options.error_rate){
+        errors++;
+        send_json(response,static_cast<Http::Code>(options.error_status),
+                  {{"success", false}, {"error", {{"code", "injected_error"}}}});
+        return;
+    }
+
+    auto query = request.query();
+    auto symbol = query.get("symbol");
+    auto resolution = query.get("resolution");
+    auto start = query.get("start");
+    auto end = query.get("end");
+    if(!symbol || !resolution || !start || !end){
+        send_json(response,Http::Code::Bad_Request,
+                  {{"success", false}, {"error", {{"code", "missing symbol, resolution, start or end"}}}});
+        return;
+    }
+    int seconds = resolution_seconds(*resolution);
+    if(seconds<=0){
+        send_json(response,Http::Code::Bad_Request,{{"success", false}, {"error", {{"code", "invalid_resolution"}}}});
+        return;
+    }
+    int64_t from = strtoll(start->c_str(),nullptr,10), to = strtoll(end->c_str(),nullptr,10);
+    long limit = 2000;
+    if(auto l = query.get("limit")) limit = max(1L,min(10000L,strtol(l->c_str(),nullptr,10)));
+
+    PriceModel model(*symbol);
+    int64_t first = (from+seconds-1)/seconds*seconds;
+    int64_t count = to>=first ? min<int64_t>((to-first)/seconds+1,limit) : 0;
+    json rows = json::array();
+    for(int64_t i=count-1;i>=0;i--) rows.push_back(model.candle(first+i*seconds,seconds));
+    candles_served += static_cast<uint64_t>(count);
+    send_json(response,Http::Code::Ok,{{"success", true}, {"result", rows}});
+}
+
+static void handle_stats(const Rest::Request&,Http::ResponseWriter response){
+    send_json(response,Http::Code::Ok,{
+        {"requests", requests.load()},
+        {"injected_errors", errors.load()},
+        {"candles_served", candles_served.load()}
+    });
+}
+
+static MockOptions parse_options(int argc,char **argv){
+    MockOptions o;
+    for(int i=1;i+1<argc;i+=2){
+        string arg = argv[i];
+        const char *value = argv[i+1];
+        if(arg=="--port") o.port = atoi(value);
+        else if(arg=="--threads") o.threads = max(1,atoi(value));
+        else if(arg=="--latency-ms") o.latency_ms = atof(value);
+        else if(arg=="--jitter-ms") o.jitter_ms = atof(value);
+        else if(arg=="--error-rate") o.error_rate = min(1.0,max(0.0,atof(value)));
+        else if(arg=="--error-status") o.error_status = atoi(value);
+        else if(arg=="--seed") o.seed = strtoull(value,nullptr,10);
+        else cerr << "Ignoring unknown option " << arg << endl;
+    }
+    return o;
+}
+
+int main(int argc,char **argv){
+    options = parse_options(argc,argv);
+
+    Address addr(Ipv4::any(), Port(static_cast<uint16_t>(options.port)));
+    Http::Endpoint server(addr);
+    server.init(Http::Endpoint::options().threads(options.threads));
+
+    Rest::Router router;
+    router.get("/v2/history/candles", Rest::Routes::bind(&handle_candles));
+    router.get("/stats", Rest::Routes::bind(&handle_stats));
+    server.setHandler(router.handler());
+
+    printf("mock exchange on port %d (%d threads, latency %.1f +/- %.1f ms, error rate %.3f -> %d, seed %llu)\n",
+           options.port,options.threads,options.latency_ms,options.jitter_ms,options.error_rate,
+           options.error_status,static_cast<unsigned long long>(options.seed));
+    fflush(stdout);
+    server.serve();
+    return 0;
+}
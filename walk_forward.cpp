@@ -0,0 +1,282 @@
+#include "walk_forward.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <map>
+#include <memory_resource>
+#include <mutex>
+#include <stdexcept>
+
+using json = nlohmann::json;
+using namespace std;
+
+static const size_t MAX_WALK_FORWARD_FOLDS = 1000;
+static const size_t MAX_WALK_FORWARD_EVALUATIONS = 50000000;
+
+// -------- REQUEST PARSING --------
+WalkForwardRequest walk_forward_request_from_json(const json &data){
+    WalkForwardRequest req;
+    req.sweep = sweep_request_from_json(data);
+    double train_days = data.value("train_days", 30.0);
+    double test_days = data.value("test_days", 7.0);
+    if(!(train_days>0) || !(test_days>0)) throw runtime_error("train_days and test_days must be positive");
+    req.train_seconds = llround(train_days*86400);
+    req.test_seconds = llround(test_days*86400);
+    req.anchored = data.value("anchored", false);
+
+    size_t folds = walk_forward_folds(req).size();
+    if(folds==0) throw runtime_error("Date range is shorter than one train window plus one test window");
+    if(folds>MAX_WALK_FORWARD_FOLDS)
+        throw runtime_error("Walk-forward has more than "+to_string(MAX_WALK_FORWARD_FOLDS)+" folds; use longer test windows");
+    double evaluations = 1.0*folds*sweep_combinations(req.sweep);
+    if(evaluations>MAX_WALK_FORWARD_EVALUATIONS)
+        throw runtime_error("Walk-forward needs "+to_string(static_cast<size_t>(evaluations))+" evaluations; the limit is "+
+                            to_string(MAX_WALK_FORWARD_EVALUATIONS));
+    return req;
+}
+
+vector<WalkForwardFold> walk_forward_folds(const WalkForwardRequest &req){
+    vector<WalkForwardFold> folds;
+    int64_t start = req.sweep.start_ts;
+    int64_t end = req.sweep.end_ts+1;   // end_ts is the last second included
+    for(int64_t test_start = start+req.train_seconds; test_start+req.test_seconds<=end; test_start += req.test_seconds){
+        folds.push_back({req.anchored ? start : test_start-req.train_seconds, test_start,
+                         test_start, test_start+req.test_seconds});
+        if(folds.size()>MAX_WALK_FORWARD_FOLDS) break;   // the caller rejects this
+    }
+    return folds;
+}
+
+// -------- EVALUATION --------
+namespace {
+
+struct SeriesKey {
+    double brick_size, reversal_size;
+    size_t source;
+};
+
+// A Renko series over the whole range with the Donchian midpoints of the
+// given (sorted) lengths, all in the current arena.
+struct Series {
+    pmr::vector<int64_t> times;
+    pmr::vector<double> closes;
+    vector<int> lengths;
+    pmr::vector<pmr::vector<double>> mids;
+
+    explicit Series(pmr::memory_resource *memory) : times(memory), closes(memory), mids(memory) {}
+
+    const double* column(int length) const{
+        return mids[lower_bound(lengths.begin(),lengths.end(),length)-lengths.begin()].data();
+    }
+    // Bricks formed in [from, to).
+    pair<size_t,size_t> window(int64_t from,int64_t to) const{
+        return {static_cast<size_t>(lower_bound(times.begin(),times.end(),from)-times.begin()),
+                static_cast<size_t>(lower_bound(times.begin(),times.end(),to)-times.begin())};
+    }
+};
+
+void build_series(Series &s,const vector<Candle> &candles,const SweepRequest &req,const SeriesKey &key,
+                  const vector<int> &lengths,WorkStealingPool &pool){
+    auto renko = build_renko(candles,key.brick_size,key.reversal_size,parse_source_type(req.source_types[key.source]));
+    size_t n = renko.size();
+    s.times.resize(n);
+    s.closes.resize(n);
+    for(size_t i=0;i<n;i++){ s.times[i] = renko[i].brick_time; s.closes[i] = renko[i].close; }
+    renko = {};
+    s.lengths = lengths;
+    s.mids.reserve(lengths.size());
+    for(size_t li=0;li<lengths.size();li++) s.mids.emplace_back(n);
+    pool.parallel_for(lengths.size(),[&](size_t li){ donchian_mid(s.closes.data(),n,lengths[li],s.mids[li].data()); });
+}
+
+// The strategy over bricks [lo, hi), starting flat and closing at the end.
+template <class OnTrade>
+void run_window(const Series &s,int tenkan,int kijun,int span_b,pair<size_t,size_t> range,OnTrade &&on_trade){
+    const double *tk = s.column(tenkan), *kj = s.column(kijun), *sb = s.column(span_b);
+    StrategyRunner runner;
+    for(size_t i=range.first;i<range.second;i++){
+        double span_a = isnan(tk[i])||isnan(kj[i]) ? NAN : (tk[i]+kj[i])/2.0;
+        runner.step(s.times[i],s.closes[i],kj[i],span_a,sb[i],on_trade);
+    }
+    if(range.second>range.first) runner.finish(s.times[range.second-1],s.closes[range.second-1],on_trade);
+}
+
+bool better(double score_a,const SweepRow &a,double score_b,const SweepRow &b){
+    if(score_a!=score_b) return score_a>score_b;
+    return sweep_params_less(a,b);
+}
+
+} // namespace
+
+WalkForwardResult run_walk_forward(const WalkForwardRequest &req,const vector<Candle> &candles,
+                                   WorkStealingPool &pool,RunControl *control){
+    const SweepRequest &sw = req.sweep;
+    vector<WalkForwardFold> folds = walk_forward_folds(req);
+    vector<SeriesKey> keys;
+    for(double b:sw.brick_sizes)
+        for(double r:sw.reversal_sizes)
+            for(size_t s=0;s<sw.source_types.size();s++) keys.push_back({b,r,s});
+
+    vector<int> lengths;
+    lengths.insert(lengths.end(),sw.tenkans.begin(),sw.tenkans.end());
+    lengths.insert(lengths.end(),sw.kijuns.begin(),sw.kijuns.end());
+    lengths.insert(lengths.end(),sw.span_bs.begin(),sw.span_bs.end());
+    sort(lengths.begin(),lengths.end());
+    lengths.erase(unique(lengths.begin(),lengths.end()),lengths.end());
+
+    WalkForwardResult result;
+    result.folds.resize(folds.size());
+    for(size_t f=0;f<folds.size();f++) result.folds[f].fold = folds[f];
+    vector<double> best_score(folds.size(),0.0);
+    mutex best_mu;
+    atomic<size_t> evaluated{0};
+    size_t pairs = sw.tenkans.size()*sw.kijuns.size();
+    size_t total = keys.size()*pairs*sw.span_bs.size()*folds.size();
+
+    ArenaStats memory;
+    mutex memory_mu;
+    auto record = [&](const ArenaScope &arena){
+        lock_guard<mutex> lk(memory_mu);
+        memory.add(arena.stats());
+    };
+
+    // Train: every combination on every fold's train window. A series is
+    // built once and all folds read their slice of it in parallel.
+    if(control) control->set_progress(0.0,"optimizing");
+    pool.parallel_for(keys.size(),[&](size_t k){
+        if(control) control->check();
+        ArenaScope arena;
+        const SeriesKey &key = keys[k];
+        Series series(arena.memory());
+        build_series(series,candles,sw,key,lengths,pool);
+
+        pool.parallel_for(folds.size()*pairs,[&](size_t item){
+            if(control) control->check();
+            size_t f = item/pairs, p = item%pairs;
+            int tenkan = sw.tenkans[p/sw.kijuns.size()];
+            int kijun = sw.kijuns[p%sw.kijuns.size()];
+            auto range = series.window(folds[f].train_start,folds[f].train_end);
+
+            bool found = false;
+            SweepRow local{};
+            double local_score = 0;
+            for(int span_b:sw.span_bs){
+                SweepRow row{key.brick_size,key.reversal_size,key.source,tenkan,kijun,span_b,{}};
+                run_window(series,tenkan,kijun,span_b,range,[&row](const Trade &t){ row.summary.add(t.profit); });
+                if(row.summary.total_trades<sw.min_trades) continue;
+                double score = sweep_score(sw.sort_by,row.summary);
+                if(!found || better(score,row,local_score,local)){
+                    local = row;
+                    local_score = score;
+                    found = true;
+                }
+            }
+            size_t done = evaluated.fetch_add(sw.span_bs.size())+sw.span_bs.size();
+            if(control && total) control->set_progress(0.9*done/total);
+            if(!found) return;
+            lock_guard<mutex> lk(best_mu);
+            WalkForwardFoldResult &fr = result.folds[f];
+            if(!fr.chosen || better(local_score,local,best_score[f],fr.best)){
+                fr.best = local;
+                best_score[f] = local_score;
+                fr.chosen = true;
+            }
+        });
+        record(arena);
+    });
+
+    // Test: each fold's winner on the window after it, grouped by series so
+    // each chosen series is built once more.
+    if(control) control->set_progress(0.9,"testing");
+    map<size_t,vector<size_t>> by_key;
+    for(size_t f=0;f<folds.size();f++){
+        const WalkForwardFoldResult &fr = result.folds[f];
+        if(!fr.chosen) continue;
+        for(size_t k=0;k<keys.size();k++){
+            if(keys[k].brick_size==fr.best.brick_size && keys[k].reversal_size==fr.best.reversal_size &&
+               keys[k].source==fr.best.source){
+                by_key[k].push_back(f);
+                break;
+            }
+        }
+    }
+    vector<pair<size_t,vector<size_t>>> groups(by_key.begin(),by_key.end());
+    pool.parallel_for(groups.size(),[&](size_t g){
+        if(control) control->check();
+        ArenaScope arena;
+        vector<int> needed;
+        for(size_t f:groups[g].second){
+            const SweepRow &b = result.folds[f].best;
+            needed.insert(needed.end(),{b.tenkan,b.kijun,b.span_b});
+        }
+        sort(needed.begin(),needed.end());
+        needed.erase(unique(needed.begin(),needed.end()),needed.end());
+        Series series(arena.memory());
+        build_series(series,candles,sw,keys[groups[g].first],needed,pool);
+        for(size_t f:groups[g].second){
+            WalkForwardFoldResult &fr = result.folds[f];
+            auto range = series.window(fr.fold.test_start,fr.fold.test_end);
+            run_window(series,fr.best.tenkan,fr.best.kijun,fr.best.span_b,range,[&fr](const Trade &t){
+                fr.test.add(t.profit);
+                fr.test_trades.push_back(t);
+            });
+        }
+        record(arena);
+    });
+
+    for(auto &fr:result.folds)
+        for(auto &t:fr.test_trades) result.out_of_sample.add(t.profit);
+    result.evaluated = evaluated.load();
+    result.renko_series = keys.size();
+    result.memory = memory;
+    if(control) control->set_progress(1.0);
+    return result;
+}
+
+static json summary_to_json(const TradeSummary &s){
+    double win_rate = s.total_trades ? static_cast<double>(s.winning_trades)/s.total_trades : 0.0;
+    return {
+        {"total_trades", s.total_trades},
+        {"net_profit", round(s.total_profit*100.0)/100.0},
+        {"winning_trades", s.winning_trades},
+        {"losing_trades", s.losing_trades},
+        {"win_rate", round(win_rate*10000.0)/10000.0},
+        {"max_drawdown", round(s.max_drawdown*100.0)/100.0}
+    };
+}
+
+json walk_forward_result_to_json(const WalkForwardRequest &req,const WalkForwardResult &result){
+    json folds = json::array();
+    for(size_t i=0;i<result.folds.size();i++){
+        const WalkForwardFoldResult &fr = result.folds[i];
+        json fold = {
+            {"fold", i},
+            {"train_start", epoch_to_ist_iso(fr.fold.train_start)},
+            {"train_end", epoch_to_ist_iso(fr.fold.train_end)},
+            {"test_start", epoch_to_ist_iso(fr.fold.test_start)},
+            {"test_end", epoch_to_ist_iso(fr.fold.test_end)},
+            {"params", nullptr},
+            {"train", nullptr},
+            {"test", nullptr}
+        };
+        if(fr.chosen){
+            const SweepRow &b = fr.best;
+            fold["params"] = {
+                {"brick_size", b.brick_size},
+                {"reversal_size", b.reversal_size},
+                {"source_type", req.sweep.source_types[b.source]},
+                {"tenkan", b.tenkan},
+                {"kijun", b.kijun},
+                {"span_b", b.span_b}
+            };
+            fold["train"] = summary_to_json(b.summary);
+            fold["test"] = summary_to_json(fr.test);
+        }
+        folds.push_back(fold);
+    }
+    return {
+        {"folds", folds},
+        {"out_of_sample", summary_to_json(result.out_of_sample)}
+    };
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "arena.h"
+#include "run_control.h"
+#include "strategy.h"
+#include "sweep.h"
+#include "thread_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+// Walk-forward optimization over one candle series.
+//
+// The range is cut into folds: a train window followed by a test window of
+// test_days, each fold starting test_days after the previous one (rolling),
+// or every train window starting at the range start (anchored). The sweep
+// grid is ranked on each train window and the winner is then run on the
+// test window that follows it.
+//
+// Every Renko series is built once over the whole range and every fold
+// reads its slice of bricks, so folds continue the same chart instead of
+// restarting it at their own start. Donchian midpoints are likewise
+// computed once per series and length. A fold's strategy starts flat and
+// closes anything still open at the end of its window.
+struct WalkForwardRequest {
+    SweepRequest sweep;   // symbol, range, parameter grid, sort_by, min_trades
+    int64_t train_seconds = 30 * 86400;
+    int64_t test_seconds = 7 * 86400;
+    bool anchored = false;
+};
+
+// The sweep fields plus train_days, test_days and anchored.
+// Throws std::runtime_error on invalid input or when no fold fits.
+WalkForwardRequest walk_forward_request_from_json(const nlohmann::json &data);
+
+struct WalkForwardFold {
+    int64_t train_start, train_end;   // [start, end)
+    int64_t test_start, test_end;
+};
+
+std::vector<WalkForwardFold> walk_forward_folds(const WalkForwardRequest &req);
+
+struct WalkForwardFoldResult {
+    WalkForwardFold fold;
+    bool chosen = false;   // false when no combination reached min_trades
+    SweepRow best;         // parameters and train-window summary
+    TradeSummary test;
+    std::vector<Trade> test_trades;
+};
+
+struct WalkForwardResult {
+    std::vector<WalkForwardFoldResult> folds;
+    TradeSummary out_of_sample;   // every test window's trades, in order
+    size_t evaluated = 0;         // combinations run on train windows
+    size_t renko_series = 0;
+    ArenaStats memory;
+};
+
+// `control`, when given, receives progress and is checked between tasks.
+WalkForwardResult run_walk_forward(const WalkForwardRequest &req, const std::vector<Candle> &candles,
+                                   WorkStealingPool &pool, RunControl *control = nullptr);
+
+nlohmann::json walk_forward_result_to_json(const WalkForwardRequest &req, const WalkForwardResult &result);